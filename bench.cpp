@@ -0,0 +1,126 @@
+// bench.cpp
+// Microbenchmark de caminos calientes (ver bench.h)
+
+#if defined(NEBADON_BENCH)
+
+#include "bench.h"
+#include "hal.h"
+#include "neb_log.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define BENCH_STACK_BYTES 8192
+#define BENCH_MAX_CASES   24
+
+// Con CONFIG_HEAP_USE_HOOKS el heap de IDF avisa cada malloc: contamos
+#if defined(CONFIG_HEAP_USE_HOOKS)
+static volatile uint32_t _allocs = 0;
+
+extern "C" void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+  (void)ptr; (void)size; (void)caps;
+  _allocs++;
+}
+
+extern "C" void esp_heap_trace_free_hook(void* ptr) {
+  (void)ptr;
+}
+#endif
+
+struct BenchJob {
+  const BenchCase* c;
+  size_t len;
+  BenchResult* out;
+  TaskHandle_t parent;
+};
+
+static void benchTask(void* arg) {
+  BenchJob& j = *(BenchJob*)arg;
+  const uint32_t iters = NEBADON_BENCH_ITERS;
+
+  // calentamiento: primera llamada fuera de la medida (caches, statics)
+  j.out->bytes = (uint32_t)j.c->fn(j.c->payload, j.len);
+
+  uint32_t heap0 = hal_freeHeap();
+#if defined(CONFIG_HEAP_USE_HOOKS)
+  uint32_t a0 = _allocs;
+#endif
+  unsigned long t0 = micros();
+  uint32_t c0 = hal_cycleCount();
+
+  for (uint32_t i = 0; i < iters; i++) {
+    j.c->fn(j.c->payload, j.len);
+  }
+
+  uint32_t cycles = hal_cycleCount() - c0;
+  unsigned long us = micros() - t0;
+#if defined(CONFIG_HEAP_USE_HOOKS)
+  j.out->allocsX100 = (int32_t)((uint64_t)(_allocs - a0) * 100 / iters);
+#else
+  j.out->allocsX100 = -1;
+#endif
+  j.out->heapRetained = (int32_t)heap0 - (int32_t)hal_freeHeap();
+  j.out->nsOp = (uint32_t)((uint64_t)us * 1000 / iters);
+  j.out->cyclesOp = cycles / iters;
+  j.out->stackPeak = BENCH_STACK_BYTES -
+                     uxTaskGetStackHighWaterMark(nullptr) * sizeof(StackType_t);
+
+  xTaskNotifyGive(j.parent);
+  vTaskDelete(nullptr);
+}
+
+static BenchResult _results[BENCH_MAX_CASES];
+static const BenchCase* _cases = nullptr;
+static size_t _count = 0;
+
+void bench_run(const BenchCase* cases, size_t count) {
+  _cases = cases;
+  _count = 0;
+  if (count > BENCH_MAX_CASES) {
+    LOGW("⚠️ bench: %u casos, solo corren %u", (unsigned)count, (unsigned)BENCH_MAX_CASES);
+    count = BENCH_MAX_CASES;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    size_t len = cases[i].payloadLen;
+    if (len == 0 && cases[i].payload) len = strlen(cases[i].payload);
+    BenchJob job = { &cases[i], len, &_results[i], xTaskGetCurrentTaskHandle() };
+    memset(&_results[i], 0, sizeof(_results[i]));
+
+    if (xTaskCreate(benchTask, "bench", BENCH_STACK_BYTES, &job, 1, nullptr) != pdPASS) {
+      LOGE("❌ bench: no se pudo crear la tarea (%s)", cases[i].name);
+      return;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    _count = i + 1;
+  }
+
+  // deja que el logger vacíe lo que generaron los casos antes del JSON
+  vTaskDelay(pdMS_TO_TICKS(500));
+
+  Serial.printf("{\"bench\":\"nebadon\",\"cpu_mhz\":%lu,\"iters\":%lu,\"results\":[",
+                (unsigned long)hal_cpuMhz(), (unsigned long)NEBADON_BENCH_ITERS);
+  for (size_t i = 0; i < count; i++) {
+    const BenchResult& r = _results[i];
+    char allocs[16];
+    if (r.allocsX100 < 0) snprintf(allocs, sizeof(allocs), "-1");
+    else snprintf(allocs, sizeof(allocs), "%ld.%02ld",
+                  (long)(r.allocsX100 / 100), (long)(r.allocsX100 % 100));
+
+    Serial.printf("%s{\"case\":\"%s\",\"ns_op\":%lu,\"cycles_op\":%lu,\"bytes\":%lu"
+                  ",\"allocs_op\":%s,\"heap_retained\":%ld,\"stack_peak\":%lu}",
+                  i ? "," : "", cases[i].name,
+                  (unsigned long)r.nsOp, (unsigned long)r.cyclesOp, (unsigned long)r.bytes,
+                  allocs, (long)r.heapRetained, (unsigned long)r.stackPeak);
+  }
+  Serial.printf("]}\n");
+}
+
+const BenchResult* bench_result(const char* name) {
+  for (size_t i = 0; i < _count; i++) {
+    if (strcmp(_cases[i].name, name) == 0) return &_results[i];
+  }
+  return nullptr;
+}
+
+#endif // NEBADON_BENCH
@@ -0,0 +1,44 @@
+#pragma once
+#include <Arduino.h>
+
+// Microbenchmark en placa de los caminos calientes (comando BLE/MQTT,
+// serialización del estado, aplicar un vpin). Solo se compila con
+// -DNEBADON_BENCH; el sketch define los casos y llama bench_run() en setup.
+//
+// Cada caso corre en su propia tarea (así el pico de stack es solo suyo)
+// y el resultado sale por Serial como una línea JSON:
+//   {"bench":"nebadon","cpu_mhz":160,"iters":500,"results":[
+//     {"case":"ble_legacy_wifi","ns_op":..,"cycles_op":..,"bytes":..,
+//      "allocs_op":..,"heap_retained":..,"stack_peak":..}, ...]}
+// allocs_op es -1 si el core no trae CONFIG_HEAP_USE_HOOKS.
+// bytes: lo que el caso pone o lee del cable (0 si no aplica), para
+// comparar formatos de payload.
+
+#ifndef NEBADON_BENCH_ITERS
+  #define NEBADON_BENCH_ITERS 500
+#endif
+
+// Devuelve los bytes de cable del caso (ver "bytes" arriba)
+typedef size_t (*BenchFn)(const char* payload, size_t len);
+
+struct BenchCase {
+  const char* name;
+  BenchFn fn;
+  const char* payload;   // puede ser nullptr si el caso no lo usa
+  size_t payloadLen = 0; // 0 = strlen(payload) (los binarios lo dan)
+};
+
+struct BenchResult {
+  uint32_t nsOp;
+  uint32_t cyclesOp;
+  int32_t allocsX100;     // allocs por op * 100; -1 = sin hooks
+  int32_t heapRetained;
+  uint32_t stackPeak;
+  uint32_t bytes;
+};
+
+void bench_run(const BenchCase* cases, size_t count);
+
+// Resultado de un caso del último bench_run() (nullptr si no corrió);
+// el bench en host lo usa para comprobar los números además de imprimirlos
+const BenchResult* bench_result(const char* name);
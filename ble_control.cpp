@@ -1,5 +1,11 @@
 #include "ble_control.h"
+#include "ble_frame.h"
 #include <NimBLEDevice.h>
+#include "neb_log.h"
+#include "latency.h"
+#include "loop_wake.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 
 #if __has_include(<NimBLEConnInfo.h>)
   #include <NimBLEConnInfo.h>
@@ -19,49 +25,127 @@ static BleOnWriteFn g_onWrite = nullptr;
 // para reintentar advertising si algo lo tumba
 static unsigned long g_lastAdvKickMs = 0;
 
+// MTU negociado (23 hasta que el peer pida más) y si el peer habla framing:
+// lo anuncia escribiendo "FRAMING" o lo sabemos por su primer fragmento
+#define BLE_MTU_DEFAULT 23
+static volatile uint16_t g_mtu = BLE_MTU_DEFAULT;
+static volatile bool g_peerFramed = false;
+static uint8_t g_txMsgId = 0;
+
+static void ble_peer_reset() {
+  g_mtu = BLE_MTU_DEFAULT;
+  g_peerFramed = false;
+}
+
 static void ble_tx_notify(const char* msg) {
   if (!g_char) return;
   g_char->setValue((uint8_t*)msg, strlen(msg));
   g_char->notify();
 }
 
+// Cola RX: el callback de NimBLE solo copia y vuelve; ble_loop() despacha
+#define BLE_RX_QUEUE_LEN 4
+#define BLE_RX_MAX       512   // un write (o fragmento); el MTU máximo es 517
+#define BLE_MSG_MAX      4096  // mensaje reensamblado desde fragmentos
+
+struct BleRxItem {
+  uint32_t rxUs;   // ingress, para latency.h
+  uint16_t len;
+  char data[BLE_RX_MAX + 1];
+};
+
+static QueueHandle_t g_rxQueue = nullptr;
+
+// Reensamblado de writes fragmentados; solo se toca desde ble_loop()
+static uint8_t g_rxMsg[BLE_MSG_MAX];
+static BleFrameRx g_rxFrame;
+static uint32_t g_rxMsgUs = 0;   // ingress del primer fragmento
+
+// El item (~520 B) no va en la pila de la tarea de NimBLE: se arma aquí
+// y xQueueSend lo copia. Solo lo toca ble_rx_enqueue(), siempre desde esa
+// tarea.
+static BleRxItem g_rxScratch;
+
+// Corre en la tarea host de NimBLE: nada de trabajo pesado aquí. Copia el
+// valor del atributo tal cual, sin pasar por un std::string.
+static void ble_rx_enqueue(const uint8_t* data, size_t len) {
+  if (len == 0) return;
+
+  if (len > BLE_RX_MAX) {
+    LOGW("[BLE] RX demasiado largo, descartado");
+    ble_tx_notify("{\"ok\":false,\"err\":\"TOO_LONG\"}");
+    return;
+  }
+
+  BleRxItem& item = g_rxScratch;
+  item.rxUs = (uint32_t)micros();
+  item.len = (uint16_t)len;
+  memcpy(item.data, data, len);
+  item.data[len] = '\0';
+
+  if (!g_rxQueue || xQueueSend(g_rxQueue, &item, 0) != pdTRUE) {
+    LOGW("[BLE] Cola RX llena, descartado");
+    ble_tx_notify("{\"ok\":false,\"err\":\"BUSY\"}");
+    return;
+  }
+  wake_signal(WAKE_BIT_BLE);
+}
+
 class ServerCallbacks : public NimBLEServerCallbacks {
 public:
 #if HAS_NIMBLE_CONNINFO
   void onConnect(NimBLEServer* s, NimBLEConnInfo& connInfo) override {
     (void)s; (void)connInfo;
+    ble_peer_reset();
     g_connected = true;
-    Serial.println("[BLE] Cliente conectado");
+    wake_signal(WAKE_BIT_BLE);
+    LOGI("[BLE] Cliente conectado");
 
     // ✅ Señal a tu app
     if (g_char) {
       ble_tx_notify("READY");
-      Serial.println("[BLE] TX notify: READY");
+      LOGI("[BLE] TX notify: READY");
     }
   }
   void onDisconnect(NimBLEServer* s, NimBLEConnInfo& connInfo, int reason) override {
     (void)s; (void)connInfo; (void)reason;
     g_connected = false;
-    Serial.println("[BLE] Cliente desconectado");
+    ble_peer_reset();
+    wake_signal(WAKE_BIT_BLE);
+    LOGI("[BLE] Cliente desconectado");
     NimBLEDevice::startAdvertising();
   }
+  void onMTUChange(uint16_t MTU, NimBLEConnInfo& connInfo) override {
+    (void)connInfo;
+    g_mtu = MTU;
+    LOGI("[BLE] MTU: %u", (unsigned)MTU);
+  }
 #else
   void onConnect(NimBLEServer* s) override {
     (void)s;
+    ble_peer_reset();
     g_connected = true;
-    Serial.println("[BLE] Cliente conectado");
+    wake_signal(WAKE_BIT_BLE);
+    LOGI("[BLE] Cliente conectado");
 
     if (g_char) {
       ble_tx_notify("READY");
-      Serial.println("[BLE] TX notify: READY");
+      LOGI("[BLE] TX notify: READY");
     }
   }
   void onDisconnect(NimBLEServer* s) override {
     (void)s;
     g_connected = false;
-    Serial.println("[BLE] Cliente desconectado");
+    ble_peer_reset();
+    wake_signal(WAKE_BIT_BLE);
+    LOGI("[BLE] Cliente desconectado");
     NimBLEDevice::startAdvertising();
   }
+  void onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc) override {
+    (void)desc;
+    g_mtu = MTU;
+    LOGI("[BLE] MTU: %u", (unsigned)MTU);
+  }
 #endif
 };
 
@@ -70,45 +154,13 @@ public:
 #if HAS_NIMBLE_CONNINFO
   void onWrite(NimBLECharacteristic* ch, NimBLEConnInfo& connInfo) override {
     (void)connInfo;
-    std::string v = ch->getValue();
-    if (v.empty()) return;
-
-    String value(v.c_str());
-    value.trim();
-
-    Serial.print("[BLE] RX: ");
-    Serial.println(value);
-
-    // 1) Tu callback app-level
-    if (g_onWrite) g_onWrite(value);
-
-    // 2) Ping-pong simple
-    if (value.equalsIgnoreCase("PING")) {
-      const char* resp = "PONG";
-      ch->setValue((uint8_t*)resp, strlen(resp));
-      ch->notify();
-      Serial.println("[BLE] TX notify: PONG");
-    }
+    const auto& v = ch->getValue();
+    ble_rx_enqueue((const uint8_t*)v.data(), v.size());
   }
 #else
   void onWrite(NimBLECharacteristic* ch) override {
-    std::string v = ch->getValue();
-    if (v.empty()) return;
-
-    String value(v.c_str());
-    value.trim();
-
-    Serial.print("[BLE] RX: ");
-    Serial.println(value);
-
-    if (g_onWrite) g_onWrite(value);
-
-    if (value.equalsIgnoreCase("PING")) {
-      const char* resp = "PONG";
-      ch->setValue((uint8_t*)resp, strlen(resp));
-      ch->notify();
-      Serial.println("[BLE] TX notify: PONG");
-    }
+    const auto& v = ch->getValue();
+    ble_rx_enqueue((const uint8_t*)v.data(), v.size());
   }
 #endif
 };
@@ -119,11 +171,15 @@ bool ble_begin(const char* deviceName,
                BleOnWriteFn onWrite) {
   g_onWrite = onWrite;
 
+  if (!g_rxQueue) g_rxQueue = xQueueCreate(BLE_RX_QUEUE_LEN, sizeof(BleRxItem));
+  bleframe_rxInit(g_rxFrame, g_rxMsg, sizeof(g_rxMsg));
+
   NimBLEDevice::init(deviceName);
 
   // ✅ MTU más grande para payloads (WiFi provisioning, JSON, etc.)
-  // (No rompe si el peer no lo soporta; se negocia)
-  NimBLEDevice::setMTU(185);
+  // (No rompe si el peer no lo soporta; se negocia; lo que no quepa va
+  // fragmentado con ble_frame.h)
+  NimBLEDevice::setMTU(517);
 
   // potencia alta para que sea visible en scan
   NimBLEDevice::setPower(ESP_PWR_LVL_P9);
@@ -161,12 +217,75 @@ bool ble_begin(const char* deviceName,
 
   adv->start();
 
-  Serial.println("[BLE] Advertising iniciado (con Name + ScanResponse)");
+  LOGI("[BLE] Advertising iniciado (con Name + ScanResponse)");
   g_lastAdvKickMs = millis();
   return true;
 }
 
+// Despacha los writes encolados en el contexto del loop principal
+static void ble_rx_dispatch() {
+  if (!g_rxQueue) return;
+
+  static BleRxItem item;
+  while (xQueueReceive(g_rxQueue, &item, 0) == pdTRUE) {
+    const char* v = item.data;
+    size_t n = item.len;
+    uint32_t rxUs = item.rxUs;
+
+    switch (bleframe_rxPush(g_rxFrame, (const uint8_t*)item.data, item.len)) {
+      case BLE_FRAME_PLAIN:
+        break;
+      case BLE_FRAME_PARTIAL:
+        g_peerFramed = true;
+        if (bleframe_isFirst((const uint8_t*)item.data, item.len)) g_rxMsgUs = item.rxUs;
+        continue;
+      case BLE_FRAME_DONE:
+        g_peerFramed = true;
+        if (bleframe_isFirst((const uint8_t*)item.data, item.len)) g_rxMsgUs = item.rxUs;
+        v = (const char*)g_rxMsg;
+        n = g_rxFrame.len;
+        rxUs = g_rxMsgUs;
+        break;
+      case BLE_FRAME_ERROR:
+        LOGW("[BLE] Fragmento inválido o fuera de orden, mensaje descartado");
+        ble_tx_notify("{\"ok\":false,\"err\":\"FRAME\"}");
+        continue;
+    }
+
+    // trim sin copiar
+    while (n > 0 && isspace((unsigned char)*v)) { v++; n--; }
+    while (n > 0 && isspace((unsigned char)v[n - 1])) n--;
+    if (n == 0) continue;
+
+    // capacidad del peer: es del transporte, no llega a la app
+    if (n == 7 && strncasecmp(v, "FRAMING", 7) == 0) {
+      g_peerFramed = true;
+      char ack[64];
+      snprintf(ack, sizeof(ack), "{\"ok\":true,\"type\":\"framing\",\"max\":%u}", (unsigned)BLE_MSG_MAX);
+      ble_notify(ack);   // ya fragmentado si no cabe
+      LOGI("[BLE] El peer habla framing");
+      continue;
+    }
+
+    LOGI("[BLE] RX: %.*s", (int)n, v);
+
+    // 1) Tu callback app-level
+    lat_begin(rxUs);
+    lat_mark(LAT_DISPATCH);
+    if (g_onWrite) g_onWrite((const uint8_t*)v, n);
+    lat_end();
+
+    // 2) Ping-pong simple
+    if (n == 4 && strncasecmp(v, "PING", 4) == 0) {
+      ble_tx_notify("PONG");
+      LOGI("[BLE] TX notify: PONG");
+    }
+  }
+}
+
 void ble_loop() {
+  ble_rx_dispatch();
+
   // heartbeat cada 3s
   static uint32_t counter = 0;
   static unsigned long lastHbMs = 0;
@@ -182,9 +301,9 @@ void ble_loop() {
       g_char->setValue((uint8_t*)msg, strlen(msg));
       g_char->notify();
 
-      Serial.print("[BLE] Notify: ");
-      Serial.println(msg);
+      LOGD("[BLE] Notify: %s", msg);
     }
+    wake_within(wake_remaining(lastHbMs, 3000, now));
   }
 
   // si algo tumbó el advertising (WiFi/TLS), lo “kickeamos” cada 5s si no hay conexión
@@ -193,15 +312,16 @@ void ble_loop() {
     if (now - g_lastAdvKickMs > 5000) {
       g_lastAdvKickMs = now;
       NimBLEDevice::startAdvertising();
-      Serial.println("[BLE] Advertising kick (keep-alive)");
+      LOGI("[BLE] Advertising kick (keep-alive)");
     }
+    wake_within(wake_remaining(g_lastAdvKickMs, 5001, now));
   }
 
   // lógica old/new
   if (!g_connected && g_oldConnected) {
     delay(50);
     NimBLEDevice::startAdvertising();
-    Serial.println("[BLE] Restart advertising");
+    LOGI("[BLE] Restart advertising");
     g_oldConnected = g_connected;
   }
 
@@ -210,10 +330,44 @@ void ble_loop() {
   }
 }
 
-void ble_notify(const String& msg) {
-  if (!g_connected || !g_char) return;
-  g_char->setValue((uint8_t*)msg.c_str(), msg.length());
+// Un fragmento por notify; con NimBLE 2.x notify() dice si había mbufs,
+// así que reintentamos un par de veces antes de abortar el mensaje
+static bool ble_tx_chunk(const uint8_t* chunk, size_t len, void* ctx) {
+  (void)ctx;
+  if (!g_connected) return false;
+  g_char->setValue(chunk, len);
+#if HAS_NIMBLE_CONNINFO
+  for (int i = 0; i < 3; i++) {
+    if (g_char->notify()) return true;
+    delay(5);
+  }
+  return false;
+#else
   g_char->notify();
+  return true;
+#endif
+}
+
+void ble_notify(const char* msg) {
+  if (!g_connected || !g_char || !msg) return;
+
+  size_t len = strlen(msg);
+  switch (bleframe_tx((const uint8_t*)msg, len, g_txMsgId++, (size_t)g_mtu - 3,
+                      g_peerFramed, ble_tx_chunk, nullptr)) {
+    case BLE_TX_OK:
+      break;
+    case BLE_TX_TOO_LONG:
+      LOGW("[BLE] TX de %u bytes > MTU %u y el peer no habla framing: se le avisa con err MTU",
+           (unsigned)len, (unsigned)g_mtu);
+      break;
+    case BLE_TX_FAILED:
+      LOGW("[BLE] TX de %u bytes abortado", (unsigned)len);
+      break;
+  }
+}
+
+size_t ble_notifyMax() {
+  return g_peerFramed ? BLE_MSG_MAX : (size_t)g_mtu - 3;
 }
 
 bool ble_isConnected() {
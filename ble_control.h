@@ -1,7 +1,9 @@
 #pragma once
 #include <Arduino.h>
 
-typedef void (*BleOnWriteFn)(const String& value);
+// Vista del write recibido (sin '\0' garantizado); se llama desde ble_loop().
+// Los writes fragmentados llegan ya reensamblados como un solo mensaje.
+typedef void (*BleOnWriteFn)(const uint8_t* data, size_t len);
 
 bool ble_begin(const char* deviceName,
                const char* serviceUUID,
@@ -9,5 +11,12 @@ bool ble_begin(const char* deviceName,
                BleOnWriteFn onWrite);
 
 void ble_loop();
-void ble_notify(const String& msg);
+// Si el mensaje no cabe en el MTU y el peer habla framing (ble_frame.h) se
+// manda fragmentado; si no habla framing recibe un error "MTU" en vez del
+// mensaje truncado. El peer lo anuncia escribiendo "FRAMING" (responde
+// {"ok":true,"type":"framing","max":N}) o mandando un mensaje fragmentado.
+void ble_notify(const char* msg);
+
+// Mensaje más largo que ble_notify() entrega entero: MTU - 3 sin framing
+size_t ble_notifyMax();
 bool ble_isConnected();
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "ble_frame.h"
+
+void bleframe_rxInit(BleFrameRx& rx, uint8_t* buf, size_t cap) {
+  rx.buf = buf;
+  rx.cap = cap;
+  bleframe_rxReset(rx);
+}
+
+void bleframe_rxReset(BleFrameRx& rx) {
+  rx.len = 0;
+  rx.total = 0;
+  rx.msgId = 0;
+  rx.nextSeq = 0;
+  rx.active = false;
+}
+
+BleFrameResult bleframe_rxPush(BleFrameRx& rx, const uint8_t* data, size_t len) {
+  if (len == 0 || data[0] != BLE_FRAME_MAGIC) return BLE_FRAME_PLAIN;
+  if (len < BLE_FRAME_HDR) {
+    bleframe_rxReset(rx);
+    return BLE_FRAME_ERROR;
+  }
+
+  uint8_t msgId = data[1];
+  uint16_t seq = (uint16_t)(data[2] | (data[3] << 8));
+  size_t total = (size_t)data[4] | ((size_t)data[5] << 8);
+  const uint8_t* chunk = data + BLE_FRAME_HDR;
+  size_t n = len - BLE_FRAME_HDR;
+
+  // seq 0 abre un mensaje nuevo (uno a medias se pierde)
+  if (seq == 0) {
+    bleframe_rxReset(rx);
+    if (total == 0 || total > rx.cap) return BLE_FRAME_ERROR;
+    rx.active = true;
+    rx.msgId = msgId;
+    rx.total = total;
+  } else if (!rx.active || msgId != rx.msgId || seq != rx.nextSeq || total != rx.total) {
+    bleframe_rxReset(rx);
+    return BLE_FRAME_ERROR;
+  }
+
+  if (n > rx.total - rx.len) {
+    bleframe_rxReset(rx);
+    return BLE_FRAME_ERROR;
+  }
+  memcpy(rx.buf + rx.len, chunk, n);
+  rx.len += n;
+  rx.nextSeq = (uint16_t)(seq + 1);
+
+  if (rx.len < rx.total) {
+    // 65536 fragmentos sin completar (vacíos): el seq daría la vuelta
+    if (rx.nextSeq == 0) {
+      bleframe_rxReset(rx);
+      return BLE_FRAME_ERROR;
+    }
+    return BLE_FRAME_PARTIAL;
+  }
+
+  rx.active = false;
+  return BLE_FRAME_DONE;
+}
+
+bool bleframe_isFirst(const uint8_t* data, size_t len) {
+  return len >= BLE_FRAME_HDR && data[0] == BLE_FRAME_MAGIC && data[2] == 0 && data[3] == 0;
+}
+
+bool bleframe_send(const uint8_t* msg, size_t len, uint8_t msgId, size_t attPayload,
+                   BleFrameSendFn fn, void* ctx) {
+  if (!fn || len == 0 || len > 0xFFFF || attPayload <= BLE_FRAME_HDR) return false;
+
+  // con al menos 1 byte por fragmento, 64 KB nunca pasan de 65536 seq
+  uint8_t frag[BLE_FRAME_HDR + 512];
+  size_t per = attPayload - BLE_FRAME_HDR;
+  if (per > sizeof(frag) - BLE_FRAME_HDR) per = sizeof(frag) - BLE_FRAME_HDR;
+
+  frag[0] = BLE_FRAME_MAGIC;
+  frag[1] = msgId;
+  frag[4] = (uint8_t)(len & 0xFF);
+  frag[5] = (uint8_t)(len >> 8);
+
+  size_t off = 0;
+  for (uint32_t seq = 0; off < len; seq++) {
+    size_t n = len - off < per ? len - off : per;
+    frag[2] = (uint8_t)(seq & 0xFF);
+    frag[3] = (uint8_t)(seq >> 8);
+    memcpy(frag + BLE_FRAME_HDR, msg + off, n);
+    if (!fn(frag, BLE_FRAME_HDR + n, ctx)) return false;
+    off += n;
+  }
+  return true;
+}
+
+BleTxResult bleframe_tx(const uint8_t* msg, size_t len, uint8_t msgId, size_t attPayload,
+                        bool peerFramed, BleFrameSendFn fn, void* ctx) {
+  if (!fn) return BLE_TX_FAILED;
+  if (len <= attPayload) return fn(msg, len, ctx) ? BLE_TX_OK : BLE_TX_FAILED;
+
+  if (peerFramed && len <= 0xFFFF) {
+    return bleframe_send(msg, len, msgId, attPayload, fn, ctx) ? BLE_TX_OK : BLE_TX_FAILED;
+  }
+
+  // truncarlo dejaría JSON roto sin aviso: la app ve el error y el tamaño
+  char err[64];
+  int n = snprintf(err, sizeof(err), "{\"ok\":false,\"err\":\"MTU\",\"len\":%u,\"mtu\":%u}",
+                   (unsigned)len, (unsigned)(attPayload + 3));
+  if (n < 0 || (size_t)n > attPayload) n = snprintf(err, sizeof(err), "{\"err\":\"MTU\"}");
+  fn((const uint8_t*)err, (size_t)n, ctx);
+  return BLE_TX_TOO_LONG;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+
+// Framing para mensajes BLE más largos que el MTU negociado.
+// Cada fragmento (write o notify) lleva una cabecera de 6 bytes:
+//   [0] 0xFE      marca (nunca empieza un texto/JSON: los mensajes sin
+//                 marca siguen siendo un mensaje completo, como siempre)
+//   [1] msg_id    igual en todos los fragmentos de un mensaje
+//   [2..3] seq    0, 1, 2... uint16 little-endian (el 0 abre el mensaje)
+//   [4..5] total  largo del mensaje completo, uint16 little-endian
+// seguida de hasta (MTU - 3 - 6) bytes del mensaje. Con MTU 23 son 14
+// bytes por fragmento: 4096 bytes son 293 fragmentos, por eso seq es u16.
+// No depende de NimBLE: ble_control.cpp lo conecta a la característica.
+
+#define BLE_FRAME_MAGIC 0xFE
+#define BLE_FRAME_HDR   6
+
+enum BleFrameResult : uint8_t {
+  BLE_FRAME_PLAIN = 0,   // sin marca: el write es un mensaje completo
+  BLE_FRAME_PARTIAL,     // fragmento aceptado, faltan más
+  BLE_FRAME_DONE,        // mensaje completo en buf[0..len)
+  BLE_FRAME_ERROR,       // fuera de orden, corrupto o no cabe; se descarta
+};
+
+struct BleFrameRx {
+  uint8_t* buf;
+  size_t cap;
+  size_t len;        // bytes recibidos del mensaje en curso
+  size_t total;
+  uint8_t msgId;
+  uint16_t nextSeq;
+  bool active;
+};
+
+void bleframe_rxInit(BleFrameRx& rx, uint8_t* buf, size_t cap);
+void bleframe_rxReset(BleFrameRx& rx);
+BleFrameResult bleframe_rxPush(BleFrameRx& rx, const uint8_t* data, size_t len);
+
+// Fragmento con seq 0 (abre un mensaje): para tomar su hora de ingreso
+bool bleframe_isFirst(const uint8_t* data, size_t len);
+
+// Envía un fragmento; false si el transporte no lo aceptó
+typedef bool (*BleFrameSendFn)(const uint8_t* chunk, size_t len, void* ctx);
+
+// Parte msg en fragmentos de hasta attPayload bytes (MTU - 3) y los envía
+// en orden; false si pasa de 64 KB o falló un envío
+bool bleframe_send(const uint8_t* msg, size_t len, uint8_t msgId, size_t attPayload,
+                   BleFrameSendFn fn, void* ctx);
+
+enum BleTxResult : uint8_t {
+  BLE_TX_OK = 0,
+  BLE_TX_TOO_LONG,   // no cabe y el peer no habla framing: se le mandó el error
+  BLE_TX_FAILED,     // el transporte rechazó un fragmento
+};
+
+// Un mensaje saliente: entero si cabe en attPayload, fragmentado si el
+// peer habla framing. Si no cabe y el peer no entiende fragmentos no se
+// trunca: recibe {"ok":false,"err":"MTU","len":N,"mtu":M} (o {"err":"MTU"}
+// si ni eso cabe) para que la app negocie MTU o framing.
+BleTxResult bleframe_tx(const uint8_t* msg, size_t len, uint8_t msgId, size_t attPayload,
+                        bool peerFramed, BleFrameSendFn fn, void* ctx);
@@ -0,0 +1,128 @@
+#include "ble_router.h"
+#include "ble_control.h"
+#include "neb_log.h"
+#include <stdarg.h>
+
+void ble_reply(BleReply& r, const char* fmt, ...) {
+  if (!r.buf || r.cap == 0) return;
+
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(r.buf, r.cap, fmt, ap);
+  va_end(ap);
+
+  if (n < 0) n = 0;
+  r.len = ((size_t)n < r.cap) ? (size_t)n : r.cap - 1;
+}
+
+void ble_replyFlush(BleReply& r) {
+  if (r.len == 0) return;
+  if (ble_isConnected()) ble_notify(r.buf);
+  r.len = 0;
+  r.buf[0] = '\0';
+}
+
+static bool isWs(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool onCmdField(const JsonField& f, void* ctx) {
+  BleCmd& c = *(BleCmd*)ctx;
+
+  if (jscan_eq(f.key, "value")) { c.value = f; return true; }
+  if (jscan_eq(f.key, "save"))  { c.save = f;  return true; }
+  if (jscan_eq(f.key, "networks")) { c.networks = f; return true; }
+  if (f.type != JSCAN_STRING) return true;
+
+  if (jscan_eq(f.key, "type"))          c.type = f.val;
+  else if (jscan_eq(f.key, "ssid"))     c.ssid = f.val;
+  else if (jscan_eq(f.key, "pass"))     c.pass = f.val;
+  else if (jscan_eq(f.key, "password")) c.password = f.val;
+  else if (jscan_eq(f.key, "name"))     c.name = f.val;
+  else if (jscan_eq(f.key, "vpin"))     c.vpin = f.val;
+  return true;
+}
+
+static bool textHasPrefix(const BleCmd& c, const char* prefix) {
+  size_t n = strlen(prefix);
+  return c.len >= n && memcmp(c.raw, prefix, n) == 0;
+}
+
+static void logRoute(const char* form, const char* match) {
+  LOGI("✅ [ROUTER] %s%s", form, match);
+}
+
+void ble_routeTable(const BleRoute* table, size_t n,
+                    const uint8_t* data, size_t len, BleReply& reply) {
+  BleCmd c;
+  memset(&c, 0, sizeof(c));
+
+  // trim
+  const char* p = (const char*)data;
+  while (len > 0 && isWs(*p)) { p++; len--; }
+  while (len > 0 && isWs(p[len - 1])) len--;
+  c.raw = p;
+  c.len = len;
+  if (len == 0) return;
+
+  // A) JSON
+  if (*p == '{') {
+    c.json = true;
+    if (!jscan_object(p, len, onCmdField, &c)) {
+      LOGE("❌ BLE JSON parse error");
+      ble_reply(reply, "{\"ok\":false,\"err\":\"JSON_PARSE\"}");
+      return;
+    }
+
+    if (c.type.len > 0) {
+      for (size_t i = 0; i < n; i++) {
+        if (table[i].form == BLE_ROUTE_JSON_TYPE && jscan_eq(c.type, table[i].match)) {
+          logRoute("type=", table[i].match);
+          table[i].fn(c, reply);
+          return;
+        }
+      }
+      ble_reply(reply, "{\"ok\":false,\"err\":\"JSON_TYPE_UNKNOWN\"}");
+      return;
+    }
+
+    // Sin type: se infiere por la primera clave conocida (orden de la tabla)
+    for (size_t i = 0; i < n; i++) {
+      JsonField f;
+      if (table[i].form == BLE_ROUTE_JSON_KEY && jscan_find(p, len, table[i].match, f)) {
+        logRoute("inferido por clave ", table[i].match);
+        table[i].fn(c, reply);
+        return;
+      }
+    }
+
+    LOGE("❌ [ROUTER] JSON sin type y sin campos conocidos");
+    ble_reply(reply, "{\"ok\":false,\"err\":\"JSON_NO_TYPE\"}");
+    return;
+  }
+
+  // B) Legacy / texto
+  for (size_t i = 0; i < n; i++) {
+    const BleRoute& r = table[i];
+
+    if (r.form == BLE_ROUTE_TEXT_PREFIX && textHasPrefix(c, r.match)) {
+      size_t k = strlen(r.match);
+      c.arg.p = c.raw + k;
+      c.arg.len = (uint16_t)(c.len - k);
+      logRoute("texto ", r.match);
+      r.fn(c, reply);
+      return;
+    }
+
+    if (r.form == BLE_ROUTE_TEXT_EQ) {
+      JsonSpan whole = { c.raw, (uint16_t)c.len };
+      if (jscan_eqIgnoreCase(whole, r.match)) {
+        logRoute("texto ", r.match);
+        r.fn(c, reply);
+        return;
+      }
+    }
+  }
+
+  ble_reply(reply, "{\"ok\":false,\"err\":\"UNKNOWN_CMD\"}");
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <Arduino.h>
+#include "json_scan.h"
+
+// Router de comandos BLE: una tabla en compilación cubre las formas JSON
+// ({"type":...}, JSON inferido por clave) y las de texto legacy
+// ("WIFI:ssid|pass", "1", "STATUS"...). Trabaja sobre la vista
+// (puntero, largo) que entrega ble_control, sin Strings; las respuestas
+// se escriben en un buffer fijo del llamador.
+
+// Respuesta en buffer fijo
+struct BleReply {
+  char* buf;
+  size_t cap;
+  size_t len;
+};
+
+// Reemplaza el contenido de la respuesta (se trunca si no cabe)
+void ble_reply(BleReply& r, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Notifica la respuesta pendiente y la vacía (para avisos intermedios)
+void ble_replyFlush(BleReply& r);
+
+// Comando ya separado; los spans apuntan al buffer recibido
+struct BleCmd {
+  const char* raw;     // payload sin espacios en los extremos
+  size_t len;
+  bool json;
+
+  // JSON (len == 0 si no viene)
+  JsonSpan type;
+  JsonSpan ssid;
+  JsonSpan pass;
+  JsonSpan password;
+  JsonSpan name;
+  JsonSpan vpin;
+  JsonField value;
+  JsonField save;
+  JsonField networks;   // array de {"ssid","pass"}
+
+  // Texto: lo que sigue al prefijo (BLE_ROUTE_TEXT_PREFIX)
+  JsonSpan arg;
+};
+
+typedef void (*BleRouteFn)(const BleCmd& cmd, BleReply& reply);
+
+enum BleRouteForm : uint8_t {
+  BLE_ROUTE_JSON_TYPE = 0,  // {"type":"<match>", ...}
+  BLE_ROUTE_JSON_KEY,       // JSON sin "type" que trae la clave <match>
+  BLE_ROUTE_TEXT_PREFIX,    // "<match>..." (cmd.arg = resto)
+  BLE_ROUTE_TEXT_EQ,        // "<match>" exacto, sin distinguir mayúsculas
+};
+
+struct BleRoute {
+  BleRouteForm form;
+  const char* match;
+  BleRouteFn fn;
+};
+
+void ble_routeTable(const BleRoute* table, size_t n,
+                    const uint8_t* data, size_t len, BleReply& reply);
+
+template <size_t N>
+inline void ble_route(const BleRoute (&table)[N],
+                      const uint8_t* data, size_t len, BleReply& reply) {
+  ble_routeTable(table, N, data, len, reply);
+}
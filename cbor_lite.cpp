@@ -0,0 +1,155 @@
+#include "cbor_lite.h"
+
+// Tipos mayores (3 bits altos del byte inicial)
+#define CBOR_MT_UINT   0
+#define CBOR_MT_NEGINT 1
+#define CBOR_MT_BYTES  2
+#define CBOR_MT_TEXT   3
+#define CBOR_MT_MAP    5
+#define CBOR_MT_SIMPLE 7
+
+#define CBOR_FALSE 20
+#define CBOR_TRUE  21
+#define CBOR_NULLV 22
+
+void cbor_begin(CborWriter& w, uint8_t* buf, size_t cap) {
+  w.buf = buf;
+  w.cap = cap;
+  w.len = 0;
+  w.ok = (buf != nullptr);
+}
+
+static void put(CborWriter& w, uint8_t b) {
+  if (!w.ok || w.len >= w.cap) {
+    w.ok = false;
+    return;
+  }
+  w.buf[w.len++] = b;
+}
+
+// Cabecera: tipo mayor + argumento en la forma más corta
+static void head(CborWriter& w, uint8_t mt, uint32_t v) {
+  mt <<= 5;
+  if (v < 24) {
+    put(w, mt | (uint8_t)v);
+  } else if (v <= 0xFF) {
+    put(w, mt | 24);
+    put(w, (uint8_t)v);
+  } else if (v <= 0xFFFF) {
+    put(w, mt | 25);
+    put(w, (uint8_t)(v >> 8));
+    put(w, (uint8_t)v);
+  } else {
+    put(w, mt | 26);
+    put(w, (uint8_t)(v >> 24));
+    put(w, (uint8_t)(v >> 16));
+    put(w, (uint8_t)(v >> 8));
+    put(w, (uint8_t)v);
+  }
+}
+
+void cbor_map(CborWriter& w, size_t pairs) {
+  head(w, CBOR_MT_MAP, (uint32_t)pairs);
+}
+
+void cbor_uint(CborWriter& w, uint32_t v) {
+  head(w, CBOR_MT_UINT, v);
+}
+
+void cbor_int(CborWriter& w, int32_t v) {
+  if (v >= 0) head(w, CBOR_MT_UINT, (uint32_t)v);
+  else head(w, CBOR_MT_NEGINT, (uint32_t)(-1 - v));
+}
+
+void cbor_text(CborWriter& w, const char* s, size_t len) {
+  head(w, CBOR_MT_TEXT, (uint32_t)len);
+  if (!w.ok || w.len + len > w.cap) {
+    w.ok = false;
+    return;
+  }
+  memcpy(w.buf + w.len, s, len);
+  w.len += len;
+}
+
+void cbor_bool(CborWriter& w, bool v) {
+  put(w, (CBOR_MT_SIMPLE << 5) | (v ? CBOR_TRUE : CBOR_FALSE));
+}
+
+// Lee una cabecera; devuelve el puntero tras ella o nullptr
+static const uint8_t* readHead(const uint8_t* p, const uint8_t* end, uint8_t& mt, uint32_t& v) {
+  if (p >= end) return nullptr;
+  mt = *p >> 5;
+  uint8_t ai = *p++ & 0x1F;
+
+  if (ai < 24) {
+    v = ai;
+    return p;
+  }
+  uint8_t n = ai == 24 ? 1 : ai == 25 ? 2 : ai == 26 ? 4 : 0;
+  if (n == 0 || end - p < n) return nullptr;   // 64 bits / indefinido: no
+
+  v = 0;
+  for (uint8_t i = 0; i < n; i++) v = (v << 8) | *p++;
+  return p;
+}
+
+bool cbor_scanMap(const uint8_t* buf, size_t len, CborFieldFn fn, void* ctx) {
+  if (!buf) return false;
+  const uint8_t* p = buf;
+  const uint8_t* end = buf + len;
+
+  uint8_t mt;
+  uint32_t pairs;
+  p = readHead(p, end, mt, pairs);
+  if (!p || mt != CBOR_MT_MAP) return false;
+
+  bool more = true;
+  for (uint32_t k = 0; k < pairs; k++) {
+    CborField f;
+    memset(&f, 0, sizeof(f));
+
+    uint32_t v;
+    p = readHead(p, end, mt, f.key);
+    if (!p || mt != CBOR_MT_UINT) return false;
+
+    // el byte inicial se mira antes de que readHead lo consuma (simples)
+    if (p >= end) return false;
+    uint8_t ib = *p;
+    p = readHead(p, end, mt, v);
+    if (!p) return false;
+
+    switch (mt) {
+      case CBOR_MT_UINT:
+        f.type = CBOR_UINT;
+        f.i = v > INT32_MAX ? INT32_MAX : (int32_t)v;
+        break;
+      case CBOR_MT_NEGINT:
+        f.type = CBOR_NEGINT;
+        f.i = v > INT32_MAX ? INT32_MIN : -1 - (int32_t)v;
+        break;
+      case CBOR_MT_BYTES:
+      case CBOR_MT_TEXT:
+        if (v > 0xFFFF || (uint32_t)(end - p) < v) return false;
+        f.type = mt == CBOR_MT_TEXT ? CBOR_TEXT : CBOR_BYTES;
+        f.p = p;
+        f.len = (uint16_t)v;
+        p += v;
+        break;
+      case CBOR_MT_SIMPLE:
+        if ((ib & 0x1F) == CBOR_FALSE || (ib & 0x1F) == CBOR_TRUE) {
+          f.type = CBOR_BOOL;
+          f.i = (ib & 0x1F) == CBOR_TRUE ? 1 : 0;
+        } else if ((ib & 0x1F) == CBOR_NULLV) {
+          f.type = CBOR_NULL;
+        } else {
+          return false;
+        }
+        break;
+      default:
+        return false;   // arrays, mapas y tags no están en el subconjunto
+    }
+
+    if (more && fn && !fn(f, ctx)) more = false;
+  }
+  return p == end;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <Arduino.h>
+
+// CBOR (RFC 8949) mínimo para los payloads binarios de MQTT, sin heap.
+// Solo el subconjunto que usan: mapas planos con claves enteras y valores
+// uint/int de 32 bits, texto, bytes, bool y null. Nada anidado, nada de
+// largo indefinido.
+
+struct CborWriter {
+  uint8_t* buf;
+  size_t cap;
+  size_t len;
+  bool ok;        // false si algo no cupo
+};
+
+void cbor_begin(CborWriter& w, uint8_t* buf, size_t cap);
+void cbor_map(CborWriter& w, size_t pairs);
+void cbor_uint(CborWriter& w, uint32_t v);
+void cbor_int(CborWriter& w, int32_t v);
+void cbor_text(CborWriter& w, const char* s, size_t len);
+void cbor_bool(CborWriter& w, bool v);
+
+enum CborType : uint8_t {
+  CBOR_NONE = 0,
+  CBOR_UINT,
+  CBOR_NEGINT,
+  CBOR_BYTES,
+  CBOR_TEXT,
+  CBOR_BOOL,
+  CBOR_NULL,
+};
+
+struct CborField {
+  uint32_t key;
+  CborType type;
+  int32_t i;          // UINT/NEGINT/BOOL (UINT > INT32_MAX se satura)
+  const uint8_t* p;   // BYTES/TEXT, apunta al buffer recibido
+  uint16_t len;
+};
+
+// Devuelve false para cortar el recorrido
+typedef bool (*CborFieldFn)(const CborField& f, void* ctx);
+
+// false si no es un mapa {uint: escalar} bien formado que ocupe todo el buffer
+bool cbor_scanMap(const uint8_t* buf, size_t len, CborFieldFn fn, void* ctx);
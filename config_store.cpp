@@ -0,0 +1,203 @@
+// config_store.cpp
+// Config persistente con caché en RAM y commits agrupados (ver config_store.h)
+
+#include "config_store.h"
+#include "neb_log.h"
+#include "hal.h"
+#include "loop_wake.h"
+
+static const char* CFG_NS = "nebadon";
+
+enum CfgType : uint8_t {
+  CFG_T_STR = 0,
+  CFG_T_U32,
+};
+
+struct CfgDef {
+  const char* nvsKey;
+  CfgType type;
+  uint8_t cap;          // STR: incluye el '\0'
+  uint32_t delayMs;     // retardo del commit desde el último cambio
+};
+
+static constexpr CfgDef DEFS[CFG_KEY_COUNT] = {
+  { "ssid",       CFG_T_STR, 33, 1000 },
+  { "pass",       CFG_T_STR, 65, 1000 },
+  { "dev_key",    CFG_T_STR, 9,  1000 },
+  { "dev_id",     CFG_T_STR, 65, 1000 },
+  // relés: un toggle por segundo no debe ser una escritura por segundo
+  { "vpins",      CFG_T_U32, 0,  5000 },
+  { "wifi_bssid", CFG_T_STR, 13, 1000 },
+  { "wifi_ch",    CFG_T_U32, 0,  1000 },
+  { "wifi_ip",    CFG_T_U32, 0,  1000 },
+  { "wifi_gw",    CFG_T_U32, 0,  1000 },
+  { "wifi_mask",  CFG_T_U32, 0,  1000 },
+  { "wifi_dns",   CFG_T_U32, 0,  1000 },
+  { "wifi_lssid", CFG_T_STR, 33, 1000 },
+  { "ssid1",      CFG_T_STR, 33, 1000 },
+  { "pass1",      CFG_T_STR, 65, 1000 },
+  { "ssid2",      CFG_T_STR, 33, 1000 },
+  { "pass2",      CFG_T_STR, 65, 1000 },
+  { "ssid3",      CFG_T_STR, 33, 1000 },
+  { "pass3",      CFG_T_STR, 65, 1000 },
+  { "ssid4",      CFG_T_STR, 33, 1000 },
+  { "pass4",      CFG_T_STR, 65, 1000 },
+  { "payload_fmt", CFG_T_U32, 0, 1000 },
+};
+
+static_assert(CFG_KEY_COUNT <= 32, "_dirty es un bitmask de 32 bits");
+
+// Strings empaquetados en un solo pool: cada clave ocupa su cap
+static constexpr size_t poolSize(size_t i = 0) {
+  return i >= CFG_KEY_COUNT ? 0 : DEFS[i].cap + poolSize(i + 1);
+}
+
+static char _pool[poolSize()];
+static char* _str[CFG_KEY_COUNT];   // apunta dentro de _pool (nullptr en U32)
+static uint32_t _u32[CFG_KEY_COUNT];
+static uint32_t _u32Flash[CFG_KEY_COUNT];   // lo que hay en NVS
+static unsigned long _changedMs[CFG_KEY_COUNT];   // último cambio
+static unsigned long _dirtyMs[CFG_KEY_COUNT];     // primer cambio sin guardar
+static uint32_t _dirty = 0;                 // bit por clave
+static bool _loaded = false;
+static uint32_t _flashWrites = 0;
+
+void cfg_begin() {
+  if (_loaded) return;
+  _loaded = true;
+
+  char* p = _pool;
+  for (uint8_t k = 0; k < CFG_KEY_COUNT; k++) {
+    _str[k] = DEFS[k].cap ? p : nullptr;
+    p += DEFS[k].cap;
+  }
+
+  hal_kvOpen(CFG_NS, true);
+  for (uint8_t k = 0; k < CFG_KEY_COUNT; k++) {
+    if (DEFS[k].type == CFG_T_U32) {
+      _u32[k] = _u32Flash[k] = hal_kvGetU32(DEFS[k].nvsKey, 0);
+      continue;
+    }
+    String v = hal_kvGetString(DEFS[k].nvsKey);
+    if (v.length() >= DEFS[k].cap) v = "";   // corrupto o de otro formato
+    memcpy(_str[k], v.c_str(), v.length() + 1);
+  }
+  hal_kvClose();
+}
+
+static void markDirty(CfgKey k) {
+  unsigned long now = millis();
+  if (!(_dirty & (1u << k))) _dirtyMs[k] = now;
+  _dirty |= (1u << k);
+  _changedMs[k] = now;
+}
+
+// ms hasta que toca escribir la clave: su retardo desde el último cambio,
+// con tope CFG_MAX_DEFER_MS desde el primero
+static uint32_t commitDueIn(uint8_t k, unsigned long now) {
+  uint32_t quiet = wake_remaining(_changedMs[k], DEFS[k].delayMs, now);
+  uint32_t defer = wake_remaining(_dirtyMs[k], CFG_MAX_DEFER_MS, now);
+  return quiet < defer ? quiet : defer;
+}
+
+const char* cfg_getStr(CfgKey k) {
+  if (k >= CFG_KEY_COUNT || DEFS[k].type != CFG_T_STR) return "";
+  cfg_begin();
+  return _str[k];
+}
+
+bool cfg_setStr(CfgKey k, const char* v) {
+  if (k >= CFG_KEY_COUNT || DEFS[k].type != CFG_T_STR) return false;
+  if (!v) v = "";
+  cfg_begin();
+
+  size_t n = strlen(v);
+  if (n >= DEFS[k].cap) return false;
+  if (strcmp(_str[k], v) == 0) return true;   // sin cambios: nada que escribir
+
+  memcpy(_str[k], v, n + 1);
+  markDirty(k);
+  return true;
+}
+
+uint32_t cfg_getU32(CfgKey k) {
+  if (k >= CFG_KEY_COUNT || DEFS[k].type != CFG_T_U32) return 0;
+  cfg_begin();
+  return _u32[k];
+}
+
+bool cfg_setU32(CfgKey k, uint32_t v) {
+  if (k >= CFG_KEY_COUNT || DEFS[k].type != CFG_T_U32) return false;
+  cfg_begin();
+
+  if (_u32[k] == v) return true;
+  _u32[k] = v;
+
+  if (v == _u32Flash[k]) _dirty &= ~(1u << k);   // ida y vuelta: nada que escribir
+  else markDirty(k);
+  return true;
+}
+
+// Escribe las claves sucias (todas, o solo las que cumplieron su retardo);
+// devuelve false si alguna falló
+static bool commitKeys(bool all, unsigned long now) {
+  bool ok = true;
+  bool opened = false;
+
+  for (uint8_t k = 0; k < CFG_KEY_COUNT; k++) {
+    if (!(_dirty & (1u << k))) continue;
+    if (!all && commitDueIn(k, now) > 0) continue;
+
+    if (!opened) {
+      hal_kvOpen(CFG_NS, false);
+      opened = true;
+    }
+
+    bool w;
+    if (DEFS[k].type == CFG_T_U32) {
+      w = hal_kvPutU32(DEFS[k].nvsKey, _u32[k]);
+      if (w) _u32Flash[k] = _u32[k];
+    } else {
+      // borrar algo que no existía no es error
+      w = _str[k][0] ? hal_kvPutString(DEFS[k].nvsKey, String(_str[k]))
+                     : (hal_kvRemove(DEFS[k].nvsKey), true);
+    }
+    _flashWrites++;
+
+    if (w) {
+      _dirty &= ~(1u << k);
+    } else {
+      ok = false;
+      _changedMs[k] = _dirtyMs[k] = now;   // se reintenta tras su retardo
+    }
+  }
+
+  if (opened) hal_kvClose();
+  if (!ok) LOGE("❌ config: falló escribir NVS (se reintenta)");
+  return ok;
+}
+
+bool cfg_commit() {
+  if (_dirty == 0) return true;
+  return commitKeys(true, millis());
+}
+
+void cfg_loop() {
+  if (_dirty == 0) return;
+
+  unsigned long now = millis();
+  uint32_t before = _flashWrites;
+  commitKeys(false, now);
+  if (_flashWrites != before) {
+    LOGI("💾 config guardada (escrituras flash: %lu)", (unsigned long)_flashWrites);
+  }
+
+  // próximo commit pendiente
+  for (uint8_t k = 0; k < CFG_KEY_COUNT; k++) {
+    if (_dirty & (1u << k)) wake_within(commitDueIn(k, now));
+  }
+}
+
+uint32_t cfg_flashWrites() {
+  return _flashWrites;
+}
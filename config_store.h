@@ -0,0 +1,71 @@
+#pragma once
+#include <Arduino.h>
+
+// Config persistente en NVS con caché en RAM.
+// Todas las claves se leen una vez en cfg_begin(); las lecturas salen de
+// RAM. Un set solo marca la clave como sucia si el valor cambió, y
+// cfg_loop() escribe juntas (una sola apertura de NVS) las claves cuyo
+// último cambio tiene ya su retardo, fuera del handler que las pidió.
+// Cada cambio reinicia el retardo de su clave: las ráfagas se funden. Pero
+// una clave no espera más de CFG_MAX_DEFER_MS desde su primer cambio sin
+// guardar: un cambio cada pocos segundos no debe aplazar la escritura
+// para siempre.
+
+#define CFG_MAX_DEFER_MS 30000UL
+
+enum CfgKey : uint8_t {
+  CFG_WIFI_SSID = 0,   // red 0 (la preferida); 1..4 más abajo
+  CFG_WIFI_PASS,
+  CFG_DEV_KEY,      // clave de validez del device_id (ver net_wifi_mqtt.cpp)
+  CFG_DEV_ID,
+  CFG_VPIN_STATE,   // u32: bit i = vpin i encendido
+  // último enlace WiFi bueno (reconexión rápida), de la red CFG_WIFI_LINK_SSID
+  CFG_WIFI_BSSID,   // 12 hex, "" = sin caché
+  CFG_WIFI_CH,
+  CFG_WIFI_IP,
+  CFG_WIFI_GW,
+  CFG_WIFI_MASK,
+  CFG_WIFI_DNS,
+  CFG_WIFI_LINK_SSID,
+  // redes 1..4 (ssid/pass alternados)
+  CFG_WIFI_SSID1,
+  CFG_WIFI_PASS1,
+  CFG_WIFI_SSID2,
+  CFG_WIFI_PASS2,
+  CFG_WIFI_SSID3,
+  CFG_WIFI_PASS3,
+  CFG_WIFI_SSID4,
+  CFG_WIFI_PASS4,
+  CFG_PAYLOAD_FMT,  // formato MQTT negociado en el bootstrap (0 JSON, 1 CBOR)
+  CFG_KEY_COUNT
+};
+
+#define CFG_WIFI_SLOTS 5
+
+inline CfgKey cfg_wifiSsidKey(uint8_t slot) {
+  return slot == 0 ? CFG_WIFI_SSID : (CfgKey)(CFG_WIFI_SSID1 + (slot - 1) * 2);
+}
+
+inline CfgKey cfg_wifiPassKey(uint8_t slot) {
+  return slot == 0 ? CFG_WIFI_PASS : (CfgKey)(CFG_WIFI_PASS1 + (slot - 1) * 2);
+}
+
+void cfg_begin();
+
+const char* cfg_getStr(CfgKey k);
+
+// false si no cabe; "" borra la clave de NVS
+bool cfg_setStr(CfgKey k, const char* v);
+
+uint32_t cfg_getU32(CfgKey k);
+// Volver al valor que ya está en flash antes del commit no escribe nada
+bool cfg_setU32(CfgKey k, uint32_t v);
+
+// Escribe ya lo pendiente (p. ej. antes de reiniciar)
+bool cfg_commit();
+
+// Commit diferido; llamar en cada pasada del loop
+void cfg_loop();
+
+// Escrituras/borrados reales en flash desde el arranque
+uint32_t cfg_flashWrites();
@@ -2,11 +2,19 @@
 // ✅ BLE + WiFi Provisioning (JSON o comandos simples) + Bootstrap API + MQTT + Relay
 
 #include <Arduino.h>
-#include <WiFi.h>
-#include <ArduinoJson.h>
 
 #include "ble_control.h"
 #include "net_wifi_mqtt.h"
+#include "vpin_registry.h"
+#include "ble_router.h"
+#include "neb_log.h"
+#include "hal.h"
+#include "bench.h"
+#include "latency.h"
+#include "loop_prof.h"
+#include "loop_wake.h"
+#include "config_store.h"
+#include "vpin_persist.h"
 
 // ⚠️ ESP32 clásico: NO uses GPIO 11 (flash). C6 sí puede.
 // Portable:
@@ -19,288 +27,704 @@
 #define SERVICE_UUID        "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
 #define CHARACTERISTIC_UUID "beb5483e-36e1-4688-b7f5-ea07361b26a8"
 
-static int relayLevel = LOW;
-
 // ======================
-// Utils
+// Virtual pins
 // ======================
 
-static bool parseWifiCmd(const String& value, String& ssidOut, String& passOut) {
-  if (!value.startsWith("WIFI:")) return false;
+static int writeDigitalOut(const VpinDef& def, int value) {
+  int level = (value > 0) ? HIGH : LOW;
+  hal_gpioWrite(def.gpio, level);
+  return level == HIGH ? 1 : 0;
+}
 
-  String payload = value.substring(5);
-  int sep = payload.indexOf('|');
+// Índice == número de vpin (ver vpin_registry.h)
+static constexpr VpinDef VPINS[] = {
+  { "V0", RELAY_PIN, VPIN_DIGITAL_OUT, writeDigitalOut },
+};
+static constexpr size_t VPIN_COUNT = sizeof(VPINS) / sizeof(VPINS[0]);
+static_assert(vpin_tableIsDense(VPINS), "VPINS: la entrada i debe llamarse \"V<i>\"");
 
-  if (sep < 0) {
-    ssidOut = payload;
-    passOut = "";
-  } else {
-    ssidOut = payload.substring(0, sep);
-    passOut = payload.substring(sep + 1);
-  }
+static constexpr int VPIN_RELAY = 0;
 
-  ssidOut.trim();
-  passOut.trim();
-  return ssidOut.length() > 0;
-}
+static_assert(VPIN_COUNT <= 32, "vpin_persist guarda el estado en un u32");
 
-static bool isJsonPayload(const String& s) {
-  if (s.length() == 0) return false;
-  int i = 0;
-  while (i < (int)s.length() && isspace((unsigned char)s[i])) i++;
-  return (i < (int)s.length() && s[i] == '{');
+static int vpinState[VPIN_COUNT] = {};
+
+static uint32_t vpinBits() {
+  uint32_t bits = 0;
+  for (size_t i = 0; i < VPIN_COUNT; i++) {
+    if (vpinState[i]) bits |= (1u << i);
+  }
+  return bits;
 }
 
-static void ble_ok(const String& msg) {
+// Provisioning BLE en curso: el progreso de net_loop se reenvía a la app
+// hasta MQTT_OK, WIFI_FAIL (la ronda entera falló) o el plazo
+#define WIFI_PROVISION_TIMEOUT_MS 120000UL
+static bool wifiProvisioning = false;
+static unsigned long wifiProvisioningSinceMs = 0;
+
+// WIFI_SCAN pedido sin resultado reciente: se notifica al terminar
+static bool wifiScanWaiting = false;
+
+#if defined(NEBADON_BENCH)
+// Durante el bench los comandos WiFi se parsean pero no se aplican y
+// applyVpin() no toca el relé ni la NVS
+static bool benchRunning = false;
+#endif
+
+// ======================
+// Utils
+// ======================
+
+static void ble_ok(const char* msg) {
   if (ble_isConnected()) ble_notify(msg);
 }
 
 // ======================
-// Relay
+// Relay / vpin apply
 // ======================
 
-void applyRelay(int value01, const char* src) {
-  bool on = (value01 > 0);
-  relayLevel = on ? HIGH : LOW;
-  digitalWrite(RELAY_PIN, relayLevel);
+void applyVpin(int idx, int value, const char* src) {
+  if (idx < 0 || idx >= (int)VPIN_COUNT) return;
+  const VpinDef& def = VPINS[idx];
+
+  bool dryRun = false;
+#if defined(NEBADON_BENCH)
+  dryRun = benchRunning;   // bench: ni GPIO ni NVS, el resto del camino igual
+#endif
+
+  int applied = value ? 1 : 0;
+  if (!dryRun) {
+    applied = def.handler(def, value);
+    lat_mark(LAT_GPIO);
+    vpinState[idx] = applied;
+    vpin_persistSave(vpinBits());
+  }
 
-  Serial.print("[MAIN] PIN");
-  Serial.print(RELAY_PIN);
-  Serial.print(" ");
-  Serial.print(on ? "ON" : "OFF");
-  Serial.print(" (src=");
-  Serial.print(src);
-  Serial.println(")");
+  LOGI("[MAIN] %s PIN%u %s (src=%s)", def.name, (unsigned)def.gpio, applied ? "ON" : "OFF", src);
 
-  net_publishState("V0", on ? 1 : 0);
+  // encolado (offline) no cuenta como publicado
+  if (net_publishState(def.name, applied)) lat_mark(LAT_PUBLISH);
 
-  if (ble_isConnected()) ble_notify(String(on ? 1 : 0));
+  if (ble_isConnected()) {
+    ble_notify(applied ? "1" : "0");
+    lat_mark(LAT_NOTIFY);
+  }
 }
 
 // ======================
 // Handlers
 // ======================
 
-static void handleRelay(int value) {
+static void handleRelay(int idx, int value, BleReply& r) {
+  if (idx < 0 || idx >= (int)VPIN_COUNT) {
+    LOGE("❌ [MAIN] vpin desconocido");
+    ble_reply(r, "{\"ok\":false,\"err\":\"VPIN_UNKNOWN\"}");
+    return;
+  }
   if (value != 0 && value != 1) {
-    Serial.println("❌ [MAIN] Relay value inválido");
-    ble_ok("{\"ok\":false,\"err\":\"RELAY_VALUE_INVALID\"}");
+    LOGE("❌ [MAIN] Relay value inválido");
+    ble_reply(r, "{\"ok\":false,\"err\":\"RELAY_VALUE_INVALID\"}");
+    return;
+  }
+  applyVpin(idx, value, "BLE");
+  ble_reply(r, "{\"ok\":true,\"type\":\"relay\",\"value\":%d}", value);
+}
+
+static void provisioningStart() {
+  wifiProvisioning = true;
+  wifiProvisioningSinceMs = millis();
+}
+
+// Bootstrap o MQTT que no terminan: la app deja de esperar con TIMEOUT
+// (la red sigue reintentando por su cuenta)
+static void provisioningPoll() {
+  if (!wifiProvisioning) return;
+
+  unsigned long now = millis();
+  uint32_t left = wake_remaining(wifiProvisioningSinceMs, WIFI_PROVISION_TIMEOUT_MS, now);
+  if (left > 0) {
+    wake_within(left);
     return;
   }
-  applyRelay(value, "BLE");
-  ble_ok(String("{\"ok\":true,\"type\":\"relay\",\"value\":") + value + "}");
+  LOGW("⚠️ [MAIN] provisioning sin MQTT tras %lu s", WIFI_PROVISION_TIMEOUT_MS / 1000);
+  ble_ok("{\"ok\":false,\"type\":\"wifi\",\"status\":\"TIMEOUT\"}");
+  wifiProvisioning = false;
 }
 
-static void handleWifi(const String& ssid, const String& pass, bool save) {
-  if (ssid.length() == 0) {
-    Serial.println("❌ [MAIN] SSID vacío");
-    ble_ok("{\"ok\":false,\"err\":\"WIFI_SSID_EMPTY\"}");
+static void handleWifi(const char* ssid, const char* pass, bool save, BleReply& r) {
+  if (!ssid || ssid[0] == '\0') {
+    LOGE("❌ [MAIN] SSID vacío");
+    ble_reply(r, "{\"ok\":false,\"err\":\"WIFI_SSID_EMPTY\"}");
     return;
   }
 
-  Serial.println("========================================");
-  Serial.println("🚀 [MAIN] WIFI provisioning recibido por BLE");
-  Serial.print("SSID=");
-  Serial.println(ssid);
-  Serial.print("PASS_LEN=");
-  Serial.println(pass.length());
-  Serial.println("========================================");
+  LOGI("🚀 [MAIN] WIFI provisioning recibido por BLE SSID=%s PASS_LEN=%d", ssid, (int)strlen(pass));
 
-  ble_ok("{\"ok\":true,\"type\":\"wifi\",\"status\":\"RECEIVED\"}");
+  ble_reply(r, "{\"ok\":true,\"type\":\"wifi\",\"status\":\"RECEIVED\"}");
+  ble_replyFlush(r);
 
-  // Dispara WiFi -> Bootstrap -> MQTT
+#if defined(NEBADON_BENCH)
+  if (benchRunning) return;
+#endif
+
+  // Dispara WiFi -> Bootstrap -> MQTT (no bloquea: avanza en net_loop)
+  // El resto del feedback llega por onNetProgress()
+  provisioningStart();
   net_setWifiCredentials(ssid, pass, save);
+}
 
-  // Feedback inmediato
-  if (net_isWifiConnected()) ble_ok("{\"ok\":true,\"type\":\"wifi\",\"status\":\"WIFI_OK\"}");
-  else {
-    ble_ok("{\"ok\":false,\"type\":\"wifi\",\"status\":\"WIFI_FAIL\"}");
+static void handleWifiList(const NetWifiCred* nets, size_t count, bool save, BleReply& r) {
+  if (count == 0) {
+    LOGE("❌ [MAIN] lista de redes vacía");
+    ble_reply(r, "{\"ok\":false,\"err\":\"WIFI_SSID_EMPTY\"}");
     return;
   }
 
-  if (net_isConnected()) ble_ok("{\"ok\":true,\"type\":\"wifi\",\"status\":\"MQTT_OK\"}");
-  else ble_ok("{\"ok\":true,\"type\":\"wifi\",\"status\":\"MQTT_PENDING\"}");
+  LOGI("🚀 [MAIN] WIFI provisioning recibido por BLE: %u red(es)", (unsigned)count);
+
+  ble_reply(r, "{\"ok\":true,\"type\":\"wifi\",\"status\":\"RECEIVED\",\"networks\":%u}", (unsigned)count);
+  ble_replyFlush(r);
+
+#if defined(NEBADON_BENCH)
+  if (benchRunning) return;
+#endif
+
+  provisioningStart();
+  net_setWifiNetworks(nets, count, save);
 }
 
-static void handleAction(const String& name) {
-  if (name.equalsIgnoreCase("STATUS")) {
-    String msg = String("{\"ok\":true,\"type\":\"status\",\"wifi\":") +
-                 (net_isWifiConnected() ? "1" : "0") +
-                 ",\"mqtt\":" +
-                 (net_isConnected() ? "1" : "0") +
-                 ",\"relay\":" +
-                 (relayLevel == HIGH ? "1" : "0") +
-                 "}";
-    ble_ok(msg);
-    return;
-  }
+// Resultado del último escaneo: [["ssid",rssi,abierta,conocida],...]
+static void renderWifiScan(BleReply& r) {
+  NetWifiScanEntry nets[6];
+  uint32_t ageMs;
+  size_t n = net_getWifiScan(nets, 6, ageMs);
+
+  ble_reply(r, "{\"ok\":true,\"type\":\"wifi_scan\",\"age_s\":%lu,\"nets\":[",
+            (unsigned long)(ageMs / 1000));
+
+  for (size_t i = 0; i < n; i++) {
+    char ssid[67];   // escapado: hasta 2 chars por byte
+    size_t o = 0;
+    for (const char* c = nets[i].ssid; *c && o + 2 < sizeof(ssid); c++) {
+      if ((unsigned char)*c < 0x20) continue;
+      if (*c == '"' || *c == '\\') ssid[o++] = '\\';
+      ssid[o++] = *c;
+    }
+    ssid[o] = '\0';
 
-  if (name.equalsIgnoreCase("INFO")) {
-    String msg = String("{\"ok\":true,\"type\":\"info\",\"heap\":") +
-                 ESP.getFreeHeap() +
-                 ",\"rssi\":" +
-                 (net_isWifiConnected() ? String(WiFi.RSSI()) : String(-999)) +
-                 "}";
-    ble_ok(msg);
-    return;
+    int w = snprintf(r.buf + r.len, r.cap - r.len, "%s[\"%s\",%d,%d,%d]",
+                     i ? "," : "", ssid, (int)nets[i].rssi,
+                     nets[i].open ? 1 : 0, nets[i].known ? 1 : 0);
+    if (w < 0 || r.len + (size_t)w + 3 > r.cap) break;   // deja sitio para el cierre
+    r.len += (size_t)w;
   }
+  memcpy(r.buf + r.len, "]}", 3);
+  r.len += 2;
+}
 
-  if (name.equalsIgnoreCase("REBOOT")) {
-    ble_ok("{\"ok\":true,\"type\":\"action\",\"name\":\"REBOOT\"}");
-    delay(250);
-    ESP.restart();
-    return;
-  }
+static void onNetProgress(NetProgress p) {
+  if (p == NET_PROGRESS_SCAN_DONE) {
+    if (!wifiScanWaiting) return;
+    wifiScanWaiting = false;
 
-  if (name.equalsIgnoreCase("CLEAR_WIFI")) {
-    ble_ok("{\"ok\":true,\"type\":\"action\",\"name\":\"CLEAR_WIFI\"}");
-    delay(250);
-    ESP.restart();
+    static char buf[448];
+    BleReply r = { buf, sizeof(buf), 0 };
+    renderWifiScan(r);
+    ble_replyFlush(r);
     return;
   }
 
-  ble_ok("{\"ok\":false,\"err\":\"UNKNOWN_ACTION\"}");
+  if (!wifiProvisioning) return;
+
+  switch (p) {
+    case NET_PROGRESS_WIFI_OK:
+      ble_ok("{\"ok\":true,\"type\":\"wifi\",\"status\":\"WIFI_OK\"}");
+      break;
+    case NET_PROGRESS_WIFI_FAIL:
+      ble_ok("{\"ok\":false,\"type\":\"wifi\",\"status\":\"WIFI_FAIL\"}");
+      wifiProvisioning = false;
+      break;
+    case NET_PROGRESS_BOOTSTRAP_OK:
+      ble_ok("{\"ok\":true,\"type\":\"wifi\",\"status\":\"BOOTSTRAP_OK\"}");
+      break;
+    case NET_PROGRESS_BOOTSTRAP_FAIL:
+      ble_ok("{\"ok\":false,\"type\":\"wifi\",\"status\":\"BOOTSTRAP_FAIL\"}");
+      break;
+    case NET_PROGRESS_MQTT_OK:
+      ble_ok("{\"ok\":true,\"type\":\"wifi\",\"status\":\"MQTT_OK\"}");
+      wifiProvisioning = false;
+      break;
+    case NET_PROGRESS_MQTT_FAIL:
+      ble_ok("{\"ok\":false,\"type\":\"wifi\",\"status\":\"MQTT_FAIL\"}");
+      break;
+    default:
+      break;
+  }
 }
 
 // ======================
-// BLE RX
+// Actions (STATUS / INFO / REBOOT / CLEAR_WIFI / WIFI_SCAN)
 // ======================
 
-void onBleWrite(const String& value) {
-  Serial.print("[MAIN] BLE RX: ");
-  Serial.println(value);
-
-  // A) JSON
-  if (isJsonPayload(value)) {
-    StaticJsonDocument<512> doc;
-    DeserializationError err = deserializeJson(doc, value);
-    if (err) {
-      Serial.print("❌ BLE JSON parse error: ");
-      Serial.println(err.c_str());
-      ble_ok("{\"ok\":false,\"err\":\"JSON_PARSE\"}");
-      return;
-    }
+static void actionStatus(BleReply& r) {
+  ble_reply(r, "{\"ok\":true,\"type\":\"status\",\"wifi\":%d,\"mqtt\":%d,\"relay\":%d}",
+            net_isWifiConnected() ? 1 : 0,
+            net_isConnected() ? 1 : 0,
+            vpinState[VPIN_RELAY] ? 1 : 0);
+}
 
-    // ✅ 1) Si viene "type", usamos el router normal
-    String t = (const char*)(doc["type"] | "");
+// INFO entero si el peer lo recibe (cabe en el MTU o habla framing); si no,
+// en INFO_PARTS notifies {"ok":true,"type":"info","part":i,"parts":n,...}
+#define INFO_PARTS    5
+#define INFO_PART_MAX 144
+
+static void actionInfo(BleReply& r) {
+  NetTlsStats tb, tm;
+  net_getTlsStats(tb, tm);
+  uint32_t tlsFull = tb.full + tm.full;
+  uint32_t tlsAvg  = tlsFull ? (tb.totalMs + tm.totalMs) / tlsFull : 0;
+  uint32_t tlsRes  = tb.resumed + tm.resumed;
+  uint32_t tlsResAvg = tlsRes ? (tb.resumedMs + tm.resumedMs) / tlsRes : 0;
+
+  ProfReport pr;
+  prof_getReport(pr);
+
+  NetWifiStats ws;
+  net_getWifiStats(ws);
+
+  // tls_*: handshakes completos y sesiones reanudadas, con su media en ms
+  // p50/p99 en µs por etapa: dispatch, gpio, publish, notify (1000000 =
+  // 1 s o más; las métricas MQTT lo distinguen con "p99_gt")
+  // stall: último "sección:ms"; loop_max: peor sección de la última ventana
+  // wdt_starved: 1 mientras el loop está enfermo/atascado (sin feed)
+  // mqtt_watch: 1 si el socket MQTT se espera con select (0 = sondeo)
+  // wifi: "ruta:ms" de la última conexión (direct, scanned o full);
+  // wifi_direct: [ok, cayó a escaneo]
+  static char part[INFO_PARTS][INFO_PART_MAX];
+  snprintf(part[0], INFO_PART_MAX, ",\"heap\":%lu,\"heap_min\":%lu,\"rssi\":%d,\"log_drop\":%lu,\"nvs_w\":%lu,\"wdt_starved\":%d",
+           (unsigned long)hal_freeHeap(),
+           (unsigned long)hal_minFreeHeap(),
+           net_isWifiConnected() ? hal_wifiRSSI() : -999,
+           (unsigned long)neblog_dropped(),
+           (unsigned long)cfg_flashWrites(),
+           pr.wdtStarved ? 1 : 0);
+  snprintf(part[1], INFO_PART_MAX, ",\"stalls\":%lu,\"stall\":\"%s:%lu\",\"loop_max\":\"%s:%lu\",\"wdt\":%lu,\"wdt_sec\":\"%s\"",
+           (unsigned long)pr.stalls,
+           prof_sectionName(pr.lastStallSection), (unsigned long)pr.lastStallMs,
+           prof_sectionName(pr.worstSection), (unsigned long)pr.worstMaxMs,
+           (unsigned long)pr.wdtResets,
+           prof_sectionName(pr.wdtSection));
+  snprintf(part[2], INFO_PART_MAX, ",\"tls_full\":%lu,\"tls_avg_ms\":%lu,\"tls_resumed\":%lu,\"tls_resumed_ms\":%lu",
+           (unsigned long)tlsFull,
+           (unsigned long)tlsAvg,
+           (unsigned long)tlsRes,
+           (unsigned long)tlsResAvg);
+  snprintf(part[3], INFO_PART_MAX, ",\"p50\":[%lu,%lu,%lu,%lu],\"p99\":[%lu,%lu,%lu,%lu]",
+           (unsigned long)lat_percentileUs(LAT_DISPATCH, 50),
+           (unsigned long)lat_percentileUs(LAT_GPIO, 50),
+           (unsigned long)lat_percentileUs(LAT_PUBLISH, 50),
+           (unsigned long)lat_percentileUs(LAT_NOTIFY, 50),
+           (unsigned long)lat_percentileUs(LAT_DISPATCH, 99),
+           (unsigned long)lat_percentileUs(LAT_GPIO, 99),
+           (unsigned long)lat_percentileUs(LAT_PUBLISH, 99),
+           (unsigned long)lat_percentileUs(LAT_NOTIFY, 99));
+  snprintf(part[4], INFO_PART_MAX, ",\"wifi\":\"%s:%lu\",\"wifi_direct\":[%lu,%lu],\"mqtt_watch\":%d",
+           ws.lastPath == NET_WIFI_DIRECT ? "direct" : ws.lastPath == NET_WIFI_SCANNED ? "scanned" : "full",
+           (unsigned long)ws.lastMs,
+           (unsigned long)ws.directOk, (unsigned long)ws.directFail,
+           net_isMqttWatched() ? 1 : 0);
+
+  ble_reply(r, "{\"ok\":true,\"type\":\"info\"%s%s%s%s%s}", part[0], part[1], part[2], part[3], part[4]);
+  if (r.len + 1 < r.cap && r.len <= ble_notifyMax()) return;
+
+  // app sin framing y MTU corto: una parte por notify, cada una un JSON
+  // completo; con los contadores al máximo caben en MTU 185
+  for (uint8_t i = 0; i < INFO_PARTS; i++) {
+    if (i > 0) ble_replyFlush(r);
+    ble_reply(r, "{\"ok\":true,\"type\":\"info\",\"part\":%u,\"parts\":%u%s}",
+              (unsigned)(i + 1), (unsigned)INFO_PARTS, part[i]);
+  }
+}
 
-    // ✅ 2) Si NO viene type, inferimos:
-    // - si trae "ssid" => wifi provisioning
-    // - si trae "value" => relay
-    if (t.length() == 0) {
-      if (doc.containsKey("ssid")) {
-        String ssid = (const char*)(doc["ssid"] | "");
+static void actionReboot(BleReply& r) {
+  ble_reply(r, "{\"ok\":true,\"type\":\"action\",\"name\":\"REBOOT\"}");
+  ble_replyFlush(r);
+  cfg_commit();
+  delay(250);
+  hal_restart();
+}
 
-        // acepta "pass" o "password"
-        String pass = (const char*)(doc["pass"] | "");
-        if (pass.length() == 0) pass = (const char*)(doc["password"] | "");
+static void actionClearWifi(BleReply& r) {
+  ble_reply(r, "{\"ok\":true,\"type\":\"action\",\"name\":\"CLEAR_WIFI\"}");
+  ble_replyFlush(r);
+  cfg_commit();
+  delay(250);
+  hal_restart();
+}
 
-        bool save = doc["save"] | true;
+// Escaneo reciente: respuesta inmediata; si no, "SCANNING" y el resultado
+// llega como notify al terminar (un solo escaneo aunque se pida varias veces)
+static void actionWifiScan(BleReply& r) {
+  static const uint32_t WIFI_SCAN_REUSE_MS = 30000;
 
-        Serial.println("✅ [MAIN] JSON inferido como WIFI (sin type)");
-        handleWifi(ssid, pass, save);
-        return;
-      }
+  NetWifiScanEntry probe;
+  uint32_t ageMs;
+  net_getWifiScan(&probe, 1, ageMs);
+  if (ageMs < WIFI_SCAN_REUSE_MS) {
+    renderWifiScan(r);
+    return;
+  }
 
-      if (doc.containsKey("value")) {
-        int v = doc["value"] | -1;
-        Serial.println("✅ [MAIN] JSON inferido como RELAY (sin type)");
-        handleRelay(v);
-        return;
-      }
+  wifiScanWaiting = true;
+  net_requestWifiScan();
+  ble_reply(r, "{\"ok\":true,\"type\":\"wifi_scan\",\"status\":\"SCANNING\"}");
+}
 
-      Serial.println("❌ [MAIN] JSON sin type y sin campos conocidos");
-      ble_ok("{\"ok\":false,\"err\":\"JSON_NO_TYPE\"}");
+struct ActionDef {
+  const char* name;
+  void (*fn)(BleReply& r);
+};
+
+static constexpr ActionDef ACTIONS[] = {
+  { "STATUS",     actionStatus },
+  { "INFO",       actionInfo },
+  { "REBOOT",     actionReboot },
+  { "CLEAR_WIFI", actionClearWifi },
+  { "WIFI_SCAN",  actionWifiScan },
+};
+
+static void handleAction(const JsonSpan& name, BleReply& r) {
+  for (const ActionDef& a : ACTIONS) {
+    if (jscan_eqIgnoreCase(name, a.name)) {
+      a.fn(r);
       return;
     }
+  }
+  ble_reply(r, "{\"ok\":false,\"err\":\"UNKNOWN_ACTION\"}");
+}
 
-    // Router por type (como antes)
-    if (t == "wifi") {
-      String ssid = (const char*)(doc["ssid"] | "");
-      String pass = (const char*)(doc["pass"] | "");
-      if (pass.length() == 0) pass = (const char*)(doc["password"] | "");
-      bool save = doc["save"] | true;
+// ======================
+// BLE RX: rutas
+// ======================
 
-      Serial.println("✅ [MAIN] type=wifi");
-      handleWifi(ssid, pass, save);
-      return;
-    }
+// Un elemento de "networks": {"ssid":..,"pass"|"password":..}
+struct WifiListCtx {
+  char ssid[NET_WIFI_LIST_MAX][33];
+  char pass[NET_WIFI_LIST_MAX][65];
+  NetWifiCred creds[NET_WIFI_LIST_MAX];
+  size_t count;
+  bool tooLong;
+};
+
+static bool onWifiNetField(const JsonField& f, void* ctx) {
+  BleCmd& c = *(BleCmd*)ctx;
+  if (f.type != JSCAN_STRING) return true;
+  if (jscan_eq(f.key, "ssid"))          c.ssid = f.val;
+  else if (jscan_eq(f.key, "pass"))     c.pass = f.val;
+  else if (jscan_eq(f.key, "password")) c.password = f.val;
+  return true;
+}
 
-    if (t == "relay") {
-      int v = doc["value"] | -1;
-      Serial.println("✅ [MAIN] type=relay");
-      handleRelay(v);
-      return;
-    }
+static bool onWifiNetItem(const JsonField& item, void* ctx) {
+  WifiListCtx& l = *(WifiListCtx*)ctx;
+  if (l.count >= NET_WIFI_LIST_MAX) return false;
 
-    if (t == "action") {
-      String name = (const char*)(doc["name"] | "");
-      if (name.length() == 0) {
-        ble_ok("{\"ok\":false,\"err\":\"ACTION_NAME_EMPTY\"}");
-        return;
-      }
-      Serial.println("✅ [MAIN] type=action");
-      handleAction(name);
-      return;
-    }
+  BleCmd net;
+  memset(&net, 0, sizeof(net));
+  if (item.type != JSCAN_OTHER || !jscan_object(item.val.p, item.val.len, onWifiNetField, &net)) return true;
+  if (net.ssid.len == 0) return true;
 
-    if (t == "cmd") {
-      String cmd = (const char*)(doc["value"] | "");
-      if (cmd.length() == 0) {
-        ble_ok("{\"ok\":false,\"err\":\"CMD_EMPTY\"}");
-        return;
-      }
-      Serial.println("✅ [MAIN] type=cmd");
-      handleAction(cmd);
-      return;
-    }
+  const JsonSpan& p = net.pass.len > 0 ? net.pass : net.password;
+  if (!jscan_unescape(net.ssid, l.ssid[l.count], sizeof(l.ssid[0])) ||
+      !jscan_unescape(p, l.pass[l.count], sizeof(l.pass[0]))) {
+    l.tooLong = true;
+    return false;
+  }
+  l.creds[l.count] = { l.ssid[l.count], l.pass[l.count] };
+  l.count++;
+  return true;
+}
+
+// {"type":"wifi","networks":[...]} o JSON con "networks"
+static void routeWifiListJson(const BleCmd& c, BleReply& r) {
+  static WifiListCtx l;
+  l.count = 0;
+  l.tooLong = false;
+
+  if (!jscan_array(c.networks.val, onWifiNetItem, &l)) {
+    ble_reply(r, "{\"ok\":false,\"err\":\"JSON_PARSE\"}");
+    return;
+  }
+  if (l.tooLong) {
+    ble_reply(r, "{\"ok\":false,\"err\":\"WIFI_CREDS_TOO_LONG\"}");
+    return;
+  }
+
+  bool save = (c.save.type != JSCAN_FALSE);
+  handleWifiList(l.creds, l.count, save, r);
+}
+
+// {"type":"wifi"} o JSON con "ssid": acepta "pass" o "password"
+static void routeWifiJson(const BleCmd& c, BleReply& r) {
+  if (c.networks.type == JSCAN_OTHER) {
+    routeWifiListJson(c, r);
+    return;
+  }
 
-    ble_ok("{\"ok\":false,\"err\":\"JSON_TYPE_UNKNOWN\"}");
+  char ssid[33];
+  char pass[65];
+  const JsonSpan& p = c.pass.len > 0 ? c.pass : c.password;
+
+  if (!jscan_unescape(c.ssid, ssid, sizeof(ssid)) ||
+      !jscan_unescape(p, pass, sizeof(pass))) {
+    ble_reply(r, "{\"ok\":false,\"err\":\"WIFI_CREDS_TOO_LONG\"}");
     return;
   }
 
-  // B) Legacy / simple
-  String ssid, pass;
-  if (parseWifiCmd(value, ssid, pass)) {
-    Serial.println("✅ [MAIN] Legacy WIFI:ssid|pass");
-    handleWifi(ssid, pass, true);
+  bool save = (c.save.type != JSCAN_FALSE);
+  handleWifi(ssid, pass, save, r);
+}
+
+// {"type":"relay"} o JSON con "value"; "vpin" opcional (V0 por defecto).
+// "value" tiene que ser un entero: "1" o true son RELAY_VALUE_INVALID
+static void routeRelayJson(const BleCmd& c, BleReply& r) {
+  int v = -1;
+  if (!jscan_toIntStrict(c.value, v)) v = -1;
+
+  int idx = c.vpin.len > 0 ? vpin_parseIndex(c.vpin.p, c.vpin.len) : VPIN_RELAY;
+  handleRelay(idx, v, r);
+}
+
+static void routeActionJson(const BleCmd& c, BleReply& r) {
+  if (c.name.len == 0) {
+    ble_reply(r, "{\"ok\":false,\"err\":\"ACTION_NAME_EMPTY\"}");
     return;
   }
+  handleAction(c.name, r);
+}
 
-  if (value == "1" || value == "0") {
-    handleRelay(value.toInt());
+static void routeCmdJson(const BleCmd& c, BleReply& r) {
+  if (c.value.type != JSCAN_STRING || c.value.val.len == 0) {
+    ble_reply(r, "{\"ok\":false,\"err\":\"CMD_EMPTY\"}");
     return;
   }
+  handleAction(c.value.val, r);
+}
+
+// Legacy "WIFI:ssid|pass" (pass opcional)
+static void routeWifiText(const BleCmd& c, BleReply& r) {
+  JsonSpan ssidSpan = c.arg;
+  JsonSpan passSpan = { c.arg.p + c.arg.len, 0 };
+
+  for (uint16_t i = 0; i < c.arg.len; i++) {
+    if (c.arg.p[i] == '|') {
+      ssidSpan.len = i;
+      passSpan.p = c.arg.p + i + 1;
+      passSpan.len = (uint16_t)(c.arg.len - i - 1);
+      break;
+    }
+  }
+
+  // trim de cada parte
+  while (ssidSpan.len > 0 && isspace((unsigned char)ssidSpan.p[0])) { ssidSpan.p++; ssidSpan.len--; }
+  while (ssidSpan.len > 0 && isspace((unsigned char)ssidSpan.p[ssidSpan.len - 1])) ssidSpan.len--;
+  while (passSpan.len > 0 && isspace((unsigned char)passSpan.p[0])) { passSpan.p++; passSpan.len--; }
+  while (passSpan.len > 0 && isspace((unsigned char)passSpan.p[passSpan.len - 1])) passSpan.len--;
 
-  if (value.equalsIgnoreCase("STATUS") ||
-      value.equalsIgnoreCase("INFO") ||
-      value.equalsIgnoreCase("REBOOT") ||
-      value.equalsIgnoreCase("CLEAR_WIFI")) {
-    handleAction(value);
+  char ssid[33];
+  char pass[65];
+  if (!jscan_copy(ssidSpan, ssid, sizeof(ssid)) || !jscan_copy(passSpan, pass, sizeof(pass))) {
+    ble_reply(r, "{\"ok\":false,\"err\":\"WIFI_CREDS_TOO_LONG\"}");
     return;
   }
+  handleWifi(ssid, pass, true, r);
+}
+
+static void routeRelayText(const BleCmd& c, BleReply& r) {
+  handleRelay(VPIN_RELAY, c.raw[0] - '0', r);
+}
+
+static void routeActionText(const BleCmd& c, BleReply& r) {
+  JsonSpan name = { c.raw, (uint16_t)c.len };
+  handleAction(name, r);
+}
+
+// El orden importa en las formas inferidas (JSON_KEY): "ssid" antes que "value"
+static constexpr BleRoute BLE_ROUTES[] = {
+  { BLE_ROUTE_JSON_TYPE,   "wifi",       routeWifiJson },
+  { BLE_ROUTE_JSON_TYPE,   "relay",      routeRelayJson },
+  { BLE_ROUTE_JSON_TYPE,   "action",     routeActionJson },
+  { BLE_ROUTE_JSON_TYPE,   "cmd",        routeCmdJson },
+  { BLE_ROUTE_JSON_KEY,    "networks",   routeWifiListJson },
+  { BLE_ROUTE_JSON_KEY,    "ssid",       routeWifiJson },
+  { BLE_ROUTE_JSON_KEY,    "value",      routeRelayJson },
+  { BLE_ROUTE_TEXT_PREFIX, "WIFI:",      routeWifiText },
+  { BLE_ROUTE_TEXT_EQ,     "1",          routeRelayText },
+  { BLE_ROUTE_TEXT_EQ,     "0",          routeRelayText },
+  { BLE_ROUTE_TEXT_EQ,     "STATUS",     routeActionText },
+  { BLE_ROUTE_TEXT_EQ,     "INFO",       routeActionText },
+  { BLE_ROUTE_TEXT_EQ,     "REBOOT",     routeActionText },
+  { BLE_ROUTE_TEXT_EQ,     "CLEAR_WIFI", routeActionText },
+  { BLE_ROUTE_TEXT_EQ,     "WIFI_SCAN",  routeActionText },
+};
 
-  ble_ok("{\"ok\":false,\"err\":\"UNKNOWN_CMD\"}");
+// ======================
+// BLE RX
+// ======================
+
+void onBleWrite(const uint8_t* data, size_t len) {
+  static char replyBuf[512];   // INFO es la respuesta más larga
+  BleReply reply = { replyBuf, sizeof(replyBuf), 0 };
+  replyBuf[0] = '\0';
+
+  ble_route(BLE_ROUTES, data, len, reply);
+  ble_replyFlush(reply);
 }
 
 // ======================
 // MQTT cmd
 // ======================
 
-void onMqttCmd(const String& vpin, int valueInt) {
-  if (vpin == "V0") applyRelay(valueInt > 0 ? 1 : 0, "MQTT");
+bool onMqttCmd(const char* vpin, int valueInt) {
+  int idx = vpin_parseIndex(vpin);
+  if (idx < 0 || idx >= (int)VPIN_COUNT) return false;
+  applyVpin(idx, valueInt, "MQTT");
+  return true;
+}
+
+// Estado completo al (re)conectar MQTT: una pasada por la tabla
+static void publishAll() {
+  for (size_t i = 0; i < VPIN_COUNT; i++) {
+    net_publishState(VPINS[i].name, vpinState[i]);
+  }
+}
+
+#if defined(NEBADON_BENCH)
+// ======================
+// Benchmark (-DNEBADON_BENCH): corre antes de arrancar WiFi/BLE
+// ======================
+
+static size_t benchBle(const char* p, size_t len) {
+  onBleWrite((const uint8_t*)p, len);
+  return len;
+}
+
+static size_t benchMqtt(const char* p, size_t len) {
+  net_benchMqttMessage(p, len, false);
+  return len;
+}
+
+static size_t benchMqttCbor(const char* p, size_t len) {
+  net_benchMqttMessage(p, len, true);
+  return len;
+}
+
+#if defined(NET_BENCH_ARDUINOJSON)
+static size_t benchMqttArduinoJson(const char* p, size_t len) {
+  net_benchMqttMessageArduinoJson(p, len);
+  return len;
+}
+
+static size_t benchRenderStateArduinoJson(const char* p, size_t len) {
+  (void)p; (void)len;
+  return net_benchRenderStateArduinoJson("V0", 1);
+}
+#endif
+
+static size_t benchRenderState(const char* p, size_t len) {
+  (void)p; (void)len;
+  return net_benchRenderState("V0", 1, false);
+}
+
+static size_t benchRenderStateCbor(const char* p, size_t len) {
+  (void)p; (void)len;
+  return net_benchRenderState("V0", 1, true);
+}
+
+static size_t benchPublishState(const char* p, size_t len) {
+  (void)p; (void)len;
+  net_publishState("V0", 1);
+  return 0;
+}
+
+static size_t benchApplyVpin(const char* p, size_t len) {
+  (void)p; (void)len;
+  applyVpin(VPIN_RELAY, 0, "BENCH");
+  return 0;
 }
 
+// {1: 0, 2: 1} == {"vpin":"V0","value":1} en topic .../cmd/cbor
+static const char BENCH_CBOR_CMD[] = { '\xA2', 0x01, 0x00, 0x02, 0x01 };
+
+static const BenchCase BENCH_CASES[] = {
+  { "ble_legacy_wifi",    benchBle,  "WIFI:MiCasa-2G|clave-super-secreta" },
+  { "ble_legacy_relay",   benchBle,  "1" },
+  { "ble_legacy_action",  benchBle,  "STATUS" },
+  { "ble_typed_wifi",     benchBle,  "{\"type\":\"wifi\",\"ssid\":\"MiCasa-2G\",\"pass\":\"clave-super-secreta\",\"save\":false}" },
+  { "ble_typed_relay",    benchBle,  "{\"type\":\"relay\",\"vpin\":\"V0\",\"value\":1}" },
+  { "ble_typed_cmd",      benchBle,  "{\"type\":\"cmd\",\"value\":\"STATUS\"}" },
+  { "ble_inferred_wifi",  benchBle,  "{\"ssid\":\"MiCasa-2G\",\"password\":\"clave-super-secreta\"}" },
+  { "ble_typed_wifi_list", benchBle, "{\"type\":\"wifi\",\"save\":false,\"networks\":[{\"ssid\":\"MiCasa-2G\",\"pass\":\"clave-super-secreta\"},{\"ssid\":\"MiCasa-5G\",\"password\":\"otra-clave\"},{\"ssid\":\"Taller\",\"pass\":\"\"}]}" },
+  { "ble_inferred_relay", benchBle,  "{\"value\":0}" },
+  { "mqtt_cmd_vpin",      benchMqtt, "{\"type\":\"cmd\",\"tenant_id\":\"77ec876c-b9f7-4170-a70a-647d85f58216\",\"vpin\":\"V0\",\"value\":1}" },
+  { "mqtt_cmd_pin_str",   benchMqtt, "{\"tenant_id\":\"77ec876c-b9f7-4170-a70a-647d85f58216\",\"pin\":\"V0\",\"value\":\"0\"}" },
+  { "mqtt_cmd_dup_id",    benchMqtt, "{\"type\":\"cmd\",\"cmd_id\":\"c-0001\",\"vpin\":\"V0\",\"value\":1}" },
+  { "mqtt_cmd_other_tenant", benchMqtt, "{\"type\":\"cmd\",\"tenant_id\":\"00000000-0000-0000-0000-000000000000\",\"vpin\":\"V0\",\"value\":1}" },
+  { "mqtt_cmd_cbor",      benchMqttCbor, BENCH_CBOR_CMD, sizeof(BENCH_CBOR_CMD) },
+#if defined(NET_BENCH_ARDUINOJSON)
+  // antes/después: mismos payloads por el parser con ArduinoJson
+  { "mqtt_cmd_vpin_arduinojson",    benchMqttArduinoJson, "{\"type\":\"cmd\",\"tenant_id\":\"77ec876c-b9f7-4170-a70a-647d85f58216\",\"vpin\":\"V0\",\"value\":1}" },
+  { "mqtt_cmd_pin_str_arduinojson", benchMqttArduinoJson, "{\"tenant_id\":\"77ec876c-b9f7-4170-a70a-647d85f58216\",\"pin\":\"V0\",\"value\":\"0\"}" },
+#endif
+  { "state_render",       benchRenderState,  nullptr },
+  { "state_render_cbor",  benchRenderStateCbor, nullptr },
+#if defined(NET_BENCH_ARDUINOJSON)
+  { "state_render_arduinojson", benchRenderStateArduinoJson, nullptr },
+#endif
+  { "state_publish",      benchPublishState, nullptr },
+  { "apply_vpin",         benchApplyVpin,    nullptr },
+};
+
+static void runBench(const NetConfig& cfg) {
+  benchRunning = true;
+  net_benchBegin(cfg, onMqttCmd);
+  bench_run(BENCH_CASES, sizeof(BENCH_CASES) / sizeof(BENCH_CASES[0]));
+  benchRunning = false;
+
+  // nada del bench sobrevive al arranque real: ids de cmd vistos, estados
+  // encolados y muestras de latencia
+  net_benchEnd();
+  lat_reset();
+}
+#endif
+
 // ======================
 // Setup / Loop
 // ======================
 
+// Salidas al último estado conocido (RTC o NVS), sin esperar a la nube
+static void restoreVpins() {
+  uint32_t bits = vpin_persistRestore();
+  for (size_t i = 0; i < VPIN_COUNT; i++) {
+    const VpinDef& def = VPINS[i];
+    if (def.type == VPIN_DIGITAL_OUT) hal_gpioOutput(def.gpio);
+    vpinState[i] = def.handler(def, (bits >> i) & 1u);
+  }
+}
+
 void setup() {
   Serial.begin(115200);
-  delay(300);
 
-  pinMode(RELAY_PIN, OUTPUT);
-  digitalWrite(RELAY_PIN, LOW);
+  // Lo primero: el relé vuelve a su estado en ms, antes que la red
+  cfg_begin();
+  restoreVpins();
+
+  delay(300);
+  neblog_begin();
+  prof_begin();
+  wake_begin();
 
   NetConfig cfg;
   cfg.wifi_ssid = "";
@@ -324,17 +748,31 @@ void setup() {
   cfg.api_base       = "https://api.nebadon.cloud";
   cfg.bootstrap_path = "/devices/bootstrap";
 
+#if defined(NEBADON_BENCH)
+  runBench(cfg);
+#endif
+
+  net_setProgressFn(onNetProgress);
+  net_setPublishAllFn(publishAll);
   net_begin(cfg, onMqttCmd);
 
   ble_begin("ESP32-NEBADON2", SERVICE_UUID, CHARACTERISTIC_UUID, onBleWrite);
 
-  Serial.println("✅ Ready: BLE(JSON+infer+cmd) + WiFi Provisioning + MQTT + Relay");
-  Serial.print("Relay pin: ");
-  Serial.println(RELAY_PIN);
+  LOGI("✅ Ready: BLE(JSON+infer+cmd) + WiFi Provisioning + MQTT + Relay");
+  LOGI("Relay pin: %d | vpins: %d", RELAY_PIN, (int)VPIN_COUNT);
 }
 
 void loop() {
-  ble_loop();
+  prof_loopStart();
+  {
+    ProfScope p(PROF_BLE);
+    ble_loop();
+  }
   net_loop();
-  delay(5);
+  provisioningPoll();
+  cfg_loop();
+  prof_loopEnd();
+
+  // duerme hasta un evento (BLE, MQTT, WiFi, hora) o el próximo timer
+  wake_wait();
 }
\ No newline at end of file
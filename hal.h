@@ -0,0 +1,150 @@
+#pragma once
+#include <Arduino.h>
+#include <Client.h>
+
+// Capa de hardware: lo que toca el SDK del ESP32 (WiFi, sockets TLS,
+// HTTPClient, Preferences, GPIO, SNTP) pasa por estas funciones.
+// La implementación para placa está en hal_esp32.cpp; otra plataforma
+// (p. ej. un build nativo con fakes) solo tiene que dar otra.
+// PubSubClient trabaja sobre el Client de hal_netClient() y el BLE ya
+// queda detrás de ble_control.h.
+
+// ======================
+// GPIO
+// ======================
+void hal_gpioOutput(uint8_t pin);
+void hal_gpioWrite(uint8_t pin, int level);
+
+// ======================
+// Sistema
+// ======================
+uint32_t hal_freeHeap();
+uint32_t hal_minFreeHeap();   // mínimo desde el arranque (pico de uso)
+void hal_restart();
+void hal_readMac(uint8_t mac[6]);
+uint64_t hal_efuseMac();
+const char* hal_chipModel();
+uint32_t hal_cycleCount();  // contador de ciclos de la CPU (da la vuelta)
+uint32_t hal_cpuMhz();
+uint32_t hal_random();      // RNG de hardware
+
+// Watchdog de tareas: suscribe la tarea que llama (loop)
+void hal_wdtBegin(uint32_t timeoutMs);
+void hal_wdtFeed();
+bool hal_resetWasWatchdog();
+bool hal_resetWasPowerOn();   // encendido en frío: RTC sin datos válidos
+
+// ======================
+// NVS clave/valor (un namespace abierto a la vez)
+// ======================
+bool hal_kvOpen(const char* ns, bool readOnly);
+void hal_kvClose();
+String hal_kvGetString(const char* key);
+bool hal_kvPutString(const char* key, const String& value);
+uint32_t hal_kvGetU32(const char* key, uint32_t def);
+bool hal_kvPutU32(const char* key, uint32_t value);
+bool hal_kvRemove(const char* key);
+
+// ======================
+// WiFi STA
+// ======================
+enum HalWifiStatus : uint8_t {
+  HAL_WIFI_IDLE = 0,
+  HAL_WIFI_CONNECTED,       // con IP
+  HAL_WIFI_CONNECT_FAILED,
+  HAL_WIFI_NO_SSID,
+  HAL_WIFI_DISCONNECTED,
+};
+
+// Enlace conocido: AP concreto + concesión DHCP (IPv4 como uint32 de IPAddress)
+struct HalWifiLink {
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip, gateway, mask, dns;
+};
+
+void hal_wifiInit();        // STA, sin persistencia ni auto-reconexión
+// Escaneo completo + DHCP
+void hal_wifiBegin(const char* ssid, const char* pass);
+// Asociación dirigida (BSSID/canal, sin escaneo) y, si link.ip != 0,
+// IP fija con la concesión anterior (sin DHCP)
+void hal_wifiBeginDirect(const char* ssid, const char* pass, const HalWifiLink& link);
+// Enlace actual (válido con HAL_WIFI_CONNECTED)
+bool hal_wifiGetLink(HalWifiLink& out);
+HalWifiStatus hal_wifiStatus();
+// Aviso en cualquier cambio de estado STA (corre en la tarea de eventos)
+enum HalWifiEvent : uint8_t {
+  HAL_WIFI_EV_GOT_IP = 0,     // IP asignada (DHCP o fija)
+  HAL_WIFI_EV_DISCONNECTED,   // el enlace se cayó o el intento falló
+  HAL_WIFI_EV_SCAN_DONE,
+  HAL_WIFI_EV_OTHER,
+};
+typedef void (*HalWifiEventFn)(HalWifiEvent ev);
+void hal_wifiOnEvent(HalWifiEventFn fn);
+String hal_wifiLocalIP();
+int hal_wifiRSSI();
+
+// Escaneo asíncrono (no bloquea; el fin también llega por hal_wifiOnEvent)
+struct HalWifiScanEntry {
+  char ssid[33];
+  int8_t rssi;
+  uint8_t channel;
+  uint8_t bssid[6];
+  bool open;
+};
+
+bool hal_wifiScanStart();
+// -1 = en curso, -2 = falló; si terminó copia hasta max entradas
+// (ordenadas como las entrega el driver), libera el resultado y devuelve n
+int hal_wifiScanPoll(HalWifiScanEntry* out, size_t max);
+
+// ======================
+// Hora (SNTP en segundo plano)
+// ======================
+// onSync corre en la tarea de red: solo debe marcar un flag
+typedef void (*HalTimeSyncFn)();
+void hal_timeSyncStart(HalTimeSyncFn onSync);
+
+// ======================
+// Sockets TCP/TLS por slot
+// ======================
+enum HalNetSlot : uint8_t {
+  HAL_NET_MQTT = 0,
+  HAL_NET_HTTP,
+  HAL_NET_SLOT_COUNT,
+};
+
+struct HalNetOpts {
+  bool tls;
+  bool tlsInsecure;
+  uint32_t timeoutMs;
+};
+
+// El transporte (TCP o TLS) de cada slot se construye aquí, al primer uso:
+// el que no se usa no ocupa RAM. Cambiar de uno a otro destruye el anterior.
+void hal_netSetup(HalNetSlot slot, const HalNetOpts& opts);
+Client& hal_netClient(HalNetSlot slot);
+// Conecta (con handshake TLS si aplica); no hace nada si ya está conectado
+bool hal_netConnect(HalNetSlot slot, const char* host, uint16_t port);
+void hal_netStop(HalNetSlot slot);
+// La última conexión TLS del slot reanudó una sesión guardada (session ID
+// o ticket) en vez de hacer el handshake completo. Las sesiones se
+// guardan por slot en RTC: valen también tras deep sleep.
+bool hal_netResumed(HalNetSlot slot);
+// Espera a que el socket tenga datos o se cierre: 1 = legible/cerrado,
+// 0 = timeout, -1 = sin descriptor (no hay socket o el cliente no lo
+// expone; vuelve al instante). Se puede llamar desde otra tarea.
+int hal_netWaitReadable(HalNetSlot slot, uint32_t timeoutMs);
+
+// ======================
+// HTTP: POST sobre el slot HAL_NET_HTTP (reutiliza el socket si está abierto)
+// ======================
+struct HalHttpHeader {
+  const char* name;
+  const char* value;
+};
+
+// Devuelve el código HTTP (<0 si falló la conexión)
+int hal_httpPost(const String& url,
+                 const HalHttpHeader* headers, size_t headerCount,
+                 const String& body, String& respOut, uint32_t timeoutMs);
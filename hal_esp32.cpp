@@ -0,0 +1,548 @@
+// hal_esp32.cpp
+// Implementación de hal.h sobre Arduino-ESP32
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include "hal.h"
+#include <WiFi.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
+#include <time.h>
+#include <sys/time.h>
+#include "esp_sntp.h"
+#include "esp_mac.h"
+#include "esp_task_wdt.h"
+#include "esp_system.h"
+#include "esp_idf_version.h"
+#include "esp_crt_bundle.h"
+#include "lwip/sockets.h"
+#include "mbedtls/version.h"
+#include "mbedtls/net_sockets.h"
+
+// ======================
+// GPIO
+// ======================
+void hal_gpioOutput(uint8_t pin) {
+  pinMode(pin, OUTPUT);
+}
+
+void hal_gpioWrite(uint8_t pin, int level) {
+  digitalWrite(pin, level);
+}
+
+// ======================
+// Sistema
+// ======================
+uint32_t hal_freeHeap() {
+  return ESP.getFreeHeap();
+}
+
+uint32_t hal_minFreeHeap() {
+  return ESP.getMinFreeHeap();
+}
+
+void hal_restart() {
+  ESP.restart();
+}
+
+void hal_readMac(uint8_t mac[6]) {
+  esp_read_mac(mac, ESP_MAC_WIFI_STA);
+}
+
+uint64_t hal_efuseMac() {
+  return ESP.getEfuseMac();
+}
+
+uint32_t hal_cycleCount() {
+  return ESP.getCycleCount();
+}
+
+uint32_t hal_cpuMhz() {
+  return ESP.getCpuFreqMHz();
+}
+
+uint32_t hal_random() {
+  return esp_random();
+}
+
+void hal_wdtBegin(uint32_t timeoutMs) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_task_wdt_config_t cfg = {
+    timeoutMs,
+    (1u << portNUM_PROCESSORS) - 1,   // sigue vigilando las tareas idle
+    true,
+  };
+  // el core ya suele traer el TWDT iniciado: se reconfigura
+  if (esp_task_wdt_reconfigure(&cfg) != ESP_OK) esp_task_wdt_init(&cfg);
+#else
+  // IDF 4.x (core 2.x): timeout en segundos; init ya iniciado solo lo reconfigura
+  esp_task_wdt_init((timeoutMs + 999) / 1000, true);
+#endif
+  esp_task_wdt_add(nullptr);
+}
+
+void hal_wdtFeed() {
+  esp_task_wdt_reset();
+}
+
+bool hal_resetWasWatchdog() {
+  esp_reset_reason_t r = esp_reset_reason();
+  return r == ESP_RST_TASK_WDT || r == ESP_RST_INT_WDT || r == ESP_RST_WDT;
+}
+
+bool hal_resetWasPowerOn() {
+  esp_reset_reason_t r = esp_reset_reason();
+  return r == ESP_RST_POWERON || r == ESP_RST_UNKNOWN;
+}
+
+const char* hal_chipModel() {
+#if defined(CONFIG_IDF_TARGET_ESP32C6)
+  return "ESP32-C6";
+#elif defined(CONFIG_IDF_TARGET_ESP32S3)
+  return "ESP32-S3";
+#elif defined(CONFIG_IDF_TARGET_ESP32)
+  return "ESP32";
+#else
+  return "ESP32-UNKNOWN";
+#endif
+}
+
+// ======================
+// NVS
+// ======================
+static Preferences _prefs;
+
+bool hal_kvOpen(const char* ns, bool readOnly) {
+  return _prefs.begin(ns, readOnly);
+}
+
+void hal_kvClose() {
+  _prefs.end();
+}
+
+String hal_kvGetString(const char* key) {
+  return _prefs.getString(key, "");
+}
+
+bool hal_kvPutString(const char* key, const String& value) {
+  return _prefs.putString(key, value) == value.length();
+}
+
+uint32_t hal_kvGetU32(const char* key, uint32_t def) {
+  return _prefs.getUInt(key, def);
+}
+
+bool hal_kvPutU32(const char* key, uint32_t value) {
+  return _prefs.putUInt(key, value) == sizeof(value);
+}
+
+bool hal_kvRemove(const char* key) {
+  return _prefs.remove(key);
+}
+
+// ======================
+// WiFi STA
+// ======================
+void hal_wifiInit() {
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+  WiFi.mode(WIFI_STA);
+}
+
+static bool _wifiStaticIp = false;
+
+void hal_wifiBegin(const char* ssid, const char* pass) {
+  WiFi.disconnect(false, true);
+  if (_wifiStaticIp) {
+    // volver a DHCP tras un intento con la concesión en caché
+    WiFi.config(IPAddress(0u), IPAddress(0u), IPAddress(0u));
+    _wifiStaticIp = false;
+  }
+  WiFi.begin(ssid, pass);
+}
+
+void hal_wifiBeginDirect(const char* ssid, const char* pass, const HalWifiLink& link) {
+  WiFi.disconnect(false, true);
+  if (link.ip) {
+    WiFi.config(IPAddress(link.ip), IPAddress(link.gateway), IPAddress(link.mask),
+                IPAddress(link.dns ? link.dns : link.gateway));
+    _wifiStaticIp = true;
+  } else if (_wifiStaticIp) {
+    WiFi.config(IPAddress(0u), IPAddress(0u), IPAddress(0u));
+    _wifiStaticIp = false;
+  }
+  WiFi.begin(ssid, pass, link.channel, link.bssid, true);
+}
+
+bool hal_wifiGetLink(HalWifiLink& out) {
+  if (WiFi.status() != WL_CONNECTED) return false;
+
+  const uint8_t* b = WiFi.BSSID();
+  if (!b) return false;
+  memcpy(out.bssid, b, 6);
+  out.channel = WiFi.channel();
+  out.ip      = (uint32_t)WiFi.localIP();
+  out.gateway = (uint32_t)WiFi.gatewayIP();
+  out.mask    = (uint32_t)WiFi.subnetMask();
+  out.dns     = (uint32_t)WiFi.dnsIP(0);
+  return true;
+}
+
+HalWifiStatus hal_wifiStatus() {
+  switch (WiFi.status()) {
+    case WL_CONNECTED:      return HAL_WIFI_CONNECTED;
+    case WL_CONNECT_FAILED: return HAL_WIFI_CONNECT_FAILED;
+    case WL_NO_SSID_AVAIL:  return HAL_WIFI_NO_SSID;
+    case WL_IDLE_STATUS:    return HAL_WIFI_IDLE;
+    default:                return HAL_WIFI_DISCONNECTED;
+  }
+}
+
+static HalWifiEventFn _wifiEventFn = nullptr;
+
+static void onWifiEvent(arduino_event_id_t event, arduino_event_info_t info) {
+  (void)info;
+  if (!_wifiEventFn) return;
+
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:       _wifiEventFn(HAL_WIFI_EV_GOT_IP); break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:      _wifiEventFn(HAL_WIFI_EV_DISCONNECTED); break;
+    case ARDUINO_EVENT_WIFI_SCAN_DONE:        _wifiEventFn(HAL_WIFI_EV_SCAN_DONE); break;
+    default:                                  _wifiEventFn(HAL_WIFI_EV_OTHER); break;
+  }
+}
+
+void hal_wifiOnEvent(HalWifiEventFn fn) {
+  if (!_wifiEventFn) WiFi.onEvent(onWifiEvent);
+  _wifiEventFn = fn;
+}
+
+String hal_wifiLocalIP() {
+  return WiFi.localIP().toString();
+}
+
+int hal_wifiRSSI() {
+  return WiFi.RSSI();
+}
+
+bool hal_wifiScanStart() {
+  WiFi.scanDelete();
+  return WiFi.scanNetworks(true, false) == WIFI_SCAN_RUNNING;
+}
+
+int hal_wifiScanPoll(HalWifiScanEntry* out, size_t max) {
+  int16_t n = WiFi.scanComplete();
+  if (n == WIFI_SCAN_RUNNING) return -1;
+  if (n < 0) return -2;
+
+  size_t k = 0;
+  for (int16_t i = 0; i < n && k < max; i++) {
+    String ssid = WiFi.SSID(i);
+    if (ssid.length() == 0 || ssid.length() >= sizeof(out[k].ssid)) continue;   // ocultas
+
+    HalWifiScanEntry& e = out[k++];
+    memcpy(e.ssid, ssid.c_str(), ssid.length() + 1);
+    e.rssi = (int8_t)WiFi.RSSI(i);
+    e.channel = (uint8_t)WiFi.channel(i);
+    const uint8_t* b = WiFi.BSSID(i);
+    if (b) memcpy(e.bssid, b, 6);
+    else memset(e.bssid, 0, 6);
+    e.open = WiFi.encryptionType(i) == WIFI_AUTH_OPEN;
+  }
+  WiFi.scanDelete();
+  return (int)k;
+}
+
+// ======================
+// Hora
+// ======================
+static HalTimeSyncFn _onTimeSync = nullptr;
+
+static void onSntpSync(struct timeval* tv) {
+  (void)tv;
+  if (_onTimeSync) _onTimeSync();
+}
+
+void hal_timeSyncStart(HalTimeSyncFn onSync) {
+  _onTimeSync = onSync;
+  sntp_set_time_sync_notification_cb(onSntpSync);
+  configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+}
+
+// ======================
+// Sockets
+// ======================
+// Un transporte por slot, creado al primer uso con el tipo que pida
+// hal_netSetup(). Con la config por defecto (bootstrap https y MQTT 8883)
+// los dos slots son TLS, así que no ahorra heap: solo evita el
+// WiFiClientSecure en un slot que vaya por TCP plano.
+//
+// WiFiClient::fd() no es virtual: en un WiFiClientSecure devuelve el
+// socket (vacío) de la base. El de TLS vive en sslclient->socket, que es
+// protected; HalTlsClient lo expone. sslclient es puntero crudo en el
+// core 2.x y shared_ptr en el 3.x: los dos se usan igual aquí.
+//
+// Resumption: WiFiClientSecure::connect() abre el socket, configura
+// mbedTLS y hace el handshake de una vez, sin hueco para
+// mbedtls_ssl_set_session(). HalTlsClient rehace solo ese paso (lo de
+// start_ssl_client() del core, recortado a lo que usa el firmware:
+// setInsecure o el bundle de CAs) ofreciendo la sesión guardada del slot;
+// read/write/stop siguen siendo los de WiFiClientSecure sobre el mismo
+// sslclient_context.
+//
+// La sesión (session ID o ticket, lo que dé el servidor) se guarda
+// serializada en RTC por slot: sobrevive a reconexiones y a deep sleep.
+// Si el servidor ya no la acepta, el handshake es completo y se guarda la
+// nueva.
+#define HAL_TLS_SESSION_MAX 2048   // con el certificado del peer dentro
+
+struct HalTlsSession {
+  char host[64];
+  uint16_t port;
+  uint16_t len;                    // 0 = no hay sesión
+  uint8_t data[HAL_TLS_SESSION_MAX];
+};
+
+RTC_DATA_ATTR static HalTlsSession _tlsSession[HAL_NET_SLOT_COUNT];
+static bool _tlsResumed[HAL_NET_SLOT_COUNT];
+
+#if MBEDTLS_VERSION_MAJOR >= 3
+#define TLS_SESSION_MASTER(s) ((s).MBEDTLS_PRIVATE(master))
+#else
+#define TLS_SESSION_MASTER(s) ((s).master)
+#endif
+
+class HalTlsClient : public WiFiClientSecure {
+public:
+  explicit HalTlsClient(HalNetSlot slot) : _slot(slot) {}
+
+  int socketFd() const { return sslclient ? sslclient->socket : -1; }
+
+  int connect(const char* host, uint16_t port) override {
+    IPAddress ip;
+    if (!WiFi.hostByName(host, ip)) return 0;
+    if (start(ip, host, port) != 0) {
+      stop();
+      return 0;
+    }
+    _connected = true;
+    return 1;
+  }
+
+private:
+  int openSocket(const IPAddress& ip, uint16_t port, uint32_t timeoutMs);
+  int start(const IPAddress& ip, const char* host, uint16_t port);
+
+  HalNetSlot _slot;
+};
+
+int HalTlsClient::openSocket(const IPAddress& ip, uint16_t port, uint32_t timeoutMs) {
+  int fd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) return -1;
+  sslclient->socket = fd;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = (uint32_t)ip;
+  sa.sin_port = htons(port);
+  if (lwip_connect(fd, (struct sockaddr*)&sa, sizeof(sa)) < 0 && errno != EINPROGRESS) return -1;
+
+  fd_set wr;
+  FD_ZERO(&wr);
+  FD_SET(fd, &wr);
+  struct timeval tv = { (time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000) };
+  int err = 0;
+  socklen_t errLen = sizeof(err);
+  if (select(fd + 1, nullptr, &wr, nullptr, &tv) <= 0) return -1;
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) < 0 || err != 0) return -1;
+  return 0;
+}
+
+int HalTlsClient::start(const IPAddress& ip, const char* host, uint16_t port) {
+  sslclient_context* s = &*sslclient;
+  uint32_t timeoutMs = s->handshake_timeout;
+  _tlsResumed[_slot] = false;
+
+  if (openSocket(ip, port, timeoutMs) != 0) return -1;
+
+  int ret;
+  mbedtls_entropy_init(&s->entropy_ctx);
+  ret = mbedtls_ctr_drbg_seed(&s->drbg_ctx, mbedtls_entropy_func, &s->entropy_ctx,
+                              (const unsigned char*)"nebadon", 7);
+  if (ret != 0) return ret;
+  ret = mbedtls_ssl_config_defaults(&s->ssl_conf, MBEDTLS_SSL_IS_CLIENT,
+                                    MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  if (ret != 0) return ret;
+  if (_use_insecure) {
+    mbedtls_ssl_conf_authmode(&s->ssl_conf, MBEDTLS_SSL_VERIFY_NONE);
+  } else {
+    mbedtls_ssl_conf_authmode(&s->ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    if (esp_crt_bundle_attach(&s->ssl_conf) != ESP_OK) return -1;
+  }
+  mbedtls_ssl_conf_rng(&s->ssl_conf, mbedtls_ctr_drbg_random, &s->drbg_ctx);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  mbedtls_ssl_conf_session_tickets(&s->ssl_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+  if ((ret = mbedtls_ssl_setup(&s->ssl_ctx, &s->ssl_conf)) != 0) return ret;
+  if ((ret = mbedtls_ssl_set_hostname(&s->ssl_ctx, host)) != 0) return ret;
+  mbedtls_ssl_set_bio(&s->ssl_ctx, &s->socket, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+  // la sesión guardada para este host se ofrece; el servidor decide
+  HalTlsSession& cached = _tlsSession[_slot];
+  mbedtls_ssl_session prev;
+  mbedtls_ssl_session_init(&prev);
+  bool offered = cached.len > 0 && cached.port == port && strcmp(cached.host, host) == 0 &&
+                 mbedtls_ssl_session_load(&prev, cached.data, cached.len) == 0 &&
+                 mbedtls_ssl_set_session(&s->ssl_ctx, &prev) == 0;
+
+  unsigned long t0 = millis();
+  while ((ret = mbedtls_ssl_handshake(&s->ssl_ctx)) != 0) {
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) break;
+    if (millis() - t0 > timeoutMs) break;
+    vTaskDelay(2);
+  }
+  if (ret != 0) {
+    if (offered) cached.len = 0;   // por si fue la sesión: el reintento va completo
+    mbedtls_ssl_session_free(&prev);
+    return ret;
+  }
+
+  // Reanudada = mismo master secret que la sesión ofrecida. La que queda
+  // (la misma o una nueva, quizá con ticket nuevo) se guarda.
+  mbedtls_ssl_session now;
+  mbedtls_ssl_session_init(&now);
+  if (mbedtls_ssl_get_session(&s->ssl_ctx, &now) == 0) {
+    _tlsResumed[_slot] = offered && memcmp(TLS_SESSION_MASTER(now), TLS_SESSION_MASTER(prev),
+                                           sizeof(TLS_SESSION_MASTER(now))) == 0;
+    size_t len = 0;
+    if (strlen(host) < sizeof(cached.host) &&
+        mbedtls_ssl_session_save(&now, cached.data, sizeof(cached.data), &len) == 0) {
+      strcpy(cached.host, host);
+      cached.port = port;
+      cached.len = (uint16_t)len;
+    } else {
+      cached.len = 0;   // no entra: este host va sin resumption
+    }
+  }
+  mbedtls_ssl_session_free(&now);
+  mbedtls_ssl_session_free(&prev);
+  return 0;
+}
+
+static WiFiClient* _client[HAL_NET_SLOT_COUNT] = {};
+static bool        _useTls[HAL_NET_SLOT_COUNT];
+
+// Solo el loop cambia _client/_useTls; la tarea vigía los lee desde
+// hal_netWaitReadable. El mux cubre el par (puntero, tipo) y la lectura
+// del fd: el cliente se descuelga dentro y se borra fuera (nada de heap
+// con el mux tomado).
+static portMUX_TYPE _netMux = portMUX_INITIALIZER_UNLOCKED;
+
+static WiFiClient& netClient(HalNetSlot slot) {
+  if (!_client[slot]) {
+    WiFiClient* c = _useTls[slot] ? new HalTlsClient(slot) : new WiFiClient();
+    portENTER_CRITICAL(&_netMux);
+    _client[slot] = c;
+    portEXIT_CRITICAL(&_netMux);
+  }
+  return *_client[slot];
+}
+
+static int netFd(HalNetSlot slot, WiFiClient* c) {
+  if (_useTls[slot]) return static_cast<HalTlsClient*>(c)->socketFd();
+  return c->fd();
+}
+
+void hal_netSetup(HalNetSlot slot, const HalNetOpts& opts) {
+  WiFiClient* old = nullptr;
+  portENTER_CRITICAL(&_netMux);
+  if (_client[slot] && _useTls[slot] != opts.tls) {
+    // el slot cambia de transporte (p. ej. bootstrap http <-> https)
+    old = _client[slot];
+    _client[slot] = nullptr;
+  }
+  _useTls[slot] = opts.tls;
+  portEXIT_CRITICAL(&_netMux);
+
+  // la vigía ya no lo ve; si estaba en select() sobre su fd, el cierre la despierta
+  if (old) {
+    old->stop();
+    delete old;
+  }
+
+  WiFiClient& c = netClient(slot);
+  c.setTimeout(opts.timeoutMs);
+  if (opts.tls) {
+    WiFiClientSecure& tls = static_cast<WiFiClientSecure&>(c);
+    if (opts.tlsInsecure) tls.setInsecure();
+    tls.setHandshakeTimeout((opts.timeoutMs + 999) / 1000);
+  }
+}
+
+Client& hal_netClient(HalNetSlot slot) {
+  return netClient(slot);
+}
+
+bool hal_netConnect(HalNetSlot slot, const char* host, uint16_t port) {
+  WiFiClient& c = netClient(slot);
+  if (c.connected()) return true;
+  return c.connect(host, port);
+}
+
+void hal_netStop(HalNetSlot slot) {
+  if (_client[slot]) _client[slot]->stop();
+}
+
+bool hal_netResumed(HalNetSlot slot) {
+  return _useTls[slot] && _tlsResumed[slot];
+}
+
+// Corre en la tarea vigía: un slot sin transporte todavía no tiene socket
+int hal_netWaitReadable(HalNetSlot slot, uint32_t timeoutMs) {
+  portENTER_CRITICAL(&_netMux);
+  WiFiClient* c = _client[slot];
+  int fd = c ? netFd(slot, c) : -1;
+  portEXIT_CRITICAL(&_netMux);
+  if (fd < 0) return -1;
+
+  fd_set rd, ex;
+  FD_ZERO(&rd);
+  FD_ZERO(&ex);
+  FD_SET(fd, &rd);
+  FD_SET(fd, &ex);
+  struct timeval tv = { (time_t)(timeoutMs / 1000), (suseconds_t)((timeoutMs % 1000) * 1000) };
+
+  // error (p. ej. el loop cerró el socket) también despierta: que lo vea net_loop
+  return select(fd + 1, &rd, nullptr, &ex, &tv) != 0 ? 1 : 0;
+}
+
+// ======================
+// HTTP
+// ======================
+int hal_httpPost(const String& url,
+                 const HalHttpHeader* headers, size_t headerCount,
+                 const String& body, String& respOut, uint32_t timeoutMs) {
+  respOut = "";
+
+  HTTPClient http;
+  http.setTimeout(timeoutMs);
+  http.setReuse(false);
+
+  if (!http.begin(netClient(HAL_NET_HTTP), url)) return -1;
+
+  for (size_t i = 0; i < headerCount; i++) {
+    http.addHeader(headers[i].name, headers[i].value);
+  }
+
+  int code = http.POST(body);
+  if (code > 0) respOut = http.getString();
+  http.end();
+  return code;
+}
+
+#endif // ARDUINO_ARCH_ESP32
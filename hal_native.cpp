@@ -0,0 +1,613 @@
+// hal_native.cpp
+// Implementación de hal.h para el build nativo (Linux, -DNEBADON_NATIVE):
+// GPIO, NVS, WiFi y reloj falsos que los tests manejan con native/sim.h,
+// y sockets sobre loopback (native/loopback.h) contra los fakes de
+// broker MQTT y servidor HTTP.
+
+#if defined(NEBADON_NATIVE)
+
+#include "hal.h"
+#include "sim.h"
+#include "loopback.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// ======================
+// GPIO
+// ======================
+#define SIM_GPIO_COUNT 64
+
+static int8_t _gpio[SIM_GPIO_COUNT];
+static bool _gpioInit = false;
+static uint32_t _gpioWrites = 0;
+
+static void gpioInit() {
+  if (_gpioInit) return;
+  _gpioInit = true;
+  memset(_gpio, -1, sizeof(_gpio));
+}
+
+void hal_gpioOutput(uint8_t pin) {
+  (void)pin;
+  gpioInit();
+}
+
+void hal_gpioWrite(uint8_t pin, int level) {
+  gpioInit();
+  if (pin >= SIM_GPIO_COUNT) return;
+  _gpio[pin] = level ? 1 : 0;
+  _gpioWrites++;
+}
+
+int sim_gpioLevel(uint8_t pin) {
+  gpioInit();
+  return pin < SIM_GPIO_COUNT ? _gpio[pin] : -1;
+}
+
+uint32_t sim_gpioWrites() {
+  return _gpioWrites;
+}
+
+// ======================
+// Sistema
+// ======================
+#define SIM_HEAP_SIZE (320u * 1024u)   // lo que deja libre un C6 tras el arranque
+
+size_t native_heapLive();
+size_t native_heapPeak();
+
+static uint32_t _rng = 0x2545F491u;
+static bool _restart = false;
+
+uint32_t hal_freeHeap() {
+  size_t live = native_heapLive();
+  return live >= SIM_HEAP_SIZE ? 0 : (uint32_t)(SIM_HEAP_SIZE - live);
+}
+
+uint32_t hal_minFreeHeap() {
+  size_t peak = native_heapPeak();
+  return peak >= SIM_HEAP_SIZE ? 0 : (uint32_t)(SIM_HEAP_SIZE - peak);
+}
+
+void hal_restart() {
+  _restart = true;
+}
+
+bool sim_restartRequested() {
+  return _restart;
+}
+
+void hal_readMac(uint8_t mac[6]) {
+  static const uint8_t MAC[6] = { 0x40, 0x4C, 0xCA, 0x12, 0x34, 0x56 };
+  memcpy(mac, MAC, 6);
+}
+
+uint64_t hal_efuseMac() {
+  uint8_t m[6];
+  hal_readMac(m);
+  uint64_t v = 0;
+  for (int i = 5; i >= 0; i--) v = (v << 8) | m[i];
+  return v;
+}
+
+const char* hal_chipModel() {
+  return "NATIVE";
+}
+
+// Ciclos = ns reales (una CPU de 1000 MHz): los benchmarks comparan casos
+uint32_t hal_cycleCount() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t hal_cpuMhz() {
+  return 1000;
+}
+
+// xorshift32: reproducible con sim_seed()
+uint32_t hal_random() {
+  uint32_t x = _rng;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  _rng = x;
+  return x;
+}
+
+void sim_seed(uint32_t seed) {
+  _rng = seed ? seed : 1;
+}
+
+// ======================
+// Watchdog
+// ======================
+static uint32_t _wdtTimeoutMs = 0;
+static unsigned long _wdtLastFeedMs = 0;
+static uint32_t _wdtFeeds = 0;
+
+void hal_wdtBegin(uint32_t timeoutMs) {
+  _wdtTimeoutMs = timeoutMs;
+  _wdtLastFeedMs = millis();
+}
+
+void hal_wdtFeed() {
+  _wdtLastFeedMs = millis();
+  _wdtFeeds++;
+}
+
+bool hal_resetWasWatchdog() {
+  return false;
+}
+
+bool hal_resetWasPowerOn() {
+  return true;
+}
+
+bool sim_wdtExpired() {
+  return _wdtTimeoutMs && millis() - _wdtLastFeedMs > _wdtTimeoutMs;
+}
+
+uint32_t sim_wdtFeeds() {
+  return _wdtFeeds;
+}
+
+// ======================
+// NVS: un mapa por namespace, valores tipados como Preferences
+// ======================
+struct SimKv {
+  bool isStr;
+  std::string s;
+  uint32_t u;
+};
+
+static std::map<std::string, std::map<std::string, SimKv>> _nvs;
+static std::string _nvsNs;
+static bool _nvsReadOnly = true;
+static uint32_t _nvsWrites = 0;
+
+bool hal_kvOpen(const char* ns, bool readOnly) {
+  _nvsNs = ns;
+  _nvsReadOnly = readOnly;
+  return true;
+}
+
+void hal_kvClose() {
+  _nvsNs.clear();
+}
+
+String hal_kvGetString(const char* key) {
+  auto& m = _nvs[_nvsNs];
+  auto it = m.find(key);
+  return it != m.end() && it->second.isStr ? String(it->second.s) : String();
+}
+
+bool hal_kvPutString(const char* key, const String& value) {
+  if (_nvsNs.empty() || _nvsReadOnly) return false;
+  _nvs[_nvsNs][key] = SimKv{ true, value.c_str(), 0 };
+  _nvsWrites++;
+  return true;
+}
+
+uint32_t hal_kvGetU32(const char* key, uint32_t def) {
+  auto& m = _nvs[_nvsNs];
+  auto it = m.find(key);
+  return it != m.end() && !it->second.isStr ? it->second.u : def;
+}
+
+bool hal_kvPutU32(const char* key, uint32_t value) {
+  if (_nvsNs.empty() || _nvsReadOnly) return false;
+  _nvs[_nvsNs][key] = SimKv{ false, "", value };
+  _nvsWrites++;
+  return true;
+}
+
+bool hal_kvRemove(const char* key) {
+  if (_nvsNs.empty() || _nvsReadOnly) return false;
+  return _nvs[_nvsNs].erase(key) > 0;
+}
+
+void sim_kvPutString(const char* ns, const char* key, const char* value) {
+  _nvs[ns ? ns : "nebadon"][key] = SimKv{ true, value, 0 };
+}
+
+uint32_t sim_kvWrites() {
+  return _nvsWrites;
+}
+
+// ======================
+// WiFi falso
+// El estado se evalúa al consultarlo (wifiTick): los intentos resuelven
+// al vencer su plazo y los eventos se disparan en ese momento, en el
+// hilo que pregunte (o en native_simTick durante las esperas del loop).
+// ======================
+#define SIM_SCAN_MS 2000
+#define SIM_NTP_MS  300
+
+struct SimAp {
+  std::string ssid;
+  std::string pass;
+  int8_t rssi;
+  uint8_t channel;
+  uint8_t bssid[6];
+  bool up;
+};
+
+static std::vector<SimAp> _aps;
+static uint32_t _connectMs = 3000;
+static uint32_t _directMs = 800;
+static uint32_t _staleMs = 0;
+static uint32_t _begins = 0;
+
+static HalWifiStatus _wifiSt = HAL_WIFI_IDLE;
+static int _linkAp = -1;                 // AP del enlace actual (con CONNECTED)
+
+static bool _attempt = false;            // intento en curso
+static unsigned long _attemptDoneMs = 0;
+static std::string _attemptSsid, _attemptPass;
+static bool _attemptDirect = false;
+static uint8_t _attemptBssid[6];
+
+static int _staleAp = -1;                // enlace viejo que aún se reporta
+static unsigned long _staleUntilMs = 0;
+
+static bool _scanRunning = false;
+static unsigned long _scanDoneMs = 0;
+
+static HalWifiEventFn _wifiEventFn = nullptr;
+static HalTimeSyncFn _onTimeSync = nullptr;
+static unsigned long _ntpDueMs = 0;
+static bool _ntpPending = false;
+
+static int apFind(const std::string& ssid) {
+  for (size_t i = 0; i < _aps.size(); i++) {
+    if (_aps[i].ssid == ssid) return (int)i;
+  }
+  return -1;
+}
+
+static void wifiEvent(HalWifiEvent ev) {
+  if (_wifiEventFn) _wifiEventFn(ev);
+}
+
+static void wifiLinkUp(int ap, unsigned long now) {
+  _wifiSt = HAL_WIFI_CONNECTED;
+  _linkAp = ap;
+  if (_ntpPending && !_ntpDueMs) _ntpDueMs = now + SIM_NTP_MS;
+}
+
+static void wifiTick() {
+  unsigned long now = millis();
+
+  if (_staleAp >= 0 && (long)(now - _staleUntilMs) >= 0) {
+    _staleAp = -1;
+    wifiEvent(HAL_WIFI_EV_DISCONNECTED);   // llega por fin la baja del enlace viejo
+  }
+
+  if (_attempt && (long)(now - _attemptDoneMs) >= 0) {
+    _attempt = false;
+    int ap = apFind(_attemptSsid);
+    if (ap < 0 || !_aps[ap].up) {
+      _wifiSt = HAL_WIFI_NO_SSID;
+    } else if (_attemptDirect && memcmp(_attemptBssid, _aps[ap].bssid, 6) != 0) {
+      _wifiSt = HAL_WIFI_NO_SSID;   // asociación dirigida a otro AP
+    } else if (_aps[ap].pass != _attemptPass) {
+      _wifiSt = HAL_WIFI_CONNECT_FAILED;
+    } else {
+      wifiLinkUp(ap, now);
+    }
+    wifiEvent(_wifiSt == HAL_WIFI_CONNECTED ? HAL_WIFI_EV_GOT_IP : HAL_WIFI_EV_DISCONNECTED);
+  }
+
+  if (_wifiSt == HAL_WIFI_CONNECTED && !_aps[_linkAp].up) {
+    _wifiSt = HAL_WIFI_DISCONNECTED;
+    _linkAp = -1;
+    wifiEvent(HAL_WIFI_EV_DISCONNECTED);
+  }
+
+  if (_scanRunning && (long)(now - _scanDoneMs) >= 0) {
+    _scanRunning = false;
+    _scanDoneMs = 0;
+    wifiEvent(HAL_WIFI_EV_SCAN_DONE);
+  }
+
+  if (_ntpPending && _ntpDueMs && _wifiSt == HAL_WIFI_CONNECTED && (long)(now - _ntpDueMs) >= 0) {
+    _ntpPending = false;
+    if (_onTimeSync) _onTimeSync();
+  }
+}
+
+void native_simTick() {
+  wifiTick();
+}
+
+void hal_wifiInit() {
+  _wifiSt = HAL_WIFI_IDLE;
+}
+
+static void wifiStartAttempt(const char* ssid, const char* pass, bool direct, const uint8_t* bssid) {
+  unsigned long now = millis();
+  _begins++;
+
+  // el driver aún no dio de baja el enlace anterior
+  if (_wifiSt == HAL_WIFI_CONNECTED && _staleMs > 0) {
+    _staleAp = _linkAp;
+    _staleUntilMs = now + _staleMs;
+  }
+
+  _wifiSt = HAL_WIFI_DISCONNECTED;
+  _linkAp = -1;
+  _attempt = true;
+  _attemptSsid = ssid;
+  _attemptPass = pass ? pass : "";
+  _attemptDirect = direct;
+  if (direct) memcpy(_attemptBssid, bssid, 6);
+  _attemptDoneMs = now + (direct ? _directMs : _connectMs);
+}
+
+void hal_wifiBegin(const char* ssid, const char* pass) {
+  wifiStartAttempt(ssid, pass, false, nullptr);
+}
+
+void hal_wifiBeginDirect(const char* ssid, const char* pass, const HalWifiLink& link) {
+  wifiStartAttempt(ssid, pass, true, link.bssid);
+}
+
+static int reportedAp() {
+  wifiTick();
+  if (_staleAp >= 0) return _staleAp;
+  return _wifiSt == HAL_WIFI_CONNECTED ? _linkAp : -1;
+}
+
+bool hal_wifiGetLink(HalWifiLink& out) {
+  int ap = reportedAp();
+  if (ap < 0) return false;
+
+  const SimAp& a = _aps[ap];
+  memcpy(out.bssid, a.bssid, 6);
+  out.channel = a.channel;
+  // 192.168.<ap>.50/24, IPAddress guarda el primer octeto en el byte bajo
+  out.gateway = 192u | (168u << 8) | ((uint32_t)ap << 16) | (1u << 24);
+  out.ip      = 192u | (168u << 8) | ((uint32_t)ap << 16) | (50u << 24);
+  out.mask    = 0x00FFFFFFu;
+  out.dns     = out.gateway;
+  return true;
+}
+
+HalWifiStatus hal_wifiStatus() {
+  if (reportedAp() >= 0) return HAL_WIFI_CONNECTED;
+  return _wifiSt == HAL_WIFI_CONNECTED ? HAL_WIFI_DISCONNECTED : _wifiSt;
+}
+
+void hal_wifiOnEvent(HalWifiEventFn fn) {
+  _wifiEventFn = fn;
+}
+
+String hal_wifiLocalIP() {
+  int ap = reportedAp();
+  if (ap < 0) return String("0.0.0.0");
+  char buf[24];
+  snprintf(buf, sizeof(buf), "192.168.%d.50", ap);
+  return String(buf);
+}
+
+int hal_wifiRSSI() {
+  int ap = reportedAp();
+  return ap >= 0 ? _aps[ap].rssi : 0;
+}
+
+bool hal_wifiScanStart() {
+  wifiTick();
+  _scanRunning = true;
+  _scanDoneMs = millis() + SIM_SCAN_MS;
+  return true;
+}
+
+int hal_wifiScanPoll(HalWifiScanEntry* out, size_t max) {
+  wifiTick();
+  if (_scanRunning) return -1;
+
+  size_t k = 0;
+  for (const SimAp& a : _aps) {
+    if (!a.up || k >= max) continue;
+    HalWifiScanEntry& e = out[k++];
+    snprintf(e.ssid, sizeof(e.ssid), "%s", a.ssid.c_str());
+    e.rssi = a.rssi;
+    e.channel = a.channel;
+    memcpy(e.bssid, a.bssid, 6);
+    e.open = a.pass.empty();
+  }
+  return (int)k;
+}
+
+void sim_wifiAddAp(const char* ssid, const char* pass, int8_t rssi, uint8_t channel) {
+  SimAp a;
+  a.ssid = ssid;
+  a.pass = pass ? pass : "";
+  a.rssi = rssi;
+  a.channel = channel;
+  uint8_t b[6] = { 0x02, 0xAA, 0x00, 0x00, 0x00, (uint8_t)_aps.size() };
+  memcpy(a.bssid, b, 6);
+  a.up = true;
+  _aps.push_back(a);
+}
+
+void sim_wifiSetApUp(const char* ssid, bool up) {
+  int ap = apFind(ssid);
+  if (ap >= 0) _aps[ap].up = up;
+  wifiTick();
+}
+
+void sim_wifiSetConnectMs(uint32_t connectMs, uint32_t directMs) {
+  _connectMs = connectMs;
+  _directMs = directMs;
+}
+
+void sim_wifiDropLink() {
+  wifiTick();
+  if (_wifiSt != HAL_WIFI_CONNECTED) return;
+  _wifiSt = HAL_WIFI_DISCONNECTED;
+  _linkAp = -1;
+  wifiEvent(HAL_WIFI_EV_DISCONNECTED);
+}
+
+const char* sim_wifiLinkSsid() {
+  int ap = reportedAp();
+  return ap >= 0 ? _aps[ap].ssid.c_str() : "";
+}
+
+uint32_t sim_wifiBegins() {
+  return _begins;
+}
+
+void sim_wifiSetStaleMs(uint32_t ms) {
+  _staleMs = ms;
+}
+
+// ======================
+// Hora
+// ======================
+void hal_timeSyncStart(HalTimeSyncFn onSync) {
+  _onTimeSync = onSync;
+  _ntpPending = true;
+  _ntpDueMs = _wifiSt == HAL_WIFI_CONNECTED ? millis() + SIM_NTP_MS : 0;
+}
+
+// ======================
+// Sockets: loopback, sin cifrado (los TLS solo se cuentan)
+// ======================
+static LoopbackClient _client[HAL_NET_SLOT_COUNT];
+static bool _useTls[HAL_NET_SLOT_COUNT];
+static uint32_t _tlsHandshakes = 0;
+static uint32_t _tlsResumes = 0;
+
+// Sesión por slot, como el caché RTC de hal_esp32: se reanuda contra el
+// mismo host:puerto mientras el servidor la acepte (sim_tlsDropSessions)
+struct SimTlsSession {
+  std::string hostPort;
+  uint32_t epoch;
+};
+static SimTlsSession _tlsSession[HAL_NET_SLOT_COUNT];
+static bool _tlsResumed[HAL_NET_SLOT_COUNT];
+static uint32_t _tlsEpoch = 1;
+
+void hal_netSetup(HalNetSlot slot, const HalNetOpts& opts) {
+  if (_useTls[slot] != opts.tls) _client[slot].stop();
+  _useTls[slot] = opts.tls;
+}
+
+Client& hal_netClient(HalNetSlot slot) {
+  return _client[slot];
+}
+
+bool hal_netConnect(HalNetSlot slot, const char* host, uint16_t port) {
+  if (_client[slot].connected()) return true;
+  if (hal_wifiStatus() != HAL_WIFI_CONNECTED) return false;
+  if (!_client[slot].connect(host, port)) return false;
+  if (!_useTls[slot]) return true;
+
+  std::string key = std::string(host) + ":" + std::to_string(port);
+  SimTlsSession& sess = _tlsSession[slot];
+  _tlsResumed[slot] = sess.hostPort == key && sess.epoch == _tlsEpoch;
+  if (_tlsResumed[slot]) _tlsResumes++;
+  else _tlsHandshakes++;
+  sess.hostPort = key;
+  sess.epoch = _tlsEpoch;
+  return true;
+}
+
+void hal_netStop(HalNetSlot slot) {
+  _client[slot].stop();
+}
+
+bool hal_netResumed(HalNetSlot slot) {
+  return _useTls[slot] && _tlsResumed[slot];
+}
+
+// El loopback no tiene descriptor: net_loop sondea (MQTT_POLL_FALLBACK_MS)
+int hal_netWaitReadable(HalNetSlot slot, uint32_t timeoutMs) {
+  (void)slot; (void)timeoutMs;
+  return -1;
+}
+
+uint32_t sim_tlsHandshakes() {
+  return _tlsHandshakes;
+}
+
+uint32_t sim_tlsResumed() {
+  return _tlsResumes;
+}
+
+void sim_tlsDropSessions() {
+  _tlsEpoch++;
+}
+
+// ======================
+// HTTP: HTTP/1.1 a mano sobre el slot HAL_NET_HTTP
+// ======================
+#define HTTP_ERROR_CONNECTION_REFUSED -1
+#define HTTP_ERROR_READ_TIMEOUT       -11
+
+int hal_httpPost(const String& url,
+                 const HalHttpHeader* headers, size_t headerCount,
+                 const String& body, String& respOut, uint32_t timeoutMs) {
+  respOut = "";
+
+  // "http[s]://host[:port]/path"
+  std::string u = url.c_str();
+  bool tls = u.compare(0, 8, "https://") == 0;
+  size_t start = tls ? 8 : (u.compare(0, 7, "http://") == 0 ? 7 : std::string::npos);
+  if (start == std::string::npos) return HTTP_ERROR_CONNECTION_REFUSED;
+
+  size_t slash = u.find('/', start);
+  std::string hostPort = u.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+  std::string path = slash == std::string::npos ? "/" : u.substr(slash);
+  size_t colon = hostPort.find(':');
+  std::string host = hostPort.substr(0, colon);
+  uint16_t port = colon == std::string::npos ? (tls ? 443 : 80)
+                                             : (uint16_t)atoi(hostPort.c_str() + colon + 1);
+
+  if (!hal_netConnect(HAL_NET_HTTP, host.c_str(), port)) return HTTP_ERROR_CONNECTION_REFUSED;
+  Client& c = _client[HAL_NET_HTTP];
+
+  std::string req = "POST " + path + " HTTP/1.1\r\nHost: " + host + "\r\n";
+  for (size_t i = 0; i < headerCount; i++) {
+    req += std::string(headers[i].name) + ": " + headers[i].value + "\r\n";
+  }
+  req += "Content-Length: " + std::to_string(body.length()) + "\r\nConnection: close\r\n\r\n";
+  req += body.c_str();
+  c.write((const uint8_t*)req.data(), req.size());
+
+  // loopback: la respuesta llega entera, quizá con la latencia del
+  // servidor; se espera en tiempo simulado como esperaría el socket
+  unsigned long t0 = millis();
+  while (c.connected() && c.available() == 0) {
+    if (millis() - t0 >= timeoutMs) {
+      c.stop();
+      return HTTP_ERROR_READ_TIMEOUT;
+    }
+    vTaskDelay(pdMS_TO_TICKS(1));
+  }
+
+  std::string resp;
+  uint8_t buf[256];
+  int n;
+  while ((n = c.read(buf, sizeof(buf))) > 0) resp.append((const char*)buf, (size_t)n);
+  c.stop();
+
+  size_t sp = resp.find(' ');
+  size_t hdrEnd = resp.find("\r\n\r\n");
+  if (resp.compare(0, 5, "HTTP/") != 0 || sp == std::string::npos || hdrEnd == std::string::npos) {
+    return HTTP_ERROR_READ_TIMEOUT;
+  }
+
+  int code = atoi(resp.c_str() + sp + 1);
+  respOut = String(resp.substr(hdrEnd + 4));
+  return code;
+}
+
+#endif // NEBADON_NATIVE
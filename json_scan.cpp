@@ -0,0 +1,261 @@
+#include "json_scan.h"
+#include <math.h>
+
+static const char* skipWs(const char* p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+  return p;
+}
+
+// p apunta a la comilla de apertura; devuelve el puntero tras la de cierre
+static const char* scanString(const char* p, const char* end, JsonSpan& out) {
+  const char* start = ++p;
+  while (p < end) {
+    if (*p == '\\') {
+      p += 2;
+      continue;
+    }
+    if (*p == '"') {
+      out.p = start;
+      out.len = (uint16_t)(p - start);
+      return p + 1;
+    }
+    p++;
+  }
+  return nullptr;
+}
+
+// Salta un objeto/array anidado completo
+static const char* skipNested(const char* p, const char* end) {
+  int depth = 0;
+  while (p < end) {
+    char c = *p;
+    if (c == '"') {
+      JsonSpan tmp;
+      p = scanString(p, end, tmp);
+      if (!p) return nullptr;
+      continue;
+    }
+    if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (--depth == 0) return p + 1;
+    }
+    p++;
+  }
+  return nullptr;
+}
+
+static const char* scanScalar(const char* p, const char* end, JsonField& f) {
+  const char* start = p;
+  while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+         *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+    p++;
+  }
+  f.val.p = start;
+  f.val.len = (uint16_t)(p - start);
+
+  if (jscan_eq(f.val, "true"))       f.type = JSCAN_TRUE;
+  else if (jscan_eq(f.val, "false")) f.type = JSCAN_FALSE;
+  else if (jscan_eq(f.val, "null"))  f.type = JSCAN_NULL;
+  else if (f.val.len > 0 && (*start == '-' || (*start >= '0' && *start <= '9'))) f.type = JSCAN_NUMBER;
+  else return nullptr;
+
+  return p;
+}
+
+// p apunta al inicio del valor; rellena f.val/f.type
+static const char* scanValue(const char* p, const char* end, JsonField& f) {
+  if (*p == '"') {
+    f.type = JSCAN_STRING;
+    return scanString(p, end, f.val);
+  }
+  if (*p == '{' || *p == '[') {
+    const char* start = p;
+    p = skipNested(p, end);
+    if (p) {
+      f.val.p = start;
+      f.val.len = (uint16_t)(p - start);
+    }
+    f.type = JSCAN_OTHER;
+    return p;
+  }
+  return scanScalar(p, end, f);
+}
+
+bool jscan_object(const char* buf, size_t len, JsonFieldFn fn, void* ctx) {
+  if (!buf) return false;
+  const char* p = buf;
+  const char* end = buf + len;
+
+  p = skipWs(p, end);
+  if (p >= end || *p != '{') return false;
+  p = skipWs(p + 1, end);
+  if (p < end && *p == '}') return true;
+
+  while (p < end) {
+    JsonField f;
+    f.type = JSCAN_NONE;
+
+    if (*p != '"') return false;
+    p = scanString(p, end, f.key);
+    if (!p) return false;
+
+    p = skipWs(p, end);
+    if (p >= end || *p != ':') return false;
+    p = skipWs(p + 1, end);
+    if (p >= end) return false;
+
+    p = scanValue(p, end, f);
+    if (!p) return false;
+
+    if (fn && !fn(f, ctx)) return true;
+
+    p = skipWs(p, end);
+    if (p >= end) return false;
+    if (*p == '}') return true;
+    if (*p != ',') return false;
+    p = skipWs(p + 1, end);
+  }
+  return false;
+}
+
+bool jscan_array(const JsonSpan& arr, JsonFieldFn fn, void* ctx) {
+  if (!arr.p) return false;
+  const char* p = arr.p;
+  const char* end = arr.p + arr.len;
+
+  p = skipWs(p, end);
+  if (p >= end || *p != '[') return false;
+  p = skipWs(p + 1, end);
+  if (p < end && *p == ']') return true;
+
+  while (p < end) {
+    JsonField f;
+    f.key.p = p;
+    f.key.len = 0;
+    f.type = JSCAN_NONE;
+
+    p = scanValue(p, end, f);
+    if (!p) return false;
+
+    if (fn && !fn(f, ctx)) return true;
+
+    p = skipWs(p, end);
+    if (p >= end) return false;
+    if (*p == ']') return true;
+    if (*p != ',') return false;
+    p = skipWs(p + 1, end);
+  }
+  return false;
+}
+
+bool jscan_eq(const JsonSpan& s, const char* lit) {
+  size_t n = strlen(lit);
+  return s.len == n && memcmp(s.p, lit, n) == 0;
+}
+
+bool jscan_eqIgnoreCase(const JsonSpan& s, const char* lit) {
+  size_t n = strlen(lit);
+  return s.len == n && strncasecmp(s.p, lit, n) == 0;
+}
+
+bool jscan_eqSpan(const JsonSpan& a, const JsonSpan& b) {
+  return a.len == b.len && memcmp(a.p, b.p, a.len) == 0;
+}
+
+bool jscan_copy(const JsonSpan& s, char* out, size_t outSize) {
+  if (!out || outSize == 0 || s.len >= outSize) return false;
+  memcpy(out, s.p, s.len);
+  out[s.len] = '\0';
+  return true;
+}
+
+bool jscan_unescape(const JsonSpan& s, char* out, size_t outSize) {
+  if (!out || outSize == 0) return false;
+
+  size_t o = 0;
+  for (uint16_t i = 0; i < s.len; i++) {
+    char c = s.p[i];
+    if (c == '\\' && i + 1 < s.len) {
+      char e = s.p[++i];
+      switch (e) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'u': {
+          // solo ASCII; el resto se sustituye por '?'
+          unsigned cp = 0;
+          if (i + 4 >= s.len) return false;
+          for (int k = 0; k < 4; k++) {
+            char h = s.p[++i];
+            cp <<= 4;
+            if (h >= '0' && h <= '9')      cp |= (unsigned)(h - '0');
+            else if (h >= 'a' && h <= 'f') cp |= (unsigned)(h - 'a' + 10);
+            else if (h >= 'A' && h <= 'F') cp |= (unsigned)(h - 'A' + 10);
+            else return false;
+          }
+          c = cp < 0x80 ? (char)cp : '?';
+          break;
+        }
+        default: c = e; break;   // \" \\ \/
+      }
+    }
+    if (o + 1 >= outSize) return false;
+    out[o++] = c;
+  }
+  out[o] = '\0';
+  return true;
+}
+
+struct FindCtx {
+  const char* key;
+  JsonField* out;
+  bool found;
+};
+
+static bool onFindField(const JsonField& f, void* ctx) {
+  FindCtx& c = *(FindCtx*)ctx;
+  if (!jscan_eq(f.key, c.key)) return true;
+  *c.out = f;
+  c.found = true;
+  return false;
+}
+
+bool jscan_find(const char* buf, size_t len, const char* key, JsonField& out) {
+  FindCtx c = { key, &out, false };
+  return jscan_object(buf, len, onFindField, &c) && c.found;
+}
+
+bool jscan_toInt(const JsonField& f, int& out) {
+  char num[24];
+
+  switch (f.type) {
+    case JSCAN_TRUE:  out = 1; return true;
+    case JSCAN_FALSE: out = 0; return true;
+
+    case JSCAN_NUMBER:
+      if (!jscan_copy(f.val, num, sizeof(num))) return false;
+      if (strpbrk(num, ".eE")) out = (int)lroundf(strtof(num, nullptr));
+      else out = (int)strtol(num, nullptr, 10);
+      return true;
+
+    case JSCAN_STRING:
+      // como String::toInt(): entero inicial o 0
+      if (!jscan_copy(f.val, num, sizeof(num))) num[0] = '\0';
+      out = (int)strtol(num, nullptr, 10);
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+bool jscan_toIntStrict(const JsonField& f, int& out) {
+  char num[24];
+  if (f.type != JSCAN_NUMBER || !jscan_copy(f.val, num, sizeof(num))) return false;
+  if (strpbrk(num, ".eE")) return false;
+  out = (int)strtol(num, nullptr, 10);
+  return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+
+// Escáner JSON mínimo para objetos planos, sin heap.
+// Trabaja directamente sobre el buffer recibido (no necesita '\0' final)
+// y entrega cada par clave/valor como spans que apuntan a ese buffer.
+// Los strings se entregan crudos (sin des-escapar), suficiente para
+// comparar UUIDs, vpins, SSIDs simples y nombres de comando.
+
+struct JsonSpan {
+  const char* p;
+  uint16_t len;
+};
+
+enum JsonScanType : uint8_t {
+  JSCAN_NONE = 0,
+  JSCAN_STRING,
+  JSCAN_NUMBER,
+  JSCAN_TRUE,
+  JSCAN_FALSE,
+  JSCAN_NULL,
+  JSCAN_OTHER,    // objeto o array anidado (se salta)
+};
+
+struct JsonField {
+  JsonSpan key;
+  JsonSpan val;
+  JsonScanType type;
+};
+
+// Devuelve false para cortar el recorrido
+typedef bool (*JsonFieldFn)(const JsonField& f, void* ctx);
+
+// false si el buffer no es un objeto JSON bien formado
+bool jscan_object(const char* buf, size_t len, JsonFieldFn fn, void* ctx);
+
+// Recorre los elementos de un array (p. ej. el val JSCAN_OTHER de un
+// campo); cada elemento llega como JsonField con key vacía. Para objetos
+// anidados, pasar f.val.p/f.val.len a jscan_object.
+bool jscan_array(const JsonSpan& arr, JsonFieldFn fn, void* ctx);
+
+bool jscan_eq(const JsonSpan& s, const char* lit);
+bool jscan_eqIgnoreCase(const JsonSpan& s, const char* lit);
+bool jscan_eqSpan(const JsonSpan& a, const JsonSpan& b);
+
+// bool / número (redondeado) / string numérico -> int, como ArduinoJson + toInt()
+bool jscan_toInt(const JsonField& f, int& out);
+// Solo un entero JSON, como doc[k] | -1 de ArduinoJson: "1", true o 1.0 no
+bool jscan_toIntStrict(const JsonField& f, int& out);
+
+// Copia el span a un buffer con '\0'; false si no cabe
+bool jscan_copy(const JsonSpan& s, char* out, size_t outSize);
+
+// Igual que jscan_copy pero resolviendo escapes (\" \\ \n \uXXXX...)
+bool jscan_unescape(const JsonSpan& s, char* out, size_t outSize);
+
+// Busca una clave de primer nivel; false si no está o el JSON es inválido
+bool jscan_find(const char* buf, size_t len, const char* key, JsonField& out);
@@ -0,0 +1,100 @@
+// latency.cpp
+// Histogramas de latencia por etapa (ver latency.h)
+
+#include "latency.h"
+
+// Cota superior de cada bucket en µs; el último es "más que eso"
+static const uint32_t BUCKET_US[LAT_BUCKETS - 1] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000,
+  50000, 100000, 250000, 500000, LAT_OPEN_US,
+};
+
+static const char* STAGE_NAMES[LAT_STAGE_COUNT] = {
+  "dispatch", "gpio", "publish", "notify",
+};
+
+static uint32_t _hist[LAT_STAGE_COUNT][LAT_BUCKETS];
+static uint32_t _ingressUs = 0;
+static bool _active = false;
+
+void lat_begin(uint32_t ingressUs) {
+  _ingressUs = ingressUs;
+  _active = true;
+}
+
+void lat_mark(LatStage stage) {
+  if (!_active || stage >= LAT_STAGE_COUNT) return;
+
+  uint32_t dt = (uint32_t)micros() - _ingressUs;
+  uint8_t b = 0;
+  while (b < LAT_BUCKETS - 1 && dt > BUCKET_US[b]) b++;
+  _hist[stage][b]++;
+}
+
+void lat_end() {
+  _active = false;
+}
+
+void lat_reset() {
+  memset(_hist, 0, sizeof(_hist));
+  _active = false;
+}
+
+uint32_t lat_count(LatStage stage) {
+  uint32_t n = 0;
+  for (uint8_t b = 0; b < LAT_BUCKETS; b++) n += _hist[stage][b];
+  return n;
+}
+
+uint32_t lat_percentileUs(LatStage stage, uint8_t pct, bool* over) {
+  if (over) *over = false;
+  uint32_t n = lat_count(stage);
+  if (n == 0) return 0;
+
+  // rango (1..n) de la muestra del percentil
+  uint32_t rank = (uint32_t)(((uint64_t)n * pct + 99) / 100);
+  if (rank == 0) rank = 1;
+
+  uint32_t acc = 0;
+  for (uint8_t b = 0; b < LAT_BUCKETS - 1; b++) {
+    acc += _hist[stage][b];
+    if (acc >= rank) return BUCKET_US[b];
+  }
+  if (over) *over = true;   // cae en el bucket abierto
+  return LAT_OPEN_US;
+}
+
+size_t lat_renderJson(char* out, size_t cap) {
+  size_t len = 0;
+
+#define LAT_PUT(...) do {                                          \
+    int w = snprintf(out + len, cap - len, __VA_ARGS__);           \
+    if (w < 0 || (size_t)w >= cap - len) return 0;                 \
+    len += (size_t)w;                                              \
+  } while (0)
+
+  LAT_PUT("{\"b\":[");
+  for (uint8_t b = 0; b < LAT_BUCKETS - 1; b++) {
+    LAT_PUT("%s%lu", b ? "," : "", (unsigned long)BUCKET_US[b]);
+  }
+  LAT_PUT("]");
+
+  for (uint8_t s = 0; s < LAT_STAGE_COUNT; s++) {
+    LatStage st = (LatStage)s;
+    bool over50, over99;
+    uint32_t p50 = lat_percentileUs(st, 50, &over50);
+    uint32_t p99 = lat_percentileUs(st, 99, &over99);
+    LAT_PUT(",\"%s\":{\"n\":%lu,\"p50%s\":%lu,\"p99%s\":%lu,\"h\":[",
+            STAGE_NAMES[s], (unsigned long)lat_count(st),
+            over50 ? "_gt" : "", (unsigned long)p50,
+            over99 ? "_gt" : "", (unsigned long)p99);
+    for (uint8_t b = 0; b < LAT_BUCKETS; b++) {
+      LAT_PUT("%s%lu", b ? "," : "", (unsigned long)_hist[s][b]);
+    }
+    LAT_PUT("]}");
+  }
+  LAT_PUT("}");
+
+#undef LAT_PUT
+  return len;
+}
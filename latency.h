@@ -0,0 +1,38 @@
+#pragma once
+#include <Arduino.h>
+
+// Latencia de comandos por etapa, medida desde la llegada (ingress):
+// callback BLE de NimBLE o callback de PubSubClient.
+// Histogramas de buckets fijos en RAM; solo se tocan desde loop().
+//
+// Uso: lat_begin(tsIngress) al despachar, lat_mark(etapa) en cada punto,
+// lat_end() al terminar. Fuera de un begin/end lat_mark() no hace nada.
+
+enum LatStage : uint8_t {
+  LAT_DISPATCH = 0,   // ingress -> handler del comando
+  LAT_GPIO,           // ingress -> GPIO escrito
+  LAT_PUBLISH,        // ingress -> estado publicado por MQTT
+  LAT_NOTIFY,         // ingress -> notify BLE del estado
+  LAT_STAGE_COUNT
+};
+
+#define LAT_BUCKETS 14
+#define LAT_OPEN_US 1000000UL   // cota del último bucket cerrado; más que eso es el abierto
+
+void lat_begin(uint32_t ingressUs);
+void lat_mark(LatStage stage);
+void lat_end();
+
+// Percentil (0..100) en µs: cota superior del bucket; 0 si no hay muestras.
+// En el bucket abierto no hay cota: devuelve LAT_OPEN_US (la inferior) y
+// marca *over, "más de LAT_OPEN_US".
+uint32_t lat_percentileUs(LatStage stage, uint8_t pct, bool* over = nullptr);
+uint32_t lat_count(LatStage stage);
+
+// Vacía los histogramas (tras el bench)
+void lat_reset();
+
+// Escribe {"dispatch":{"n":..,"p50":..,"p99":..,"h":[...]},...} (µs)
+// con los límites de bucket en "b"; un percentil en el bucket abierto sale
+// como "p99_gt":LAT_OPEN_US. Devuelve el largo, 0 si no cabe.
+size_t lat_renderJson(char* out, size_t cap);
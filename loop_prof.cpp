@@ -0,0 +1,171 @@
+// loop_prof.cpp
+// Perfilador del loop principal (ver loop_prof.h)
+
+#include "loop_prof.h"
+#include "neb_log.h"
+#include "hal.h"
+#include "loop_wake.h"
+
+static const char* SECTION_NAMES[PROF_SECTION_COUNT] = {
+  "ble", "wifi", "boot", "mqtt_conn", "mqtt_loop",
+};
+
+#define PROF_RTC_MAGIC 0x50524F46u   // "PROF"
+
+// Sin inicializar en ningún reset: se valida con magic
+struct ProfRtc {
+  uint32_t magic;
+  uint8_t cur;               // sección en curso (PROF_NONE fuera)
+  uint8_t lastStallSection;
+  uint8_t wdtSection;
+  uint32_t lastStallMs;
+  uint32_t stalls;
+  uint32_t wdtResets;
+};
+
+RTC_NOINIT_ATTR static ProfRtc _rtc;
+
+struct ProfWindow {
+  uint32_t maxUs[PROF_SECTION_COUNT];
+  uint32_t totalUs[PROF_SECTION_COUNT];
+};
+
+static ProfWindow _win;
+static ProfWindow _lastWin;
+static unsigned long _winStartMs = 0;
+
+static uint32_t _enterUs = 0;
+static unsigned long _loopStartMs = 0;
+static bool _hang = false;
+static bool _stall = false;          // alguna sección de esta vuelta
+
+// Salud para el watchdog (ver loop_prof.h)
+static uint8_t _sickLoops = 0;       // vueltas sanas que faltan; 0 = sano
+static bool _stuck = false;
+static uint8_t _hangCount[PROF_SECTION_COUNT];
+static unsigned long _hangSinceMs[PROF_SECTION_COUNT];
+
+const char* prof_sectionName(uint8_t s) {
+  return s < PROF_SECTION_COUNT ? SECTION_NAMES[s] : "";
+}
+
+void prof_begin() {
+  if (_rtc.magic != PROF_RTC_MAGIC) {
+    memset(&_rtc, 0, sizeof(_rtc));
+    _rtc.magic = PROF_RTC_MAGIC;
+    _rtc.lastStallSection = PROF_NONE;
+    _rtc.wdtSection = PROF_NONE;
+  } else if (hal_resetWasWatchdog()) {
+    _rtc.wdtResets++;
+    _rtc.wdtSection = _rtc.cur;
+    LOGW("⚠️ Reset por watchdog; sección en curso: %s",
+         _rtc.cur < PROF_SECTION_COUNT ? SECTION_NAMES[_rtc.cur] : "?");
+  }
+  _rtc.cur = PROF_NONE;
+
+  memset(&_win, 0, sizeof(_win));
+  memset(&_lastWin, 0, sizeof(_lastWin));
+  _winStartMs = millis();
+
+  _sickLoops = 0;
+  _stuck = false;
+  memset(_hangCount, 0, sizeof(_hangCount));
+
+  hal_wdtBegin(PROF_WDT_TIMEOUT_MS);
+}
+
+// Cuelgues repetidos de una sección: el loop avanza a saltos pero no se
+// recupera, mejor un reset
+static void hangRepeat(ProfSection s) {
+  unsigned long now = millis();
+  if (_hangCount[s] == 0 || now - _hangSinceMs[s] > PROF_HANG_REPEAT_MS) {
+    _hangCount[s] = 0;
+    _hangSinceMs[s] = now;
+  }
+  if (++_hangCount[s] >= PROF_HANG_REPEAT && !_stuck) {
+    _stuck = true;
+    LOGE("❌ %s colgada %u veces en %lu s: sin watchdog hasta el reset", SECTION_NAMES[s],
+         (unsigned)_hangCount[s], PROF_HANG_REPEAT_MS / 1000);
+  }
+}
+
+void prof_enter(ProfSection s) {
+  _rtc.cur = s;
+  _enterUs = (uint32_t)micros();
+}
+
+void prof_exit(ProfSection s) {
+  if (s >= PROF_SECTION_COUNT) return;
+  uint32_t dt = (uint32_t)micros() - _enterUs;
+  _rtc.cur = PROF_NONE;
+
+  if (dt > _win.maxUs[s]) _win.maxUs[s] = dt;
+  _win.totalUs[s] += dt;
+
+  uint32_t ms = dt / 1000;
+  if (ms >= PROF_STALL_MS) {
+    _rtc.stalls++;
+    _rtc.lastStallSection = s;
+    _rtc.lastStallMs = ms;
+    LOGW("🐢 Stall en %s: %lu ms", SECTION_NAMES[s], (unsigned long)ms);
+    _stall = true;
+  }
+  if (ms >= PROF_HANG_MS) {
+    _hang = true;
+    hangRepeat((ProfSection)s);
+  }
+}
+
+void prof_loopStart() {
+  _loopStartMs = millis();
+}
+
+void prof_loopEnd() {
+  unsigned long now = millis();
+
+  if (_hang || now - _loopStartMs >= PROF_HANG_MS) {
+    if (_sickLoops == 0) LOGW("⚠️ Loop enfermo: watchdog sin alimentar hasta %u vueltas sanas", (unsigned)PROF_RECOVER_LOOPS);
+    _sickLoops = PROF_RECOVER_LOOPS;
+  } else if (_sickLoops > 0 && !_stall) {
+    _sickLoops--;
+  }
+  if (!_stuck && _sickLoops == 0) hal_wdtFeed();
+  else if (!_stuck) wake_within(PROF_RECOVER_WAKE_MS);   // convalecencia corta
+  _hang = false;
+  _stall = false;
+
+  if (now - _winStartMs >= PROF_WINDOW_MS) {
+    _winStartMs = now;
+    _lastWin = _win;
+    memset(&_win, 0, sizeof(_win));
+
+    LOGD("⏱ loop max/total ms: ble %lu/%lu wifi %lu/%lu boot %lu/%lu mqtt_conn %lu/%lu mqtt_loop %lu/%lu",
+         (unsigned long)(_lastWin.maxUs[PROF_BLE] / 1000), (unsigned long)(_lastWin.totalUs[PROF_BLE] / 1000),
+         (unsigned long)(_lastWin.maxUs[PROF_WIFI] / 1000), (unsigned long)(_lastWin.totalUs[PROF_WIFI] / 1000),
+         (unsigned long)(_lastWin.maxUs[PROF_BOOTSTRAP] / 1000), (unsigned long)(_lastWin.totalUs[PROF_BOOTSTRAP] / 1000),
+         (unsigned long)(_lastWin.maxUs[PROF_MQTT_CONN] / 1000), (unsigned long)(_lastWin.totalUs[PROF_MQTT_CONN] / 1000),
+         (unsigned long)(_lastWin.maxUs[PROF_MQTT_LOOP] / 1000), (unsigned long)(_lastWin.totalUs[PROF_MQTT_LOOP] / 1000));
+  }
+}
+
+void prof_getReport(ProfReport& r) {
+  r.worstSection = PROF_NONE;
+  r.worstMaxMs = 0;
+  r.worstTotalMs = 0;
+  uint32_t worstUs = 0;
+  for (uint8_t s = 0; s < PROF_SECTION_COUNT; s++) {
+    if (_lastWin.maxUs[s] > worstUs) {
+      worstUs = _lastWin.maxUs[s];
+      r.worstSection = s;
+      r.worstMaxMs = _lastWin.maxUs[s] / 1000;
+      r.worstTotalMs = _lastWin.totalUs[s] / 1000;
+    }
+  }
+
+  r.stalls = _rtc.stalls;
+  r.lastStallSection = _rtc.lastStallSection;
+  r.lastStallMs = _rtc.lastStallMs;
+  r.wdtResets = _rtc.wdtResets;
+  r.wdtSection = _rtc.wdtSection;
+  r.wdtStarved = _stuck || _sickLoops > 0;
+}
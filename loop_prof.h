@@ -0,0 +1,67 @@
+#pragma once
+#include <Arduino.h>
+
+// Perfilador del loop principal: tiempo máximo y acumulado de cada
+// sección por ventana, aviso de stalls con la sección culpable y
+// alimentación del watchdog solo si el loop va sano.
+// El último stall y la sección en curso al saltar el watchdog se
+// guardan en RTC (RTC_NOINIT) y sobreviven al reset.
+
+enum ProfSection : uint8_t {
+  PROF_BLE = 0,       // ble_loop()
+  PROF_WIFI,          // máquina WiFi + NTP
+  PROF_BOOTSTRAP,     // bootstrap HTTP(S)
+  PROF_MQTT_CONN,     // reconexión MQTT (TLS + CONNECT)
+  PROF_MQTT_LOOP,     // mqtt->loop(), cola de estados, métricas
+  PROF_SECTION_COUNT,
+  PROF_NONE = 0xFF
+};
+
+#define PROF_WINDOW_MS      10000UL   // ventana de max/acumulado
+#define PROF_STALL_MS       300UL     // sección más lenta que esto = stall
+#define PROF_HANG_MS        10000UL   // loop más lento que esto = enfermo
+#define PROF_WDT_TIMEOUT_MS 30000UL   // sin loop sano en este tiempo -> reset
+
+// Enfermo: tras un hang el watchdog no se alimenta hasta PROF_RECOVER_LOOPS
+// vueltas seguidas sin stall (una vuelta rápida suelta no lo cura).
+// Atascado: la misma sección colgada PROF_HANG_REPEAT veces en
+// PROF_HANG_REPEAT_MS deja de alimentarlo del todo, y el watchdog resetea.
+// Mientras está enfermo el loop se despierta cada PROF_RECOVER_WAKE_MS
+// aunque esté ocioso: con WAKE_MAX_IDLE_MS (5 s) las 3 vueltas no caben en
+// lo que queda del timeout tras un hang largo (>= 15 s).
+#define PROF_RECOVER_LOOPS   3
+#define PROF_RECOVER_WAKE_MS 500UL
+#define PROF_HANG_REPEAT    3
+#define PROF_HANG_REPEAT_MS 120000UL
+
+// Lee lo que dejó el arranque anterior y suscribe loop al watchdog
+void prof_begin();
+
+void prof_loopStart();
+void prof_loopEnd();   // alimenta el watchdog si el loop no está enfermo ni atascado
+
+void prof_enter(ProfSection s);
+void prof_exit(ProfSection s);
+
+const char* prof_sectionName(uint8_t s);
+
+struct ProfReport {
+  uint8_t worstSection;    // de la última ventana cerrada (PROF_NONE si nada)
+  uint32_t worstMaxMs;
+  uint32_t worstTotalMs;
+  uint32_t stalls;         // desde el encendido (sobrevive resets)
+  uint8_t lastStallSection;
+  uint32_t lastStallMs;
+  uint32_t wdtResets;
+  uint8_t wdtSection;      // en curso cuando saltó el último watchdog
+  bool wdtStarved;         // enfermo o atascado: el watchdog no se alimenta
+};
+
+void prof_getReport(ProfReport& r);
+
+// Mide el bloque donde vive: { ProfScope p(PROF_WIFI); ... }
+struct ProfScope {
+  explicit ProfScope(ProfSection s) : sec(s) { prof_enter(s); }
+  ~ProfScope() { prof_exit(sec); }
+  ProfSection sec;
+};
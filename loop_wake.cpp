@@ -0,0 +1,40 @@
+// loop_wake.cpp
+// Espera del loop principal por eventos (ver loop_wake.h)
+
+#include "loop_wake.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#define WAKE_ALL_BITS (WAKE_BIT_BLE | WAKE_BIT_MQTT | WAKE_BIT_WIFI | WAKE_BIT_TIME | WAKE_BIT_BOOT)
+
+static EventGroupHandle_t _wakeGroup = nullptr;
+static uint32_t _nextMs = WAKE_MAX_IDLE_MS;
+
+void wake_begin() {
+  if (!_wakeGroup) _wakeGroup = xEventGroupCreate();
+}
+
+void wake_signal(uint32_t bits) {
+  if (_wakeGroup) xEventGroupSetBits(_wakeGroup, bits);
+}
+
+void wake_within(uint32_t ms) {
+  if (ms < _nextMs) _nextMs = ms;
+}
+
+uint32_t wake_wait() {
+  uint32_t ms = _nextMs;
+  _nextMs = WAKE_MAX_IDLE_MS;
+
+  if (!_wakeGroup) {
+    delay(5);
+    return 0;
+  }
+
+  // mínimo un tick: un timer vencido no debe dejar sin CPU al idle (TWDT)
+  TickType_t ticks = pdMS_TO_TICKS(ms);
+  if (ticks == 0) ticks = 1;
+
+  return xEventGroupWaitBits(_wakeGroup, WAKE_ALL_BITS, pdTRUE, pdFALSE, ticks) & WAKE_ALL_BITS;
+}
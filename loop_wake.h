@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+
+// Espera del loop principal sin polling: loop() duerme en un event group
+// hasta que algo pasa (escritura BLE, socket MQTT legible, evento WiFi,
+// hora sincronizada, bootstrap terminado) o hasta el próximo timer
+// vencido que pidieron los módulos durante la pasada (heartbeat, kick de
+// advertising, reintentos).
+// Mientras espera, el idle de FreeRTOS puede entrar en light sleep.
+
+#define WAKE_BIT_BLE   (1u << 0)
+#define WAKE_BIT_MQTT  (1u << 1)
+#define WAKE_BIT_WIFI  (1u << 2)
+#define WAKE_BIT_TIME  (1u << 3)
+#define WAKE_BIT_BOOT  (1u << 4)
+
+#define WAKE_MAX_IDLE_MS 5000UL   // tope de sueño aunque nadie pida antes
+
+void wake_begin();
+
+// Despierta al loop (cualquier tarea; no desde ISR)
+void wake_signal(uint32_t bits);
+
+// Durante la pasada: "vuelve a llamarme dentro de ms como mucho"
+void wake_within(uint32_t ms);
+
+// ms que faltan para que venza un intervalo que empezó en sinceMs
+inline uint32_t wake_remaining(unsigned long sinceMs, uint32_t intervalMs, unsigned long now) {
+  unsigned long el = now - sinceMs;
+  return el >= intervalMs ? 0 : (uint32_t)(intervalMs - el);
+}
+
+// Bloquea hasta un evento o el timer más próximo; devuelve los bits
+uint32_t wake_wait();
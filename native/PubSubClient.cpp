@@ -0,0 +1,275 @@
+// PubSubClient.cpp
+// Cliente MQTT 3.1.1 mínimo para el build nativo (ver include/PubSubClient.h)
+
+#include <PubSubClient.h>
+#include <string>
+
+PubSubClient::PubSubClient() {
+  setBufferSize(MQTT_MAX_PACKET_SIZE);
+}
+
+PubSubClient::~PubSubClient() {
+  free(_buffer);
+}
+
+PubSubClient& PubSubClient::setClient(Client& client) {
+  _client = &client;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+  _domain = domain;
+  _port = port;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(Callback callback) {
+  _callback = callback;
+  return *this;
+}
+
+PubSubClient& PubSubClient::setKeepAlive(uint16_t keepAlive) {
+  _keepAlive = keepAlive;
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  if (size == 0) return false;
+  uint8_t* b = (uint8_t*)realloc(_buffer, size);
+  if (!b) return false;
+  _buffer = b;
+  _bufferSize = size;
+  return true;
+}
+
+// ======================
+// Cable
+// ======================
+static void putLen(std::string& out, size_t len) {
+  do {
+    uint8_t d = len % 128;
+    len /= 128;
+    if (len) d |= 0x80;
+    out += (char)d;
+  } while (len);
+}
+
+static void putStr(std::string& out, const char* s) {
+  size_t n = strlen(s);
+  out += (char)(n >> 8);
+  out += (char)(n & 0xFF);
+  out.append(s, n);
+}
+
+bool PubSubClient::writePacket(uint8_t header, const uint8_t* body, size_t len) {
+  std::string pkt;
+  pkt += (char)header;
+  putLen(pkt, len);
+  pkt.append((const char*)body, len);
+
+  _lastOutActivity = millis();
+  return _client->write((const uint8_t*)pkt.data(), pkt.size()) == pkt.size();
+}
+
+bool PubSubClient::sendAck(uint8_t header, uint16_t msgId) {
+  uint8_t id[2] = { (uint8_t)(msgId >> 8), (uint8_t)(msgId & 0xFF) };
+  return writePacket(header, id, 2);
+}
+
+// Un paquete entero en _buffer; len = bytes tras la cabecera fija.
+// Uno más grande que el buffer se lee y se descarta (false).
+bool PubSubClient::readPacket(uint32_t& len) {
+  int h = _client->read();
+  if (h < 0) return false;
+
+  len = 0;
+  uint32_t mult = 1;
+  for (int i = 0; i < 4; i++) {
+    int d = _client->read();
+    if (d < 0) return false;
+    len += (uint32_t)(d & 0x7F) * mult;
+    mult *= 128;
+    if (!(d & 0x80)) break;
+  }
+
+  _buffer[0] = (uint8_t)h;
+  bool fits = len + 1 <= _bufferSize;
+  for (uint32_t i = 0; i < len; i++) {
+    int c = _client->read();
+    if (c < 0) return false;
+    if (fits) _buffer[1 + i] = (uint8_t)c;
+  }
+  _lastInActivity = millis();
+  return fits;
+}
+
+// ======================
+// Sesión
+// ======================
+bool PubSubClient::connect(const char* id) {
+  return connect(id, nullptr, nullptr, nullptr, 0, false, nullptr, true);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass) {
+  return connect(id, user, pass, nullptr, 0, false, nullptr, true);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass,
+                           const char* willTopic, uint8_t willQos, bool willRetain,
+                           const char* willMessage, bool cleanSession) {
+  if (!_client) return false;
+  if (connected()) return true;
+
+  // como la librería: un socket ya abierto (TLS hecho aparte) se reutiliza
+  if (!_client->connected() && !_client->connect(_domain, _port)) {
+    _state = MQTT_CONNECT_FAILED;
+    return false;
+  }
+
+  uint8_t flags = 0;
+  if (cleanSession) flags |= 0x02;
+  if (willTopic) flags |= 0x04 | (uint8_t)(willQos << 3) | (willRetain ? 0x20 : 0);
+  if (user) flags |= 0x80;
+  if (pass) flags |= 0x40;
+
+  std::string body;
+  putStr(body, "MQTT");
+  body += (char)MQTT_VERSION_3_1_1;
+  body += (char)flags;
+  body += (char)(_keepAlive >> 8);
+  body += (char)(_keepAlive & 0xFF);
+  putStr(body, id);
+  if (willTopic) {
+    putStr(body, willTopic);
+    putStr(body, willMessage ? willMessage : "");
+  }
+  if (user) putStr(body, user);
+  if (pass) putStr(body, pass);
+
+  if (!writePacket(MQTTCONNECT, (const uint8_t*)body.data(), body.size())) {
+    _state = MQTT_CONNECTION_LOST;
+    _client->stop();
+    return false;
+  }
+
+  uint32_t len = 0;
+  if (!_client->available() || !readPacket(len) || (_buffer[0] & 0xF0) != MQTTCONNACK || len < 2) {
+    _state = MQTT_CONNECTION_TIMEOUT;
+    _client->stop();
+    return false;
+  }
+  if (_buffer[2] != 0) {
+    _state = _buffer[2];
+    _client->stop();
+    return false;
+  }
+
+  _pingOutstanding = false;
+  _lastInActivity = _lastOutActivity = millis();
+  _state = MQTT_CONNECTED;
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  if (_client && _client->connected()) {
+    uint8_t hdr[2] = { MQTTDISCONNECT, 0 };
+    _client->write(hdr, 2);
+  }
+  _state = MQTT_DISCONNECTED;
+  if (_client) _client->stop();
+  _lastInActivity = _lastOutActivity = millis();
+}
+
+bool PubSubClient::connected() {
+  if (!_client) return false;
+  if (_client->connected()) return _state == MQTT_CONNECTED;
+
+  if (_state == MQTT_CONNECTED) {
+    _state = MQTT_CONNECTION_LOST;
+    _client->stop();
+  }
+  return false;
+}
+
+// ======================
+// Publicar / suscribir
+// ======================
+bool PubSubClient::publish(const char* topic, const char* payload) {
+  return publish(topic, (const uint8_t*)payload, payload ? (unsigned int)strlen(payload) : 0, false);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  if (!connected()) return false;
+
+  // mismo límite que la librería: cabecera + topic + payload en el buffer
+  size_t tlen = strlen(topic);
+  if (5 + 2 + tlen + length > _bufferSize) return false;
+
+  std::string body;
+  putStr(body, topic);
+  body.append((const char*)payload, length);
+  return writePacket(MQTTPUBLISH | (retained ? 1 : 0), (const uint8_t*)body.data(), body.size());
+}
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+  if (!connected() || !topic || qos > 1) return false;
+
+  if (++_nextMsgId == 0) _nextMsgId = 1;
+  std::string body;
+  body += (char)(_nextMsgId >> 8);
+  body += (char)(_nextMsgId & 0xFF);
+  putStr(body, topic);
+  body += (char)qos;
+  return writePacket(MQTTSUBSCRIBE | 0x02, (const uint8_t*)body.data(), body.size());
+}
+
+bool PubSubClient::loop() {
+  if (!connected()) return false;
+
+  unsigned long now = millis();
+  unsigned long ka = (unsigned long)_keepAlive * 1000UL;
+  if (now - _lastInActivity > ka || now - _lastOutActivity > ka) {
+    if (_pingOutstanding) {
+      _state = MQTT_CONNECTION_TIMEOUT;
+      _client->stop();
+      return false;
+    }
+    uint8_t hdr[2] = { MQTTPINGREQ, 0 };
+    _client->write(hdr, 2);
+    _lastOutActivity = _lastInActivity = now;
+    _pingOutstanding = true;
+  }
+
+  if (!_client->available()) return true;
+
+  uint32_t len = 0;
+  if (!readPacket(len)) return true;
+
+  uint8_t type = _buffer[0] & 0xF0;
+  if (type == MQTTPUBLISH && len >= 2) {
+    uint8_t qos = (_buffer[0] >> 1) & 0x03;
+    uint16_t tlen = (uint16_t)((_buffer[1] << 8) | _buffer[2]);
+    if (3u + tlen > len + 1) return true;
+
+    // el topic se corre un byte hacia atrás para terminarlo en '\0'
+    memmove(_buffer + 2, _buffer + 3, tlen);
+    _buffer[2 + tlen] = '\0';
+    char* topic = (char*)_buffer + 2;
+
+    uint32_t off = 3 + tlen;
+    if (qos > 0) {
+      uint16_t msgId = (uint16_t)((_buffer[off] << 8) | _buffer[off + 1]);
+      off += 2;
+      if (_callback) _callback(topic, _buffer + off, len + 1 - off);
+      sendAck(MQTTPUBACK, msgId);
+    } else if (_callback) {
+      _callback(topic, _buffer + off, len + 1 - off);
+    }
+  } else if (type == MQTTPINGREQ) {
+    uint8_t hdr[2] = { MQTTPINGRESP, 0 };
+    _client->write(hdr, 2);
+  } else if (type == MQTTPINGRESP) {
+    _pingOutstanding = false;
+  }
+  return true;
+}
@@ -0,0 +1,49 @@
+// alloc_hooks.cpp
+// new/delete del build nativo: llevan la cuenta del heap vivo (para
+// hal_freeHeap) y avisan a esp_heap_trace_alloc_hook como el heap de IDF
+// con CONFIG_HEAP_USE_HOOKS (bench.cpp lo define si lo necesita).
+
+#include <Arduino.h>
+#include <atomic>
+#include <malloc.h>
+#include <new>
+
+extern "C" void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) __attribute__((weak));
+extern "C" void esp_heap_trace_free_hook(void* ptr) __attribute__((weak));
+
+static std::atomic<size_t> _live{ 0 };
+static std::atomic<size_t> _peak{ 0 };
+
+size_t native_heapLive() {
+  return _live;
+}
+
+size_t native_heapPeak() {
+  return _peak;
+}
+
+static void* allocate(size_t size) {
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+
+  size_t live = _live += malloc_usable_size(p);
+  size_t peak = _peak;
+  while (live > peak && !_peak.compare_exchange_weak(peak, live)) {}
+
+  if (esp_heap_trace_alloc_hook) esp_heap_trace_alloc_hook(p, size, 0);
+  return p;
+}
+
+static void release(void* p) {
+  if (!p) return;
+  if (esp_heap_trace_free_hook) esp_heap_trace_free_hook(p);
+  _live -= malloc_usable_size(p);
+  free(p);
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
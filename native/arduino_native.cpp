@@ -0,0 +1,131 @@
+// arduino_native.cpp
+// Arduino.h nativo: String, Serial y el reloj (real o simulado, ver sim.h)
+
+#include <Arduino.h>
+#include "sim.h"
+
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// ======================
+// String
+// ======================
+static std::string numToStr(unsigned long v, bool neg, unsigned char base) {
+  char buf[34];
+  char* p = buf + sizeof(buf) - 1;
+  *p = '\0';
+  do {
+    unsigned d = (unsigned)(v % base);
+    *--p = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+    v /= base;
+  } while (v);
+  if (neg) *--p = '-';
+  return std::string(p);
+}
+
+String::String(int v, unsigned char base) : String((long)v, base) {}
+String::String(unsigned int v, unsigned char base) : String((unsigned long)v, base) {}
+
+String::String(long v, unsigned char base) {
+  // como WString: negativos solo en base 10
+  if (base == DEC && v < 0) _s = numToStr(0ul - (unsigned long)v, true, base);
+  else _s = numToStr((unsigned long)v, false, base);
+}
+
+String::String(unsigned long v, unsigned char base) : _s(numToStr(v, false, base)) {}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) { unsigned int t = from; from = to; to = t; }
+  if (from >= _s.size()) return String();
+  if (to > _s.size()) to = (unsigned int)_s.size();
+  return String(_s.substr(from, to - from));
+}
+
+int String::indexOf(char c) const {
+  size_t i = _s.find(c);
+  return i == std::string::npos ? -1 : (int)i;
+}
+
+// ======================
+// Serial
+// ======================
+HardwareSerial Serial;
+
+static std::atomic<bool> _serialMute{ false };
+
+void sim_serialMute(bool mute) {
+  _serialMute = mute;
+}
+
+size_t Print::write(const uint8_t* buf, size_t n) {
+  if (!_serialMute) fwrite(buf, 1, n, stdout);
+  return n;
+}
+
+size_t Print::printf(const char* fmt, ...) {
+  char line[512];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  if (n < 0) return 0;
+  if ((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+  return write((const uint8_t*)line, (size_t)n);
+}
+
+// ======================
+// Reloj
+// ======================
+static const auto _t0 = std::chrono::steady_clock::now();
+static std::atomic<uint8_t> _clock{ SIM_CLOCK_REAL };
+static std::atomic<uint64_t> _simUs{ 0 };
+static std::atomic<uint64_t> _blockedUs{ 0 };
+
+static uint64_t realUs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - _t0).count();
+}
+
+void sim_setClock(SimClock mode) {
+  // el reloj simulado arranca en 1 s: un timestamp 0 suele significar "nunca"
+  if (mode == SIM_CLOCK_MANUAL && _clock != SIM_CLOCK_MANUAL) _simUs = realUs() + 1000000ull;
+  _clock = mode;
+}
+
+bool sim_clockManual() {
+  return _clock == SIM_CLOCK_MANUAL;
+}
+
+void sim_advanceMs(uint32_t ms) {
+  _simUs += (uint64_t)ms * 1000;
+}
+
+uint64_t sim_blockedUs() {
+  return _blockedUs;
+}
+
+unsigned long micros() {
+  return (unsigned long)(uint32_t)(_clock == SIM_CLOCK_MANUAL ? _simUs.load() : realUs());
+}
+
+unsigned long millis() {
+  return (unsigned long)(uint32_t)((_clock == SIM_CLOCK_MANUAL ? _simUs.load() : realUs()) / 1000);
+}
+
+void delay(unsigned long ms) {
+  _blockedUs += (uint64_t)ms * 1000;
+  if (_clock == SIM_CLOCK_MANUAL) _simUs += (uint64_t)ms * 1000;
+  else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  _blockedUs += us;
+  if (_clock == SIM_CLOCK_MANUAL) _simUs += us;
+  else std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
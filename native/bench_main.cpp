@@ -0,0 +1,79 @@
+// bench_main.cpp
+// nebadon_bench: el bench de bench.cpp en host. setup() corre los casos
+// (runBench) y saca la línea JSON por stdout; después se comprueban los
+// números que el bench promete y se sale sin loop().
+
+#include <Arduino.h>
+#include "bench.h"
+#include "sim.h"
+
+void setup();
+
+static int _fails = 0;
+
+static void fail(const char* what, const char* name) {
+  printf("BENCH_FAIL: %s (%s)\n", what, name);
+  _fails++;
+}
+
+static const BenchResult* need(const char* name) {
+  const BenchResult* r = bench_result(name);
+  if (!r) fail("caso sin resultado", name);
+  return r;
+}
+
+static void row(const char* label, const BenchResult* r) {
+  printf("  %-12s %4lu B  %6lu ciclos  %ld.%02ld allocs\n", label,
+         (unsigned long)r->bytes, (unsigned long)r->cyclesOp,
+         (long)(r->allocsX100 / 100), (long)(r->allocsX100 % 100));
+}
+
+// Ciclos y allocs por mensaje, y contra el parser de antes si se compiló
+static void reportCmd(const char* name, const char* parser, const char* before) {
+  const BenchResult* r = need(name);
+  if (!r) return;
+  if (r->allocsX100 != 0) fail("el camino de cmd reservó heap", name);
+
+  printf("%s\n", name);
+  row(parser, r);
+  const BenchResult* b = before ? bench_result(before) : nullptr;
+  if (b) row("ArduinoJson", b);
+}
+
+// Formatos de payload: bytes en el cable y costo de cada lado
+static void reportFormats() {
+  const BenchResult* json = need("state_render");
+  const BenchResult* cbor = need("state_render_cbor");
+  const BenchResult* ajson = bench_result("state_render_arduinojson");
+  const BenchResult* cmdJson = need("mqtt_cmd_vpin");
+  const BenchResult* cmdCbor = need("mqtt_cmd_cbor");
+  if (!json || !cbor || !cmdJson || !cmdCbor) return;
+
+  printf("estado (render)\n");
+  if (ajson) row("ArduinoJson", ajson);
+  row("JSON", json);
+  row("CBOR", cbor);
+  printf("cmd (parse + aplicar)\n");
+  row("JSON", cmdJson);
+  row("CBOR", cmdCbor);
+
+  if (cbor->bytes >= json->bytes) fail("CBOR no es más chico que JSON", "state_render_cbor");
+  if (ajson && ajson->bytes != json->bytes) fail("el JSON no da los bytes de ArduinoJson", "state_render");
+  if (json->allocsX100 != 0 || cbor->allocsX100 != 0) fail("el render del estado reservó heap", "state_render");
+}
+
+int main() {
+  setup();
+
+  // los casos de relé van en seco: solo restoreVpins() escribió el GPIO
+  if (sim_gpioWrites() != 1) fail("el bench escribió el GPIO", "apply_vpin");
+
+  reportCmd("mqtt_cmd_vpin", "json_scan", "mqtt_cmd_vpin_arduinojson");
+  reportCmd("mqtt_cmd_pin_str", "json_scan", "mqtt_cmd_pin_str_arduinojson");
+  reportCmd("mqtt_cmd_dup_id", "json_scan", nullptr);
+  reportCmd("mqtt_cmd_other_tenant", "json_scan", nullptr);
+  reportCmd("mqtt_cmd_cbor", "cbor_lite", nullptr);
+  reportFormats();
+
+  return _fails ? 1 : 0;
+}
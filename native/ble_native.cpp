@@ -0,0 +1,181 @@
+// ble_native.cpp
+// ble_control.h para el build nativo: la app la simula el test con
+// sim_ble*() (ver sim.h). Misma cola RX, framing y notify que
+// ble_control.cpp, sin NimBLE ni heartbeat.
+
+#include "ble_control.h"
+#include "ble_frame.h"
+#include "neb_log.h"
+#include "latency.h"
+#include "loop_wake.h"
+#include "sim.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#define BLE_MTU_DEFAULT 23
+#define BLE_RX_MAX      512
+#define BLE_MSG_MAX     4096
+
+struct BleRxItem {
+  uint32_t rxUs;
+  std::string data;
+};
+
+static bool g_connected = false;
+static uint16_t g_mtu = BLE_MTU_DEFAULT;
+static bool g_peerFramed = false;
+static uint8_t g_txMsgId = 0;
+static BleOnWriteFn g_onWrite = nullptr;
+
+static std::deque<BleRxItem> g_rx;
+static std::vector<std::string> g_notifies;
+
+static uint8_t g_rxMsg[BLE_MSG_MAX];
+static BleFrameRx g_rxFrame;
+static uint32_t g_rxMsgUs = 0;
+
+// Como la radio: un notify lleva como mucho MTU - 3 bytes
+static void ble_tx_notify(const uint8_t* data, size_t len) {
+  size_t att = (size_t)g_mtu - 3;
+  g_notifies.emplace_back((const char*)data, len < att ? len : att);
+}
+
+static void ble_tx_notify(const char* msg) {
+  ble_tx_notify((const uint8_t*)msg, strlen(msg));
+}
+
+bool ble_begin(const char* deviceName,
+               const char* serviceUUID,
+               const char* characteristicUUID,
+               BleOnWriteFn onWrite) {
+  (void)deviceName; (void)serviceUUID; (void)characteristicUUID;
+  g_onWrite = onWrite;
+  bleframe_rxInit(g_rxFrame, g_rxMsg, sizeof(g_rxMsg));
+  return true;
+}
+
+void ble_loop() {
+  while (!g_rx.empty()) {
+    BleRxItem item = g_rx.front();
+    g_rx.pop_front();
+
+    const char* v = item.data.c_str();
+    size_t n = item.data.size();
+    uint32_t rxUs = item.rxUs;
+
+    switch (bleframe_rxPush(g_rxFrame, (const uint8_t*)v, n)) {
+      case BLE_FRAME_PLAIN:
+        break;
+      case BLE_FRAME_PARTIAL:
+        g_peerFramed = true;
+        if (bleframe_isFirst((const uint8_t*)v, n)) g_rxMsgUs = item.rxUs;
+        continue;
+      case BLE_FRAME_DONE:
+        g_peerFramed = true;
+        if (bleframe_isFirst((const uint8_t*)v, n)) g_rxMsgUs = item.rxUs;
+        v = (const char*)g_rxMsg;
+        n = g_rxFrame.len;
+        rxUs = g_rxMsgUs;
+        break;
+      case BLE_FRAME_ERROR:
+        LOGW("[BLE] Fragmento inválido o fuera de orden, mensaje descartado");
+        ble_tx_notify("{\"ok\":false,\"err\":\"FRAME\"}");
+        continue;
+    }
+
+    while (n > 0 && isspace((unsigned char)*v)) { v++; n--; }
+    while (n > 0 && isspace((unsigned char)v[n - 1])) n--;
+    if (n == 0) continue;
+
+    if (n == 7 && strncasecmp(v, "FRAMING", 7) == 0) {
+      g_peerFramed = true;
+      char ack[64];
+      snprintf(ack, sizeof(ack), "{\"ok\":true,\"type\":\"framing\",\"max\":%u}", (unsigned)BLE_MSG_MAX);
+      ble_notify(ack);
+      continue;
+    }
+
+    lat_begin(rxUs);
+    lat_mark(LAT_DISPATCH);
+    if (g_onWrite) g_onWrite((const uint8_t*)v, n);
+    lat_end();
+
+    if (n == 4 && strncasecmp(v, "PING", 4) == 0) ble_tx_notify("PONG");
+  }
+}
+
+static bool ble_tx_chunk(const uint8_t* chunk, size_t len, void* ctx) {
+  (void)ctx;
+  if (!g_connected) return false;
+  ble_tx_notify(chunk, len);
+  return true;
+}
+
+void ble_notify(const char* msg) {
+  if (!g_connected || !msg) return;
+
+  size_t len = strlen(msg);
+  switch (bleframe_tx((const uint8_t*)msg, len, g_txMsgId++, (size_t)g_mtu - 3,
+                      g_peerFramed, ble_tx_chunk, nullptr)) {
+    case BLE_TX_OK:
+      break;
+    case BLE_TX_TOO_LONG:
+      LOGW("[BLE] TX de %u bytes > MTU %u y el peer no habla framing: se le avisa con err MTU",
+           (unsigned)len, (unsigned)g_mtu);
+      break;
+    case BLE_TX_FAILED:
+      LOGW("[BLE] TX de %u bytes abortado", (unsigned)len);
+      break;
+  }
+}
+
+size_t ble_notifyMax() {
+  return g_peerFramed ? BLE_MSG_MAX : (size_t)g_mtu - 3;
+}
+
+bool ble_isConnected() {
+  return g_connected;
+}
+
+// ======================
+// Lado de la app (sim.h)
+// ======================
+void sim_bleConnect(bool connected) {
+  g_connected = connected;
+  g_mtu = BLE_MTU_DEFAULT;
+  g_peerFramed = false;
+  if (connected) ble_tx_notify("READY");
+  wake_signal(WAKE_BIT_BLE);
+}
+
+void sim_bleSetMtu(uint16_t mtu) {
+  g_mtu = mtu;
+}
+
+void sim_bleWrite(const uint8_t* data, size_t len) {
+  if (len == 0) return;
+  if (len > BLE_RX_MAX) {
+    ble_tx_notify("{\"ok\":false,\"err\":\"TOO_LONG\"}");
+    return;
+  }
+  g_rx.push_back(BleRxItem{ (uint32_t)micros(), std::string((const char*)data, len) });
+  wake_signal(WAKE_BIT_BLE);
+}
+
+void sim_bleWrite(const char* msg) {
+  sim_bleWrite((const uint8_t*)msg, strlen(msg));
+}
+
+size_t sim_bleNotifyCount() {
+  return g_notifies.size();
+}
+
+const std::string& sim_bleNotify(size_t i) {
+  return g_notifies.at(i);
+}
+
+void sim_bleClearNotifies() {
+  g_notifies.clear();
+}
@@ -0,0 +1,383 @@
+// freertos_native.cpp
+// FreeRTOS sobre hilos POSIX (ver native/include/freertos/*.h)
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "freertos/ringbuf.h"
+#include "sim.h"
+
+#include <pthread.h>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <mutex>
+#include <vector>
+
+#define STACK_PAINT      0xA5
+#define STACK_PAINT_GAP  256   // por debajo del frame actual (zona roja x86-64)
+
+struct NativeTask {
+  TaskFunction_t fn;
+  void* param;
+  uint32_t depth;
+  uint8_t* stackLo;    // zona pintada [stackLo, stackLo + depth)
+
+  std::mutex m;
+  std::condition_variable cv;
+  uint32_t notify;
+
+  // reparto con reloj manual (ver "Reloj manual y tareas"), bajo _schedM
+  bool blocked;
+  bool waitingNotify;
+  bool sleeping;
+  unsigned long wakeAtMs;
+};
+
+static thread_local NativeTask* _self = nullptr;
+
+// Hilos que no nacieron de xTaskCreate (el main) también tienen handle:
+// pueden recibir notificaciones
+static NativeTask* selfTask() {
+  if (!_self) {
+    _self = new NativeTask();
+    _self->fn = nullptr;
+    _self->param = nullptr;
+    _self->depth = 0;
+    _self->stackLo = nullptr;
+    _self->notify = 0;
+    _self->blocked = false;
+    _self->waitingNotify = false;
+    _self->sleeping = false;
+    _self->wakeAtMs = 0;
+  }
+  return _self;
+}
+
+static bool onTaskThread() {
+  return _self && _self->fn;
+}
+
+// ======================
+// Reloj manual y tareas
+// ======================
+// Con el reloj simulado el tiempo lo avanza el loop mientras espera. Para
+// que las tareas (bootstrap, watcher MQTT) vean el mismo tiempo que el
+// loop se reparte la CPU como en un solo núcleo: una tarea solo corre con
+// el loop parado en una espera, y el reloj solo avanza cuando todas las
+// tareas están bloqueadas (notify o vTaskDelay). Con reloj real no se
+// reparte nada: los hilos corren a la vez.
+#define SCHED_STALL_MS 2000   // tiempo real que se espera a una tarea que no bloquea
+
+// sin destructor: al salir del test quedan tareas esperando en ellos
+static std::mutex& _schedM = *new std::mutex();
+static std::condition_variable& _schedCv = *new std::condition_variable();
+static int _runnable = 0;            // tareas que no están bloqueadas
+static bool _loopParked = false;     // el loop espera: las tareas pueden correr
+static std::vector<NativeTask*> _sleepers;
+
+// La tarea deja la CPU (bloquea o termina)
+static void schedBlock(NativeTask* t, bool waitingNotify = false) {
+  std::lock_guard<std::mutex> lk(_schedM);
+  if (!t->blocked) {
+    t->blocked = true;
+    _runnable--;
+  }
+  t->waitingNotify = waitingNotify;
+  _schedCv.notify_all();
+}
+
+// La tarea vuelve a tener trabajo (la despiertan o vence su espera)
+static void schedUnblock(NativeTask* t) {
+  std::lock_guard<std::mutex> lk(_schedM);
+  if (t->blocked) {
+    t->blocked = false;
+    _runnable++;
+  }
+  t->waitingNotify = false;
+}
+
+// Un notify solo despierta a quien lo espera (no a un vTaskDelay)
+static void schedNotified(NativeTask* t) {
+  std::lock_guard<std::mutex> lk(_schedM);
+  if (t->waitingNotify) {
+    t->waitingNotify = false;
+    t->blocked = false;
+    _runnable++;
+  }
+}
+
+// Turno de la tarea: con reloj manual, hasta que el loop espere
+static void schedEnter() {
+  std::unique_lock<std::mutex> lk(_schedM);
+  _schedCv.wait(lk, [] { return _loopParked || !sim_clockManual(); });
+}
+
+// El loop se para: corren las tareas con trabajo hasta que bloqueen
+static void schedPark() {
+  std::unique_lock<std::mutex> lk(_schedM);
+  _loopParked = true;
+  _schedCv.notify_all();
+  if (!_schedCv.wait_for(lk, std::chrono::milliseconds(SCHED_STALL_MS), [] { return _runnable <= 0; })) {
+    fprintf(stderr, "[sim] una tarea no bloquea: el reloj sigue sin ella\n");
+  }
+}
+
+static void schedUnpark() {
+  std::lock_guard<std::mutex> lk(_schedM);
+  _loopParked = false;
+}
+
+// El reloj avanzó: despierta los vTaskDelay vencidos y les deja correr
+static void schedWakeDue() {
+  {
+    std::lock_guard<std::mutex> lk(_schedM);
+    unsigned long now = millis();
+    for (size_t i = 0; i < _sleepers.size();) {
+      NativeTask* t = _sleepers[i];
+      if ((long)(now - t->wakeAtMs) < 0) {
+        i++;
+        continue;
+      }
+      t->sleeping = false;
+      t->blocked = false;
+      _runnable++;
+      _sleepers[i] = _sleepers.back();
+      _sleepers.pop_back();
+    }
+    _schedCv.notify_all();
+  }
+  schedPark();
+}
+
+// Pinta depth bytes por debajo de este frame; la tarea corre justo encima
+__attribute__((noinline)) static void paintStack(NativeTask* t) {
+  volatile uint8_t* top = (volatile uint8_t*)__builtin_frame_address(0) - STACK_PAINT_GAP;
+  t->stackLo = (uint8_t*)(top - t->depth);
+  for (uint32_t i = 0; i < t->depth; i++) t->stackLo[i] = STACK_PAINT;
+}
+
+static void* taskMain(void* arg) {
+  NativeTask* t = (NativeTask*)arg;
+  _self = t;
+  schedEnter();
+  paintStack(t);
+  t->fn(t->param);
+  schedBlock(t);
+  return nullptr;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                       void* param, UBaseType_t prio, TaskHandle_t* out) {
+  (void)name; (void)prio;
+  NativeTask* t = new NativeTask();
+  t->fn = fn;
+  t->param = param;
+  t->depth = stackDepth;
+  t->stackLo = nullptr;
+  t->notify = 0;
+  t->blocked = false;
+  t->waitingNotify = false;
+  t->sleeping = false;
+  t->wakeAtMs = 0;
+  {
+    std::lock_guard<std::mutex> lk(_schedM);
+    _runnable++;
+  }
+
+  pthread_t th;
+  if (pthread_create(&th, nullptr, taskMain, t) != 0) {
+    schedBlock(t);
+    delete t;
+    return pdFAIL;
+  }
+  pthread_detach(th);
+  if (out) *out = t;
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t t) {
+  if (t != nullptr && t != _self) return;   // borrar otra tarea: no soportado
+  if (onTaskThread()) schedBlock(_self);
+  pthread_exit(nullptr);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  // el hilo del loop sigue al reloj del sim
+  if (!onTaskThread()) {
+    delay(ticks);
+    return;
+  }
+  NativeTask* t = _self;
+  if (!sim_clockManual()) {
+    schedBlock(t);
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+    schedUnblock(t);
+    return;
+  }
+
+  // reloj manual: la tarea duerme hasta que el loop lleve el reloj allí
+  std::unique_lock<std::mutex> lk(_schedM);
+  t->wakeAtMs = millis() + ticks;
+  t->sleeping = true;
+  t->blocked = true;
+  _runnable--;
+  _sleepers.push_back(t);
+  _schedCv.notify_all();
+  _schedCv.wait(lk, [t] { return !t->sleeping && _loopParked; });
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return selfTask();
+}
+
+void xTaskNotifyGive(TaskHandle_t t) {
+  if (!t) return;
+  if (t->fn) schedNotified(t);   // tiene trabajo antes de que avance el reloj
+  {
+    std::lock_guard<std::mutex> lk(t->m);
+    t->notify++;
+  }
+  t->cv.notify_all();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  NativeTask* t = selfTask();
+  bool task = onTaskThread();
+  // el loop esperando a una tarea (bench) también deja correr a las demás
+  if (task) schedBlock(t, true);
+  else if (sim_clockManual()) schedPark();
+
+  uint32_t v;
+  {
+    std::unique_lock<std::mutex> lk(t->m);
+    auto ready = [t] { return t->notify > 0; };
+    if (ticks == portMAX_DELAY) t->cv.wait(lk, ready);
+    else t->cv.wait_for(lk, std::chrono::milliseconds(ticks), ready);
+
+    v = t->notify;
+    if (v) t->notify = clearOnExit ? 0 : v - 1;
+  }
+
+  if (task) {
+    schedUnblock(t);
+    schedEnter();
+  } else if (sim_clockManual()) {
+    schedUnpark();
+  }
+  return v;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t t) {
+  if (!t) t = _self;
+  if (!t || !t->stackLo) return 0;
+  UBaseType_t n = 0;
+  while (n < t->depth && t->stackLo[n] == STACK_PAINT) n++;
+  return n;
+}
+
+// ======================
+// Sección crítica
+// ======================
+static std::recursive_mutex _critical;
+
+void native_muxEnter(portMUX_TYPE* m) {
+  (void)m;
+  _critical.lock();
+}
+
+void native_muxExit(portMUX_TYPE* m) {
+  (void)m;
+  _critical.unlock();
+}
+
+// ======================
+// Event groups
+// ======================
+// Lo da hal_native.cpp (eventos WiFi/SNTP vencidos); sin él, nada
+__attribute__((weak)) void native_simTick() {}
+
+struct NativeEventGroup {
+  std::mutex m;
+  std::condition_variable cv;
+  EventBits_t bits;
+};
+
+EventGroupHandle_t xEventGroupCreate() {
+  NativeEventGroup* g = new NativeEventGroup();
+  g->bits = 0;
+  return g;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits) {
+  EventBits_t now;
+  {
+    std::lock_guard<std::mutex> lk(g->m);
+    g->bits |= bits;
+    now = g->bits;
+  }
+  g->cv.notify_all();
+  return now;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitAll, TickType_t ticks) {
+  std::unique_lock<std::mutex> lk(g->m);
+  auto ready = [&] {
+    EventBits_t b = g->bits & bits;
+    return waitAll ? b == bits : b != 0;
+  };
+
+  if (sim_clockManual() && ticks != portMAX_DELAY) {
+    // reloj simulado: nadie más lo mueve, así que esperar es avanzarlo,
+    // de a 1 ms para que los fakes disparen sus eventos a tiempo. Antes de
+    // cada paso corren las tareas que tengan trabajo.
+    lk.unlock();
+    schedPark();
+    lk.lock();
+    for (TickType_t t = 0; t < ticks && !ready(); t++) {
+      lk.unlock();
+      sim_advanceMs(1);
+      native_simTick();
+      schedWakeDue();
+      lk.lock();
+    }
+    lk.unlock();
+    schedUnpark();
+    lk.lock();
+  } else if (!ready()) {
+    if (ticks == portMAX_DELAY) {
+      g->cv.wait(lk, ready);
+    } else {
+      g->cv.wait_for(lk, std::chrono::milliseconds(ticks), ready);
+    }
+  }
+
+  EventBits_t out = g->bits;
+  if (clearOnExit && ready()) g->bits &= ~bits;
+  return out;
+}
+
+// ======================
+// Ring buffer: no hay (neb_log escribe directo)
+// ======================
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t type) {
+  (void)size; (void)type;
+  return nullptr;
+}
+
+BaseType_t xRingbufferSend(RingbufHandle_t rb, const void* data, size_t size, TickType_t ticks) {
+  (void)rb; (void)data; (void)size; (void)ticks;
+  return pdFALSE;
+}
+
+void* xRingbufferReceiveUpTo(RingbufHandle_t rb, size_t* size, TickType_t ticks, size_t max) {
+  (void)rb; (void)ticks; (void)max;
+  if (size) *size = 0;
+  return nullptr;
+}
+
+void vRingbufferReturnItem(RingbufHandle_t rb, void* item) {
+  (void)rb; (void)item;
+}
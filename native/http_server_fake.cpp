@@ -0,0 +1,70 @@
+// http_server_fake.cpp
+// Servidor HTTP en proceso (ver http_server_fake.h)
+
+#include "http_server_fake.h"
+#include <Arduino.h>
+
+std::string HttpServerFake::Request::header(const char* name) const {
+  for (const auto& h : headers) {
+    if (strcasecmp(h.first.c_str(), name) == 0) return h.second;
+  }
+  return "";
+}
+
+bool HttpServerFake::accept(const std::shared_ptr<LoopbackConn>& c) {
+  (void)c;
+  return up;
+}
+
+static std::string trim(const std::string& s) {
+  size_t a = 0, b = s.size();
+  while (a < b && isspace((unsigned char)s[a])) a++;
+  while (b > a && isspace((unsigned char)s[b - 1])) b--;
+  return s.substr(a, b - a);
+}
+
+void HttpServerFake::onData(LoopbackConn& c) {
+  std::string& in = c.fromClient;
+  size_t end = in.find("\r\n\r\n");
+  if (end == std::string::npos) return;
+
+  Request req;
+  size_t lineEnd = in.find("\r\n");
+  std::string first = in.substr(0, lineEnd);
+  size_t sp1 = first.find(' ');
+  size_t sp2 = first.find(' ', sp1 + 1);
+  if (sp1 == std::string::npos || sp2 == std::string::npos) {
+    c.close();
+    return;
+  }
+  req.method = first.substr(0, sp1);
+  req.path = first.substr(sp1 + 1, sp2 - sp1 - 1);
+
+  size_t pos = lineEnd + 2;
+  while (pos < end) {
+    size_t e = in.find("\r\n", pos);
+    std::string line = in.substr(pos, e - pos);
+    size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+      req.headers.emplace_back(trim(line.substr(0, colon)), trim(line.substr(colon + 1)));
+    }
+    pos = e + 2;
+  }
+
+  size_t bodyLen = (size_t)atol(req.header("Content-Length").c_str());
+  if (in.size() < end + 4 + bodyLen) return;   // falta cuerpo
+  req.body = in.substr(end + 4, bodyLen);
+  in.clear();
+  requests.push_back(req);
+
+  std::string body;
+  int code = handler ? handler(req, body) : 404;
+
+  char head[160];
+  snprintf(head, sizeof(head),
+           "HTTP/1.1 %d X\r\nContent-Type: application/json\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+           code, (unsigned)body.size());
+  c.send(std::string(head) + body);
+  if (latencyMs) c.readyAtMs = millis() + latencyMs;
+  c.close();
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "loopback.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Servidor HTTP/1.1 en proceso (sobre loopback.h) para los tests: una
+// petición por conexión, cuerpo por Content-Length, y la respuesta la da
+// el handler del test.
+
+class HttpServerFake : public LoopbackServer {
+public:
+  struct Request {
+    std::string method;
+    std::string path;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+
+    // "" si no vino (nombre sin distinguir mayúsculas)
+    std::string header(const char* name) const;
+  };
+
+  // Devuelve el código HTTP y deja el cuerpo de la respuesta en body
+  typedef std::function<int(const Request& req, std::string& body)> Handler;
+
+  bool up = true;
+  uint32_t latencyMs = 0;       // la respuesta tarda esto en llegar (reloj del sim)
+  Handler handler;              // sin handler: 404
+  std::vector<Request> requests;
+
+  bool accept(const std::shared_ptr<LoopbackConn>& c) override;
+  void onData(LoopbackConn& c) override;
+};
@@ -0,0 +1,103 @@
+#pragma once
+// Arduino.h para el build nativo (Linux): lo justo que usa el firmware.
+// El reloj (millis/micros/delay) lo controla native/sim.h: tiempo real
+// o simulado, según el test.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define DEC 10
+#define HEX 16
+
+// En placa van a IRAM/RTC; aquí son RAM normal
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+typedef uint8_t byte;
+
+// ======================
+// String (subconjunto de WString sobre std::string)
+// ======================
+class String {
+public:
+  String() {}
+  String(const char* s) : _s(s ? s : "") {}
+  String(const std::string& s) : _s(s) {}
+  String(char c) : _s(1, c) {}
+  explicit String(int v, unsigned char base = DEC);
+  explicit String(unsigned int v, unsigned char base = DEC);
+  explicit String(long v, unsigned char base = DEC);
+  explicit String(unsigned long v, unsigned char base = DEC);
+
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return (unsigned int)_s.size(); }
+  void reserve(unsigned int n) { _s.reserve(n); }
+
+  bool startsWith(const String& p) const { return _s.compare(0, p._s.size(), p._s) == 0; }
+  bool endsWith(const String& p) const {
+    return _s.size() >= p._s.size() && _s.compare(_s.size() - p._s.size(), p._s.size(), p._s) == 0;
+  }
+  String substring(unsigned int from) const { return from >= _s.size() ? String() : String(_s.substr(from)); }
+  String substring(unsigned int from, unsigned int to) const;
+  int indexOf(char c) const;
+  long toInt() const { return atol(_s.c_str()); }
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(_s.c_str(), o._s.c_str()) == 0; }
+
+  char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : '\0'; }
+  bool operator==(const String& o) const { return _s == o._s; }
+  bool operator==(const char* o) const { return _s == (o ? o : ""); }
+  bool operator!=(const String& o) const { return _s != o._s; }
+  bool operator!=(const char* o) const { return !(*this == o); }
+
+  String& operator+=(const String& o) { _s += o._s; return *this; }
+  String& operator+=(const char* o) { _s += (o ? o : ""); return *this; }
+  String& operator+=(char c) { _s += c; return *this; }
+
+  friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+  friend String operator+(const String& a, const char* b) { return String(a._s + (b ? b : "")); }
+  friend String operator+(const char* a, const String& b) { return String((a ? a : "") + b._s); }
+  friend String operator+(const String& a, char c) { return String(a._s + c); }
+
+private:
+  std::string _s;
+};
+
+// ======================
+// Serial -> stdout
+// ======================
+class Print {
+public:
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buf, size_t n);
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t println(const char* s) { return print(s) + print("\n"); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+};
+
+extern HardwareSerial Serial;
+
+// ======================
+// Tiempo (ver sim.h)
+// ======================
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
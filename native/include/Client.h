@@ -0,0 +1,19 @@
+#pragma once
+#include <Arduino.h>
+
+// Client de Arduino (la parte que usan PubSubClient y hal_native.cpp)
+class Client : public Print {
+public:
+  virtual ~Client() {}
+  virtual int connect(const char* host, uint16_t port) = 0;
+  virtual size_t write(const uint8_t* buf, size_t size) = 0;
+  size_t write(uint8_t c) { return write(&c, 1); }
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t* buf, size_t size) = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() { return connected(); }
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <Arduino.h>
+#include <Client.h>
+#include <functional>
+
+// PubSubClient para el build nativo: la misma API (lo que usa
+// net_wifi_mqtt.cpp) sobre un Client cualquiera, MQTT 3.1.1 con QoS 0/1
+// de entrada. Un paquete por loop(), como la librería.
+// Las respuestas (CONNACK) se leen sin esperar: sobre loopback ya están
+// en el buffer o no llegan.
+
+#define MQTT_VERSION_3_1_1 4
+
+#ifndef MQTT_MAX_PACKET_SIZE
+  #define MQTT_MAX_PACKET_SIZE 256
+#endif
+#ifndef MQTT_KEEPALIVE
+  #define MQTT_KEEPALIVE 15
+#endif
+
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+#define MQTT_CONNECT_BAD_PROTOCOL    1
+#define MQTT_CONNECT_BAD_CLIENT_ID   2
+#define MQTT_CONNECT_UNAVAILABLE     3
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+#define MQTT_CONNECT_UNAUTHORIZED    5
+
+#define MQTTCONNECT     (1 << 4)
+#define MQTTCONNACK     (2 << 4)
+#define MQTTPUBLISH     (3 << 4)
+#define MQTTPUBACK      (4 << 4)
+#define MQTTSUBSCRIBE   (8 << 4)
+#define MQTTSUBACK      (9 << 4)
+#define MQTTPINGREQ     (12 << 4)
+#define MQTTPINGRESP    (13 << 4)
+#define MQTTDISCONNECT  (14 << 4)
+
+class PubSubClient {
+public:
+  typedef std::function<void(char*, uint8_t*, unsigned int)> Callback;
+
+  PubSubClient();
+  ~PubSubClient();
+
+  PubSubClient& setClient(Client& client);
+  PubSubClient& setServer(const char* domain, uint16_t port);
+  PubSubClient& setCallback(Callback callback);
+  PubSubClient& setKeepAlive(uint16_t keepAlive);
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() { return _bufferSize; }
+
+  bool connect(const char* id);
+  bool connect(const char* id, const char* user, const char* pass);
+  bool connect(const char* id, const char* user, const char* pass,
+               const char* willTopic, uint8_t willQos, bool willRetain,
+               const char* willMessage, bool cleanSession);
+  void disconnect();
+
+  bool publish(const char* topic, const char* payload);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained);
+  bool subscribe(const char* topic, uint8_t qos = 0);
+
+  bool loop();
+  bool connected();
+  int state() { return _state; }
+
+private:
+  bool readPacket(uint32_t& len);
+  bool writePacket(uint8_t header, const uint8_t* body, size_t len);
+  bool sendAck(uint8_t header, uint16_t msgId);
+
+  Client* _client = nullptr;
+  const char* _domain = nullptr;
+  uint16_t _port = 0;
+  Callback _callback;
+  uint8_t* _buffer = nullptr;
+  uint16_t _bufferSize = 0;
+  uint16_t _keepAlive = MQTT_KEEPALIVE;
+  uint16_t _nextMsgId = 0;
+  unsigned long _lastOutActivity = 0;
+  unsigned long _lastInActivity = 0;
+  bool _pingOutstanding = false;
+  int _state = MQTT_DISCONNECTED;
+};
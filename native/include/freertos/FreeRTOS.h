@@ -0,0 +1,35 @@
+#pragma once
+// FreeRTOS para el build nativo: tareas = hilos POSIX, tick de 1 ms.
+// Solo la API que usa el firmware (ver native/freertos_native.cpp).
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;   // como en ESP-IDF: la profundidad va en bytes
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  0
+#define pdPASS  1
+
+#define portMAX_DELAY      ((TickType_t)0xFFFFFFFFu)
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define portNUM_PROCESSORS 1
+#define tskIDLE_PRIORITY   0
+
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// Sección crítica: en placa un spinlock por mux; aquí un solo mutex global
+// (como deshabilitar interrupciones en un solo núcleo)
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+
+void native_muxEnter(portMUX_TYPE* m);
+void native_muxExit(portMUX_TYPE* m);
+
+#define portENTER_CRITICAL(m) native_muxEnter(m)
+#define portEXIT_CRITICAL(m)  native_muxExit(m)
@@ -0,0 +1,14 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+struct NativeEventGroup;
+typedef NativeEventGroup* EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate();
+EventBits_t xEventGroupSetBits(EventGroupHandle_t g, EventBits_t bits);
+
+// Con reloj simulado una espera sin eventos avanza el reloj en vez de
+// dormir (el loop "duerme" sin gastar tiempo real)
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t g, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitAll, TickType_t ticks);
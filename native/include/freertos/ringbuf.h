@@ -0,0 +1,18 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+// En nativo no hay ring buffer: xRingbufferCreate() devuelve nullptr y
+// neb_log escribe directo a Serial (stdout)
+
+typedef void* RingbufHandle_t;
+
+enum RingbufferType_t {
+  RINGBUF_TYPE_NOSPLIT = 0,
+  RINGBUF_TYPE_ALLOWSPLIT,
+  RINGBUF_TYPE_BYTEBUF,
+};
+
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t type);
+BaseType_t xRingbufferSend(RingbufHandle_t rb, const void* data, size_t size, TickType_t ticks);
+void* xRingbufferReceiveUpTo(RingbufHandle_t rb, size_t* size, TickType_t ticks, size_t max);
+void vRingbufferReturnItem(RingbufHandle_t rb, void* item);
@@ -0,0 +1,20 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+struct NativeTask;
+typedef NativeTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// La tarea corre en un hilo propio; stackDepth (bytes) solo sirve para
+// uxTaskGetStackHighWaterMark, que mide sobre una zona pintada del stack
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth,
+                       void* param, UBaseType_t prio, TaskHandle_t* out);
+void vTaskDelete(TaskHandle_t t);   // solo nullptr (la propia tarea)
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+void xTaskNotifyGive(TaskHandle_t t);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+
+// Bytes del stack que la tarea nunca tocó (solo nullptr)
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t t);
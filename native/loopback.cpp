@@ -0,0 +1,99 @@
+// loopback.cpp
+// Red en proceso (ver loopback.h)
+
+#include "loopback.h"
+#include <Arduino.h>
+#include <vector>
+
+struct Listener {
+  std::string host;   // "" = cualquiera
+  uint16_t port;
+  LoopbackServer* srv;
+};
+
+static std::vector<Listener> _listeners;
+
+void loopback_listen(const char* host, uint16_t port, LoopbackServer* srv) {
+  _listeners.push_back(Listener{ host ? host : "", port, srv });
+}
+
+void loopback_unlisten(LoopbackServer* srv) {
+  for (size_t i = 0; i < _listeners.size();) {
+    if (_listeners[i].srv == srv) _listeners.erase(_listeners.begin() + i);
+    else i++;
+  }
+}
+
+static LoopbackServer* findServer(const char* host, uint16_t port) {
+  LoopbackServer* any = nullptr;
+  for (const Listener& l : _listeners) {
+    if (l.port != port) continue;
+    if (l.host == host) return l.srv;
+    if (l.host.empty()) any = l.srv;
+  }
+  return any;
+}
+
+int LoopbackClient::connect(const char* host, uint16_t port) {
+  stop();
+  LoopbackServer* srv = findServer(host ? host : "", port);
+  if (!srv) return 0;
+
+  std::shared_ptr<LoopbackConn> c = std::make_shared<LoopbackConn>();
+  if (!srv->accept(c)) return 0;
+  _conn = c;
+  _srv = srv;
+  return 1;
+}
+
+size_t LoopbackClient::write(const uint8_t* buf, size_t size) {
+  if (!_conn || !_conn->open) return 0;
+  _conn->fromClient.append((const char*)buf, size);
+  _srv->onData(*_conn);
+  return size;
+}
+
+int LoopbackClient::available() {
+  if (!_conn) return 0;
+  if (_conn->readyAtMs && (long)(millis() - _conn->readyAtMs) < 0) return 0;
+  return (int)(_conn->toClient.size() - _conn->readPos);
+}
+
+int LoopbackClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int LoopbackClient::read(uint8_t* buf, size_t size) {
+  int n = available();
+  if (n <= 0) return -1;
+  if ((size_t)n > size) n = (int)size;
+  memcpy(buf, _conn->toClient.data() + _conn->readPos, (size_t)n);
+  _conn->readPos += (size_t)n;
+
+  // todo leído: se compacta
+  if (_conn->readPos == _conn->toClient.size()) {
+    _conn->toClient.clear();
+    _conn->readPos = 0;
+  }
+  return n;
+}
+
+int LoopbackClient::peek() {
+  if (available() <= 0) return -1;
+  return (uint8_t)_conn->toClient[_conn->readPos];
+}
+
+void LoopbackClient::stop() {
+  if (_conn && _conn->open) {
+    _conn->open = false;
+    _srv->onClose(*_conn);
+  }
+  _conn.reset();
+  _srv = nullptr;
+}
+
+uint8_t LoopbackClient::connected() {
+  // como WiFiClient: sigue "conectado" mientras quede algo por leer
+  return _conn && (_conn->open || _conn->readPos < _conn->toClient.size());
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <Client.h>
+#include <memory>
+#include <string>
+
+// Red en proceso para el build nativo. Un LoopbackClient (Client de
+// Arduino) se conecta por host:puerto a un LoopbackServer registrado con
+// loopback_listen(); lo que escribe le llega al servidor dentro del mismo
+// write() y la respuesta queda lista para leer (o a partir de readyAtMs,
+// si el servidor simula latencia). Sin sockets: con el reloj manual las
+// tareas se turnan con el loop (freertos_native.cpp) y los tests son
+// deterministas.
+
+// Una conexión aceptada, vista desde el servidor
+struct LoopbackConn {
+  std::string toClient;   // bytes pendientes de leer por el cliente
+  size_t readPos = 0;
+  unsigned long readyAtMs = 0;   // el cliente no ve toClient hasta entonces (0 = ya)
+  bool open = true;
+  std::string fromClient; // lo recibido y aún no consumido (lo usa el servidor)
+
+  void send(const void* data, size_t len) { toClient.append((const char*)data, len); }
+  void send(const std::string& s) { toClient += s; }
+  // El servidor corta; el cliente aún puede leer lo pendiente
+  void close() { open = false; }
+};
+
+class LoopbackServer {
+public:
+  virtual ~LoopbackServer() {}
+  // false = conexión rechazada (servidor caído)
+  virtual bool accept(const std::shared_ptr<LoopbackConn>& c) = 0;
+  virtual void onData(LoopbackConn& c) = 0;   // nuevos bytes en c.fromClient
+  virtual void onClose(LoopbackConn& c) { (void)c; }
+};
+
+// host nullptr = cualquier host en ese puerto
+void loopback_listen(const char* host, uint16_t port, LoopbackServer* srv);
+void loopback_unlisten(LoopbackServer* srv);
+
+class LoopbackClient : public Client {
+public:
+  int connect(const char* host, uint16_t port) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void stop() override;
+  uint8_t connected() override;
+
+private:
+  std::shared_ptr<LoopbackConn> _conn;
+  LoopbackServer* _srv = nullptr;
+};
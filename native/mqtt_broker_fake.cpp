@@ -0,0 +1,270 @@
+// mqtt_broker_fake.cpp
+// Broker MQTT en proceso (ver mqtt_broker_fake.h)
+
+#include "mqtt_broker_fake.h"
+
+static void putLen(std::string& out, size_t len) {
+  do {
+    uint8_t d = len % 128;
+    len /= 128;
+    if (len) d |= 0x80;
+    out += (char)d;
+  } while (len);
+}
+
+static void sendPacket(LoopbackConn& c, uint8_t hdr, const std::string& body) {
+  std::string pkt;
+  pkt += (char)hdr;
+  putLen(pkt, body.size());
+  pkt += body;
+  c.send(pkt);
+}
+
+// Cadena MQTT (u16 BE + bytes) desde body[off]; avanza off
+static bool getStr(const std::string& body, size_t& off, std::string& out) {
+  if (off + 2 > body.size()) return false;
+  size_t n = ((uint8_t)body[off] << 8) | (uint8_t)body[off + 1];
+  if (off + 2 + n > body.size()) return false;
+  out = body.substr(off + 2, n);
+  off += 2 + n;
+  return true;
+}
+
+MqttBrokerFake::Link* MqttBrokerFake::findLink(LoopbackConn& c) {
+  for (Link& l : _links) {
+    if (l.conn.get() == &c) return &l;
+  }
+  return nullptr;
+}
+
+bool MqttBrokerFake::accept(const std::shared_ptr<LoopbackConn>& c) {
+  attemptsMs.push_back(millis());
+  if (!up || millis() < downUntilMs) return false;
+  _links.push_back(Link{ c, "" });
+  return true;
+}
+
+void MqttBrokerFake::onData(LoopbackConn& c) {
+  Link* l = findLink(c);
+  if (!l) return;
+
+  // paquetes completos: cabecera fija + longitud variable + cuerpo
+  for (;;) {
+    std::string& in = c.fromClient;
+    if (in.size() < 2) return;
+
+    size_t len = 0, mult = 1, i = 1;
+    for (;;) {
+      if (i >= in.size() || i > 4) return;
+      uint8_t d = (uint8_t)in[i++];
+      len += (d & 0x7F) * mult;
+      mult *= 128;
+      if (!(d & 0x80)) break;
+    }
+    if (in.size() < i + len) return;
+
+    uint8_t hdr = (uint8_t)in[0];
+    std::string body = in.substr(i, len);
+    in.erase(0, i + len);
+
+    handle(*l, hdr, body);
+    if (!c.open) return;
+    l = findLink(c);   // handle() puede mover _links
+    if (!l) return;
+  }
+}
+
+void MqttBrokerFake::handle(Link& l, uint8_t hdr, const std::string& body) {
+  LoopbackConn& c = *l.conn;
+  uint8_t type = hdr & 0xF0;
+
+  if (type == 0x10) {   // CONNECT
+    size_t off = 0;
+    std::string proto, clientId, user, pass, willTopic, willMsg;
+    if (!getStr(body, off, proto) || off + 4 > body.size()) { c.close(); return; }
+    uint8_t flags = (uint8_t)body[off + 1];
+    off += 4;   // nivel, flags, keepalive
+    if (!getStr(body, off, clientId)) { c.close(); return; }
+    if (flags & 0x04) { getStr(body, off, willTopic); getStr(body, off, willMsg); }
+    if (flags & 0x80) getStr(body, off, user);
+    if (flags & 0x40) getStr(body, off, pass);
+
+    uint8_t rc = connackCode;
+    if (rc == 0 && !requiredUser.empty() && user != requiredUser) rc = 4;   // bad credentials
+    if (rc != 0) {
+      sendPacket(c, 0x20, std::string("\x00", 1) + (char)rc);
+      c.close();
+      return;
+    }
+
+    // el mismo clientId en otra conexión: la vieja se corta
+    auto it = _sessions.find(clientId);
+    if (it != _sessions.end() && it->second.conn && it->second.conn.get() != &c) {
+      it->second.conn->close();
+      it->second.conn.reset();
+    }
+
+    bool clean = (flags & 0x02) != 0;
+    bool present = !clean && it != _sessions.end();
+    if (clean) _sessions.erase(clientId);
+
+    Session& s = _sessions[clientId];
+    s.clean = clean;
+    s.conn = l.conn;
+    l.clientId = clientId;
+    connects++;
+
+    sendPacket(c, 0x20, std::string(1, present ? 1 : 0) + std::string("\x00", 1));
+
+    std::vector<Message> pending;
+    pending.swap(s.pending);
+    for (const Message& m : pending) deliver(c, m);
+    return;
+  }
+
+  if (l.clientId.empty()) {   // nada antes del CONNECT
+    c.close();
+    return;
+  }
+  Session& s = _sessions[l.clientId];
+
+  switch (type) {
+    case 0x30: {   // PUBLISH
+      uint8_t qos = (hdr >> 1) & 0x03;
+      size_t off = 0;
+      Message m;
+      if (!getStr(body, off, m.topic)) return;
+      uint16_t msgId = 0;
+      if (qos > 0) {
+        if (off + 2 > body.size()) return;
+        msgId = (uint16_t)(((uint8_t)body[off] << 8) | (uint8_t)body[off + 1]);
+        off += 2;
+      }
+      m.clientId = l.clientId;
+      m.payload = body.substr(off);
+      m.qos = qos;
+      m.retain = (hdr & 0x01) != 0;
+      published.push_back(m);
+      if (qos == 1) sendPacket(c, 0x40, std::string() + (char)(msgId >> 8) + (char)(msgId & 0xFF));
+      break;
+    }
+
+    case 0x40:   // PUBACK
+      pubacks++;
+      break;
+
+    case 0x80: {   // SUBSCRIBE
+      if (body.size() < 2) return;
+      std::string ack = body.substr(0, 2);
+      size_t off = 2;
+      std::string topic;
+      while (off < body.size() && getStr(body, off, topic) && off < body.size()) {
+        uint8_t q = (uint8_t)body[off++] & 0x03;
+        if (q > 1) q = 1;
+        s.subs[topic] = q;
+        ack += (char)q;
+      }
+      sendPacket(c, 0x90, ack);
+      break;
+    }
+
+    case 0xC0:   // PINGREQ
+      sendPacket(c, 0xD0, "");
+      break;
+
+    case 0xE0:   // DISCONNECT
+      c.close();
+      detach(l.clientId);
+      break;
+
+    default:
+      break;
+  }
+}
+
+void MqttBrokerFake::deliver(LoopbackConn& c, const Message& m) {
+  std::string body;
+  body += (char)(m.topic.size() >> 8);
+  body += (char)(m.topic.size() & 0xFF);
+  body += m.topic;
+  if (m.qos > 0) {
+    if (++_nextMsgId == 0) _nextMsgId = 1;
+    body += (char)(_nextMsgId >> 8);
+    body += (char)(_nextMsgId & 0xFF);
+  }
+  body += m.payload;
+  sendPacket(c, (uint8_t)(0x30 | (m.qos << 1)), body);
+}
+
+size_t MqttBrokerFake::publish(const std::string& topic, const uint8_t* payload, size_t len, uint8_t qos) {
+  size_t n = 0;
+  for (auto& kv : _sessions) {
+    Session& s = kv.second;
+    auto sub = s.subs.find(topic);
+    if (sub == s.subs.end()) continue;
+
+    Message m{ "", topic, std::string((const char*)payload, len), (uint8_t)(qos < sub->second ? qos : sub->second), false };
+    if (s.conn && s.conn->open) {
+      deliver(*s.conn, m);
+      n++;
+    } else if (!s.clean && m.qos == 1) {
+      s.pending.push_back(m);
+      n++;
+    }
+  }
+  return n;
+}
+
+// La conexión del cliente se fue: una sesión limpia se olvida
+void MqttBrokerFake::detach(const std::string& clientId) {
+  auto it = _sessions.find(clientId);
+  if (it == _sessions.end()) return;
+  it->second.conn.reset();
+  if (it->second.clean) _sessions.erase(it);
+}
+
+void MqttBrokerFake::onClose(LoopbackConn& c) {
+  for (size_t i = 0; i < _links.size(); i++) {
+    if (_links[i].conn.get() != &c) continue;
+    std::string id = _links[i].clientId;
+    _links.erase(_links.begin() + i);
+    if (!id.empty()) detach(id);
+    return;
+  }
+}
+
+void MqttBrokerFake::dropAll() {
+  std::vector<Link> links;
+  links.swap(_links);
+  for (Link& l : links) {
+    l.conn->close();
+    if (!l.clientId.empty()) detach(l.clientId);
+  }
+}
+
+bool MqttBrokerFake::isOnline(const std::string& clientId) const {
+  auto it = _sessions.find(clientId);
+  return it != _sessions.end() && it->second.conn && it->second.conn->open;
+}
+
+bool MqttBrokerFake::isSubscribed(const std::string& topic) const {
+  for (const auto& kv : _sessions) {
+    if (kv.second.subs.count(topic)) return true;
+  }
+  return false;
+}
+
+size_t MqttBrokerFake::countOn(const std::string& topic) const {
+  size_t n = 0;
+  for (const Message& m : published) {
+    if (m.topic == topic) n++;
+  }
+  return n;
+}
+
+const MqttBrokerFake::Message* MqttBrokerFake::lastOn(const std::string& topic) const {
+  for (size_t i = published.size(); i > 0; i--) {
+    if (published[i - 1].topic == topic) return &published[i - 1];
+  }
+  return nullptr;
+}
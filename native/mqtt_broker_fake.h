@@ -0,0 +1,73 @@
+#pragma once
+#include "loopback.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// Broker MQTT 3.1.1 en proceso (sobre loopback.h) para los tests:
+// CONNECT/CONNACK, SUBSCRIBE, PUBLISH QoS 0/1 en ambos sentidos, PING y
+// sesiones persistentes (cleanSession=false: las suscripciones y los
+// mensajes QoS 1 esperan al cliente mientras está desconectado).
+// Los topics se comparan enteros (sin comodines).
+
+class MqttBrokerFake : public LoopbackServer {
+public:
+  struct Message {
+    std::string clientId;
+    std::string topic;
+    std::string payload;
+    uint8_t qos;
+    bool retain;
+  };
+
+  bool up = true;              // false: rechaza conexiones nuevas
+  unsigned long downUntilMs = 0;   // rechaza también mientras millis() < esto
+  uint8_t connackCode = 0;     // != 0: rechaza el CONNECT con ese código
+  std::string requiredUser;    // vacío = cualquier usuario
+
+  uint32_t connects = 0;       // CONNECT aceptados
+  std::vector<unsigned long> attemptsMs;   // millis() de cada conexión TCP (aceptada o no)
+  std::vector<Message> published;          // lo que publicaron los clientes
+  uint32_t pubacks = 0;        // PUBACK recibidos por lo que mandó el broker
+
+  // Manda a los suscritos (o lo guarda para sesiones persistentes
+  // desconectadas, si qos = 1); devuelve a cuántas sesiones fue
+  size_t publish(const std::string& topic, const uint8_t* payload, size_t len, uint8_t qos = 0);
+  size_t publish(const std::string& topic, const std::string& payload, uint8_t qos = 0) {
+    return publish(topic, (const uint8_t*)payload.data(), payload.size(), qos);
+  }
+
+  // El broker se cae: corta todas las conexiones (sin DISCONNECT)
+  void dropAll();
+
+  bool isOnline(const std::string& clientId) const;
+  bool isSubscribed(const std::string& topic) const;   // alguna sesión
+  size_t countOn(const std::string& topic) const;
+  const Message* lastOn(const std::string& topic) const;
+
+  bool accept(const std::shared_ptr<LoopbackConn>& c) override;
+  void onData(LoopbackConn& c) override;
+  void onClose(LoopbackConn& c) override;
+
+private:
+  struct Session {
+    std::map<std::string, uint8_t> subs;
+    std::vector<Message> pending;   // QoS 1 para cuando vuelva
+    bool clean = true;
+    std::shared_ptr<LoopbackConn> conn;   // nullptr = desconectado
+  };
+
+  struct Link {
+    std::shared_ptr<LoopbackConn> conn;
+    std::string clientId;   // vacío hasta el CONNECT
+  };
+
+  Link* findLink(LoopbackConn& c);
+  void handle(Link& l, uint8_t hdr, const std::string& body);
+  void deliver(LoopbackConn& c, const Message& m);
+  void detach(const std::string& clientId);
+
+  std::vector<Link> _links;
+  std::map<std::string, Session> _sessions;
+  uint16_t _nextMsgId = 0;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <Arduino.h>
+#include <string>
+
+// Controles del build nativo para tests y simulaciones: reloj, WiFi
+// falso, GPIO, NVS, watchdog y BLE. Lo implementan native/*.cpp y
+// hal_native.cpp; el firmware no lo incluye nunca.
+
+// ======================
+// Reloj
+// ======================
+enum SimClock : uint8_t {
+  SIM_CLOCK_REAL = 0,   // millis()/micros() = reloj del sistema (benchmarks)
+  SIM_CLOCK_MANUAL,     // solo avanza con sim_advanceMs(), delay() y esperas del loop
+};
+
+void sim_setClock(SimClock mode);
+bool sim_clockManual();
+void sim_advanceMs(uint32_t ms);
+// Tiempo gastado en delay()/delayMicroseconds() desde el arranque: lo que
+// el código bloqueó a propósito (las esperas del event group no cuentan)
+uint64_t sim_blockedUs();
+// Lo llaman las esperas con reloj simulado en cada ms: hal_native.cpp
+// dispara ahí los eventos WiFi/SNTP que vencieron
+void native_simTick();
+
+// stdout del Serial (los tests largos lo silencian)
+void sim_serialMute(bool mute);
+
+// Semilla del RNG de hal_random() (por defecto fija: runs reproducibles)
+void sim_seed(uint32_t seed);
+
+// ======================
+// Hardware falso (hal_native.cpp)
+// ======================
+int sim_gpioLevel(uint8_t pin);        // -1 si nunca se escribió
+uint32_t sim_gpioWrites();
+
+// Watchdog: vencido si pasó más que el timeout desde el último feed
+bool sim_wdtExpired();
+uint32_t sim_wdtFeeds();
+
+bool sim_restartRequested();
+
+// NVS: namespace "nebadon" salvo que se diga otro
+void sim_kvPutString(const char* ns, const char* key, const char* value);
+uint32_t sim_kvWrites();
+
+// ======================
+// WiFi falso
+// ======================
+// Un AP por SSID; la contraseña decide CONNECT_FAILED. Conectar tarda
+// connectMs (escaneo + DHCP) o directMs (BSSID/canal en caché).
+void sim_wifiAddAp(const char* ssid, const char* pass, int8_t rssi, uint8_t channel);
+void sim_wifiSetApUp(const char* ssid, bool up);
+void sim_wifiSetConnectMs(uint32_t connectMs, uint32_t directMs);
+// El AP corta el enlace actual
+void sim_wifiDropLink();
+// SSID del enlace actual ("" sin enlace)
+const char* sim_wifiLinkSsid();
+uint32_t sim_wifiBegins();
+// Tras WiFi.begin() con enlace previo, WiFi.status() sigue diciendo
+// conectado un rato (la desconexión es asíncrona en el driver)
+void sim_wifiSetStaleMs(uint32_t ms);
+
+// Conexiones TLS (sobre loopback no hay cifrado: solo se cuentan).
+// Completas y reanudadas con la sesión guardada del slot.
+uint32_t sim_tlsHandshakes();
+uint32_t sim_tlsResumed();
+// El servidor olvida las sesiones que emitió: la próxima conexión es completa
+void sim_tlsDropSessions();
+
+// ======================
+// BLE falso (native/ble_native.cpp)
+// ======================
+void sim_bleConnect(bool connected);
+void sim_bleSetMtu(uint16_t mtu);    // 23 al conectar, como un peer que no negocia
+// Un write ATT de la app (mensaje o fragmento): se despacha en el próximo ble_loop()
+void sim_bleWrite(const uint8_t* data, size_t len);
+void sim_bleWrite(const char* msg);
+// Notificaciones enviadas (en orden, crudas); sim_bleClearNotifies() las vacía
+size_t sim_bleNotifyCount();
+const std::string& sim_bleNotify(size_t i);
+void sim_bleClearNotifies();
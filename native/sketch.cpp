@@ -0,0 +1,4 @@
+// sketch.cpp
+// driver.ino como unidad C++ del build nativo (el IDE de Arduino hace lo
+// mismo antes de compilar)
+#include "../driver.ino"
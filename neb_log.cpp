@@ -0,0 +1,73 @@
+#include "neb_log.h"
+#include <stdarg.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/ringbuf.h>
+
+#define NEBLOG_RING_SIZE   4096
+#define NEBLOG_LINE_MAX    192
+#define NEBLOG_TASK_STACK  3072
+
+static RingbufHandle_t g_ring = nullptr;
+static volatile uint32_t g_dropped = 0;
+
+// Baja prioridad: solo corre cuando el resto está ocioso
+static void neblog_task(void* arg) {
+  (void)arg;
+  uint32_t reportedDrops = 0;
+
+  for (;;) {
+    size_t n = 0;
+    uint8_t* chunk = (uint8_t*)xRingbufferReceiveUpTo(g_ring, &n, portMAX_DELAY, 256);
+    if (chunk) {
+      Serial.write(chunk, n);
+      vRingbufferReturnItem(g_ring, chunk);
+    }
+
+    uint32_t d = g_dropped;
+    if (d != reportedDrops) {
+      char msg[48];
+      int m = snprintf(msg, sizeof(msg), "[LOG] %lu mensajes descartados\n",
+                       (unsigned long)(d - reportedDrops));
+      Serial.write((const uint8_t*)msg, m);
+      reportedDrops = d;
+    }
+  }
+}
+
+void neblog_begin() {
+  if (g_ring) return;
+
+  g_ring = xRingbufferCreate(NEBLOG_RING_SIZE, RINGBUF_TYPE_BYTEBUF);
+  if (!g_ring) return;
+
+  xTaskCreate(neblog_task, "neblog", NEBLOG_TASK_STACK, nullptr, tskIDLE_PRIORITY + 1, nullptr);
+}
+
+void neblog_write(const char* fmt, ...) {
+  char line[NEBLOG_LINE_MAX];
+
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(line, sizeof(line) - 1, fmt, ap);
+  va_end(ap);
+
+  if (n < 0) return;
+  if (n > (int)sizeof(line) - 2) n = sizeof(line) - 2;  // truncado
+  line[n++] = '\n';
+
+  // Antes de neblog_begin(): directo a la UART (solo en el arranque)
+  if (!g_ring) {
+    Serial.write((const uint8_t*)line, n);
+    return;
+  }
+
+  // Sin espera: si no cabe, se descarta
+  if (xRingbufferSend(g_ring, line, n, 0) != pdTRUE) {
+    __atomic_fetch_add(&g_dropped, 1, __ATOMIC_RELAXED);
+  }
+}
+
+uint32_t neblog_dropped() {
+  return g_dropped;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <Arduino.h>
+
+// Logger asíncrono: formatea a un ring buffer y una tarea de baja
+// prioridad lo vacía a la UART, así un log nunca alarga un comando.
+// Si el buffer está lleno el mensaje se descarta (y se cuenta).
+//
+// Nivel en compilación: -DNEB_LOG_LEVEL=NEB_LOG_LEVEL_WARN (release)
+// elimina del binario los LOGI/LOGD, argumentos incluidos.
+
+#define NEB_LOG_LEVEL_NONE  0
+#define NEB_LOG_LEVEL_ERROR 1
+#define NEB_LOG_LEVEL_WARN  2
+#define NEB_LOG_LEVEL_INFO  3
+#define NEB_LOG_LEVEL_DEBUG 4
+
+#ifndef NEB_LOG_LEVEL
+  #define NEB_LOG_LEVEL NEB_LOG_LEVEL_INFO
+#endif
+
+// Crea el ring buffer y la tarea de drenaje (llamar tras Serial.begin)
+void neblog_begin();
+
+void neblog_write(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Mensajes perdidos por buffer lleno desde el arranque
+uint32_t neblog_dropped();
+
+#if NEB_LOG_LEVEL >= NEB_LOG_LEVEL_ERROR
+  #define LOGE(fmt, ...) neblog_write(fmt, ##__VA_ARGS__)
+#else
+  #define LOGE(fmt, ...) do {} while (0)
+#endif
+
+#if NEB_LOG_LEVEL >= NEB_LOG_LEVEL_WARN
+  #define LOGW(fmt, ...) neblog_write(fmt, ##__VA_ARGS__)
+#else
+  #define LOGW(fmt, ...) do {} while (0)
+#endif
+
+#if NEB_LOG_LEVEL >= NEB_LOG_LEVEL_INFO
+  #define LOGI(fmt, ...) neblog_write(fmt, ##__VA_ARGS__)
+#else
+  #define LOGI(fmt, ...) do {} while (0)
+#endif
+
+#if NEB_LOG_LEVEL >= NEB_LOG_LEVEL_DEBUG
+  #define LOGD(fmt, ...) neblog_write(fmt, ##__VA_ARGS__)
+#else
+  #define LOGD(fmt, ...) do {} while (0)
+#endif
@@ -0,0 +1,88 @@
+// net_supervisor.cpp
+// Backoff + jitter + circuito por etapa (ver net_supervisor.h)
+
+#include "net_supervisor.h"
+#include "neb_log.h"
+#include "hal.h"
+
+struct SupPolicy {
+  const char* name;
+  uint32_t baseMs;
+  uint32_t capMs;
+  uint16_t breakAfter;   // fallos seguidos que abren el circuito (0 = nunca)
+  uint32_t openMs;       // tiempo abierto antes del intento half-open
+};
+
+static const SupPolicy POLICIES[SUP_STAGE_COUNT] = {
+  { "wifi",      1000,  60000UL, 0, 0 },
+  { "bootstrap", 2000, 300000UL, 5, 600000UL },
+  { "mqtt",      1000, 120000UL, 0, 0 },
+};
+
+struct SupState {
+  unsigned long nextMs;
+  uint32_t sleepMs;
+  uint16_t fails;
+  bool open;
+};
+
+static SupState _sup[SUP_STAGE_COUNT];
+
+// azar uniforme en [lo, hi]
+static uint32_t randBetween(uint32_t lo, uint32_t hi) {
+  if (hi <= lo) return lo;
+  return lo + hal_random() % (hi - lo + 1);
+}
+
+void sup_arm(SupStage s, unsigned long now) {
+  SupState& st = _sup[s];
+  if (st.open) return;   // el circuito manda
+  st.nextMs = now + randBetween(0, POLICIES[s].baseMs - 1);
+}
+
+bool sup_due(SupStage s, unsigned long now) {
+  return (long)(now - _sup[s].nextMs) >= 0;
+}
+
+void sup_fail(SupStage s, unsigned long now) {
+  const SupPolicy& p = POLICIES[s];
+  SupState& st = _sup[s];
+
+  if (st.fails < 0xFFFF) st.fails++;
+
+  if (p.breakAfter && st.fails >= p.breakAfter) {
+    if (!st.open) LOGW("⛔ %s: circuito abierto tras %u fallos", p.name, (unsigned)st.fails);
+    st.open = true;
+    st.nextMs = now + p.openMs + randBetween(0, p.openMs / 4);
+    return;
+  }
+
+  uint32_t prev = st.sleepMs ? st.sleepMs : p.baseMs;
+  uint32_t hi = prev > p.capMs / 3 ? p.capMs : prev * 3;
+  st.sleepMs = randBetween(p.baseMs, hi);
+  if (st.sleepMs > p.capMs) st.sleepMs = p.capMs;
+  st.nextMs = now + st.sleepMs;
+
+  LOGI("⏳ %s: fallo %u, reintento en %lu ms", p.name, (unsigned)st.fails, (unsigned long)st.sleepMs);
+}
+
+void sup_ok(SupStage s) {
+  SupState& st = _sup[s];
+  if (st.open) LOGI("✅ %s: circuito cerrado", POLICIES[s].name);
+  st.fails = 0;
+  st.sleepMs = 0;
+  st.open = false;
+}
+
+uint32_t sup_remaining(SupStage s, unsigned long now) {
+  long d = (long)(_sup[s].nextMs - now);
+  return d > 0 ? (uint32_t)d : 0;
+}
+
+bool sup_circuitOpen(SupStage s) {
+  return _sup[s].open;
+}
+
+uint16_t sup_failures(SupStage s) {
+  return _sup[s].fails;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+
+// Supervisor de reconexión: un solo sitio decide cuándo reintentar WiFi,
+// bootstrap y MQTT. Backoff exponencial con jitter decorrelacionado
+// (espera = min(cap, azar(base, espera_anterior * 3))), que vuelve a la
+// base al primer éxito, y circuito abierto tras fallos seguidos donde la
+// etapa lo pide (bootstrap). Así una flota que pierde el AP o el broker
+// a la vez no vuelve a entrar en bloque.
+
+enum SupStage : uint8_t {
+  SUP_WIFI = 0,
+  SUP_BOOTSTRAP,
+  SUP_MQTT,
+  SUP_STAGE_COUNT
+};
+
+// La etapa previa acaba de quedar lista: primer intento en [0, base)
+void sup_arm(SupStage s, unsigned long now);
+
+// ¿Toca intentar? (con el circuito abierto, solo al vencer: half-open)
+bool sup_due(SupStage s, unsigned long now);
+
+void sup_fail(SupStage s, unsigned long now);
+void sup_ok(SupStage s);
+
+// ms hasta el próximo intento (0 = ya)
+uint32_t sup_remaining(SupStage s, unsigned long now);
+
+bool sup_circuitOpen(SupStage s);
+uint16_t sup_failures(SupStage s);
@@ -3,17 +3,26 @@
 
 #include <Arduino.h>
 #include "net_wifi_mqtt.h"
+#include "json_scan.h"
+#include "cbor_lite.h"
+#include "vpin_registry.h"
+#include "neb_log.h"
+#include "latency.h"
+#include "loop_prof.h"
+#include "loop_wake.h"
+#include "net_supervisor.h"
+#include "config_store.h"
+#include "hal.h"
 
-#include <WiFi.h>
-#include <WiFiClient.h>
-#include <WiFiClientSecure.h>
 #include <PubSubClient.h>
-#include <HTTPClient.h>
-#include <ArduinoJson.h>
-#include <time.h>
-#include <math.h>
-#include "esp_mac.h"
-#include <Preferences.h>
+
+#if defined(NET_BENCH_ARDUINOJSON)
+  #include <ArduinoJson.h>   // solo el caso de referencia del bench
+  #include <math.h>
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 // =======================
 // Globals
@@ -21,329 +30,1461 @@
 static NetConfig _cfg{};
 static MqttCmdHandler _onCmd = nullptr;
 static PublishAllFn _publishAllFn = nullptr;
+static NetProgressFn _progressFn = nullptr;
 
 static String _deviceId = "";
-static String topicPub;
-static String topicSub;
-
-static WiFiClient tcpClient;
-static WiFiClientSecure tlsClient;
-
-static PubSubClient mqttTcp(tcpClient);
-static PubSubClient mqttTls(tlsClient);
-static PubSubClient* mqtt = &mqttTcp;
+static bool _deviceIdFromCache = false;
+// Topics en buffers fijos: se renderizan una vez por device_id
+// (configureMqttAndTopics) y publicar no toca el heap.
+// Payload binario (CBOR, ver "Formato binario" más abajo): mismos topics
+// con sufijo /cbor. Los cmds se decodifican según el topic en que llegan;
+// el estado sale en CBOR si el bootstrap lo negoció.
+#define TOPIC_CBOR_SUFFIX "/cbor"
+#define TOPIC_MAX 128
+
+enum NetTopic : uint8_t {
+  TOPIC_PUB = 0,        // .../dt
+  TOPIC_PUB_CBOR,
+  TOPIC_SUB,            // .../cmd
+  TOPIC_SUB_CBOR,
+  TOPIC_METRICS,        // hermano de TOPIC_PUB: .../metrics
+  TOPIC_ACK,            // .../ack: confirmación de cmds con cmd_id
+  TOPIC_ACK_CBOR,
+  TOPIC_COUNT
+};
+
+static char _topics[TOPIC_COUNT][TOPIC_MAX];
+static bool _payloadCbor = false;
+
+static void clearTopics() {
+  for (uint8_t t = 0; t < TOPIC_COUNT; t++) _topics[t][0] = '\0';
+}
 
-static WiFiClient httpClient;
-static WiFiClientSecure httpsClient;
+// Un solo PubSubClient; el socket (TCP o TLS) lo da hal_netClient()
+static PubSubClient mqttClient;
+static PubSubClient* mqtt = &mqttClient;
+static bool _mqttUseTls = false;
 
-static unsigned long lastWifiReconnectAttemptMs = 0;
-static unsigned long lastBootstrapAttemptMs = 0;
-static unsigned long lastMqttReconnectAttemptMs = 0;
+static bool _mqttWasConnected = false;
 
-static String _wifiSsid = "";
-static String _wifiPass = "";
+static void netProgress(NetProgress p) {
+  if (_progressFn) _progressFn(p);
+}
 
 // =======================
-// NVS WiFi
+// device_id en caché (config_store)
+// Válido solo para la misma clave (tenant/project/profile/MAC);
+// si cambia alguno, se re-bootstrapea.
 // =======================
-static Preferences _prefs;
-static const char* PREF_NS = "nebadon";
-static const char* PREF_SSID = "ssid";
-static const char* PREF_PASS = "pass";
-
-static bool nvs_loadWifi(String &ssid, String &pass) {
-  _prefs.begin(PREF_NS, true);
-  ssid = _prefs.getString(PREF_SSID, "");
-  pass = _prefs.getString(PREF_PASS, "");
-  _prefs.end();
-  return ssid.length() > 0;
+static bool cachedDeviceIdFor(const String &key, String &idOut) {
+  idOut = "";
+  if (key != cfg_getStr(CFG_DEV_KEY)) return false;
+  idOut = cfg_getStr(CFG_DEV_ID);
+  return idOut.length() > 0;
 }
 
-static bool nvs_saveWifi(const String &ssid, const String &pass) {
-  if (ssid.length() == 0) return false;
-  _prefs.begin(PREF_NS, false);
-  _prefs.putString(PREF_SSID, ssid);
-  _prefs.putString(PREF_PASS, pass);
-  _prefs.end();
-  return true;
+static void cacheDeviceId(const String &key, const String &id) {
+  cfg_setStr(CFG_DEV_KEY, key.c_str());
+  cfg_setStr(CFG_DEV_ID, id.c_str());
 }
 
-// (si luego expones clear al header)
-static void nvs_clearWifi() {
-  _prefs.begin(PREF_NS, false);
-  _prefs.remove(PREF_SSID);
-  _prefs.remove(PREF_PASS);
-  _prefs.end();
+static void clearCachedDeviceId() {
+  cfg_setStr(CFG_DEV_KEY, "");
+  cfg_setStr(CFG_DEV_ID, "");
 }
 
 // =======================
-// Helpers: MAC / CHIP
+// Helpers: MAC
 // =======================
 static String getMacAddress() {
   uint8_t mac[6];
-  esp_read_mac(mac, ESP_MAC_WIFI_STA);
+  hal_readMac(mac);
   char buf[18];
   snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X",
            mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
   return String(buf);
 }
 
-static String getChipModel() {
-#if defined(CONFIG_IDF_TARGET_ESP32C6)
-  return "ESP32-C6";
-#elif defined(CONFIG_IDF_TARGET_ESP32S3)
-  return "ESP32-S3";
-#elif defined(CONFIG_IDF_TARGET_ESP32)
-  return "ESP32";
-#else
-  return "ESP32-UNKNOWN";
-#endif
+// Clave de caché del device_id: FNV-1a sobre tenant|project|profile|MAC
+static String getDeviceCacheKey() {
+  String src = String(_cfg.tenant_id ? _cfg.tenant_id : "") + "|" +
+               (_cfg.project_id ? _cfg.project_id : "") + "|" +
+               (_cfg.profile_id ? _cfg.profile_id : "") + "|" +
+               getMacAddress();
+
+  uint32_t h = 2166136261u;
+  for (unsigned i = 0; i < src.length(); i++) {
+    h ^= (uint8_t)src[i];
+    h *= 16777619u;
+  }
+
+  char buf[9];
+  snprintf(buf, sizeof(buf), "%08lx", (unsigned long)h);
+  return String(buf);
 }
 
 // =======================
-// WiFi
+// WiFi (máquina de estados, no bloquea)
+// IDLE -> [SCANNING] -> CONNECTING -> GOT_IP, o FAILED cuando fallan
+// todas las redes guardadas. net_loop() la avanza con un hal_wifiStatus()
+// por pasada.
 // =======================
-static bool setupWiFiWithCreds(const String& ssid, const String& pass, uint32_t timeoutMs) {
-  if (ssid.length() == 0) {
-    Serial.println("⚠️ setupWiFi: SSID vacío (esperando provisioning BLE)");
-    return false;
+enum WifiState : uint8_t {
+  WIFI_ST_IDLE = 0,
+  WIFI_ST_SCANNING,     // un escaneo async para ordenar las redes por RSSI
+  WIFI_ST_CONNECTING,
+  WIFI_ST_GOT_IP,
+  WIFI_ST_FAILED,
+};
+
+static const uint32_t WIFI_CONNECT_TIMEOUT_MS = 12000;
+static const uint32_t WIFI_DIRECT_TIMEOUT_MS  = 4000;    // luego, escaneo completo
+static const uint32_t WIFI_SCAN_TIMEOUT_MS    = 10000;
+static const uint32_t WIFI_SCAN_FRESH_MS      = 30000;   // se reusa sin re-escanear
+static const uint32_t WIFI_FAIL_MEMORY_MS     = 600000;  // red que falló: al final 10 min
+
+static NetWifiPath _wifiPath = NET_WIFI_FULL;
+static NetWifiStats _wifiStats;
+
+static WifiState _wifiState = WIFI_ST_IDLE;
+static unsigned long _wifiStateSinceMs = 0;
+
+// Generación de intento: cada hal_wifiBegin*() la sube y el evento GOT_IP
+// copia la vigente. Tras re-provisionar, el driver sigue dando CONNECTED
+// con el AP viejo hasta procesar la baja: sin IP de este intento,
+// CONNECTED no cuenta.
+static uint32_t _wifiGen = 0;
+static volatile uint32_t _wifiIpGen = 0;
+
+// -----------------------
+// Redes conocidas (la 0 es la preferida). Las "saved" se reflejan en
+// config_store en el mismo orden; las del firmware o con persist=false
+// viven solo en RAM.
+// -----------------------
+#define NET_WIFI_MAX NET_WIFI_LIST_MAX
+static_assert(NET_WIFI_MAX <= CFG_WIFI_SLOTS, "cada red necesita su slot en config_store");
+
+struct WifiNet {
+  char ssid[33];
+  char pass[65];
+  bool saved;
+  uint8_t fails;               // fallos seguidos
+  unsigned long lastFailMs;
+};
+
+static WifiNet _nets[NET_WIFI_MAX];
+static uint8_t _netCount = 0;
+
+// Orden de intento de la ronda actual (índices a _nets)
+static uint8_t _order[NET_WIFI_MAX];
+static uint8_t _orderLen = 0;
+static uint8_t _orderPos = 0;
+static int8_t _netCur = -1;
+
+// -----------------------
+// Último escaneo (también lo consume la app vía WIFI_SCAN)
+// -----------------------
+#define NET_SCAN_MAX 12
+
+static HalWifiScanEntry _scan[NET_SCAN_MAX];
+static uint8_t _scanCount = 0;
+static unsigned long _scanAtMs = 0;
+static bool _scanValid = false;
+static bool _scanRunning = false;
+static unsigned long _scanStartMs = 0;
+static bool _scanPending = false;   // pedido por la app mientras se conectaba
+static bool _scanNotify = false;    // avisar NET_PROGRESS_SCAN_DONE al terminar
+
+static const char* wifiStateName(WifiState s) {
+  switch (s) {
+    case WIFI_ST_IDLE:       return "IDLE";
+    case WIFI_ST_SCANNING:   return "SCANNING";
+    case WIFI_ST_CONNECTING: return "CONNECTING";
+    case WIFI_ST_GOT_IP:     return "GOT_IP";
+    case WIFI_ST_FAILED:     return "FAILED";
   }
+  return "?";
+}
 
-  Serial.print("📶 Conectando a WiFi: ");
-  Serial.println(ssid);
+static void wifiSetState(WifiState s, unsigned long now) {
+  if (s == _wifiState) return;
+  LOGI("📶 WiFi %s -> %s", wifiStateName(_wifiState), wifiStateName(s));
+  _wifiState = s;
+  _wifiStateSinceMs = now;
+}
 
-  WiFi.mode(WIFI_STA);
+static int netFind(const char* ssid) {
+  for (uint8_t i = 0; i < _netCount; i++) {
+    if (strcmp(_nets[i].ssid, ssid) == 0) return i;
+  }
+  return -1;
+}
 
-  // Limpieza previa
-  WiFi.disconnect(true, true);
-  delay(200);
+static bool netSet(WifiNet& n, const char* ssid, const char* pass, bool saved) {
+  if (!pass) pass = "";
+  if (strlen(ssid) >= sizeof(n.ssid) || strlen(pass) >= sizeof(n.pass)) return false;
+  strcpy(n.ssid, ssid);
+  strcpy(n.pass, pass);
+  n.saved = saved;
+  n.fails = 0;
+  n.lastFailMs = 0;
+  return true;
+}
 
-  WiFi.begin(ssid.c_str(), pass.c_str());
+// Refleja las redes "saved" en los slots de config_store (sin cambios no
+// hay escritura)
+static void netsSave() {
+  uint8_t slot = 0;
+  for (uint8_t i = 0; i < _netCount && slot < CFG_WIFI_SLOTS; i++) {
+    if (!_nets[i].saved) continue;
+    cfg_setStr(cfg_wifiSsidKey(slot), _nets[i].ssid);
+    cfg_setStr(cfg_wifiPassKey(slot), _nets[i].pass);
+    slot++;
+  }
+  for (; slot < CFG_WIFI_SLOTS; slot++) {
+    cfg_setStr(cfg_wifiSsidKey(slot), "");
+    cfg_setStr(cfg_wifiPassKey(slot), "");
+  }
+}
 
-  unsigned long start = millis();
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(250);
-    Serial.print(".");
-    if (millis() - start > timeoutMs) {
-      Serial.println("\n❌ WiFi timeout.");
-      return false;
+static void netsLoad() {
+  _netCount = 0;
+  for (uint8_t slot = 0; slot < CFG_WIFI_SLOTS; slot++) {
+    const char* ssid = cfg_getStr(cfg_wifiSsidKey(slot));
+    if (ssid[0] == '\0' || netFind(ssid) >= 0) continue;
+    if (netSet(_nets[_netCount], ssid, cfg_getStr(cfg_wifiPassKey(slot)), true)) _netCount++;
+  }
+
+  if (_netCount > 0) {
+    LOGI("💾 WiFi: %u red(es) cargada(s) desde NVS.", (unsigned)_netCount);
+  } else if (_cfg.wifi_ssid && _cfg.wifi_ssid[0] != '\0' &&
+             netSet(_nets[0], _cfg.wifi_ssid, _cfg.wifi_pass, false)) {
+    _netCount = 1;
+    LOGI("ℹ️ WiFi usando credenciales del firmware (no hay NVS).");
+  }
+}
+
+// Inserta (o sube) la red al frente; si la lista está llena se cae la última
+static bool netUpsertFront(const char* ssid, const char* pass, bool saved) {
+  WifiNet n;
+  if (!netSet(n, ssid, pass, saved)) return false;
+
+  int at = netFind(ssid);
+  uint8_t last = (at >= 0) ? (uint8_t)at
+                           : (uint8_t)(_netCount < NET_WIFI_MAX ? _netCount++ : NET_WIFI_MAX - 1);
+  for (uint8_t i = last; i > 0; i--) _nets[i] = _nets[i - 1];
+  _nets[0] = n;
+  return true;
+}
+
+static const HalWifiScanEntry* scanFind(const char* ssid) {
+  const HalWifiScanEntry* best = nullptr;
+  for (uint8_t i = 0; i < _scanCount; i++) {
+    if (strcmp(_scan[i].ssid, ssid) != 0) continue;
+    if (!best || _scan[i].rssi > best->rssi) best = &_scan[i];
+  }
+  return best;
+}
+
+static bool scanFresh(unsigned long now) {
+  return _scanValid && now - _scanAtMs < WIFI_SCAN_FRESH_MS;
+}
+
+static bool netRecentlyFailed(const WifiNet& n, unsigned long now) {
+  return n.fails > 0 && now - n.lastFailMs < WIFI_FAIL_MEMORY_MS;
+}
+
+// Menor = antes: vistas en el escaneo (por RSSI), luego no vistas (en el
+// orden guardado), y al final las que fallaron hace poco (menos fallos antes)
+static int32_t netRank(uint8_t i, bool useScan, unsigned long now) {
+  const WifiNet& n = _nets[i];
+  const HalWifiScanEntry* seen = useScan ? scanFind(n.ssid) : nullptr;
+
+  int32_t r = seen ? -seen->rssi : 1000 + i;
+  if (netRecentlyFailed(n, now)) r += 10000 + n.fails * 2000;
+  return r;
+}
+
+// first >= 0: esa red va primero pase lo que pase (recién provisionada)
+static void wifiRank(unsigned long now, int first = -1) {
+  bool useScan = scanFresh(now);
+  int32_t rank[NET_WIFI_MAX];
+
+  _orderLen = 0;
+  for (uint8_t i = 0; i < _netCount; i++) {
+    int32_t r = (i == first) ? INT32_MIN : netRank(i, useScan, now);
+    uint8_t k = _orderLen++;
+    while (k > 0 && rank[k - 1] > r) {
+      rank[k] = rank[k - 1];
+      _order[k] = _order[k - 1];
+      k--;
     }
+    rank[k] = r;
+    _order[k] = i;
+  }
+  _orderPos = 0;
+}
+
+// -----------------------
+// Caché del último enlace bueno (config_store), ligada al SSID en que se
+// aprendió (CFG_WIFI_LINK_SSID)
+// -----------------------
+static bool wifiLinkCacheable(const WifiNet& n) {
+  return n.saved;
+}
+
+static bool wifiLinkLoad(const WifiNet& n, HalWifiLink& l) {
+  if (!wifiLinkCacheable(n) || strcmp(n.ssid, cfg_getStr(CFG_WIFI_LINK_SSID)) != 0) return false;
+
+  const char* hex = cfg_getStr(CFG_WIFI_BSSID);
+  if (strlen(hex) != 12) return false;
+  for (uint8_t i = 0; i < 6; i++) {
+    char byteHex[3] = { hex[i * 2], hex[i * 2 + 1], '\0' };
+    l.bssid[i] = (uint8_t)strtoul(byteHex, nullptr, 16);
   }
 
-  Serial.println("\n✅ WiFi conectado");
-  Serial.print("IP: ");
-  Serial.println(WiFi.localIP());
+  l.channel = (int32_t)cfg_getU32(CFG_WIFI_CH);
+  if (l.channel <= 0) return false;
+
+  l.ip      = _cfg.wifi_reuse_lease ? cfg_getU32(CFG_WIFI_IP) : 0;
+  l.gateway = cfg_getU32(CFG_WIFI_GW);
+  l.mask    = cfg_getU32(CFG_WIFI_MASK);
+  l.dns     = cfg_getU32(CFG_WIFI_DNS);
+  if (!l.gateway || !l.mask) l.ip = 0;   // concesión incompleta: solo BSSID/canal
+  return true;
+}
+
+// Sin cambios no hay escritura: config_store compara con lo guardado
+static void wifiLinkSave(const WifiNet& n) {
+  if (!wifiLinkCacheable(n)) return;
+
+  HalWifiLink l;
+  if (!hal_wifiGetLink(l)) return;
+
+  char hex[13];
+  snprintf(hex, sizeof(hex), "%02x%02x%02x%02x%02x%02x",
+           l.bssid[0], l.bssid[1], l.bssid[2], l.bssid[3], l.bssid[4], l.bssid[5]);
+  cfg_setStr(CFG_WIFI_LINK_SSID, n.ssid);
+  cfg_setStr(CFG_WIFI_BSSID, hex);
+  cfg_setU32(CFG_WIFI_CH, (uint32_t)l.channel);
+  cfg_setU32(CFG_WIFI_IP, l.ip);
+  cfg_setU32(CFG_WIFI_GW, l.gateway);
+  cfg_setU32(CFG_WIFI_MASK, l.mask);
+  cfg_setU32(CFG_WIFI_DNS, l.dns);
+}
+
+static void wifiLinkClear() {
+  cfg_setStr(CFG_WIFI_LINK_SSID, "");
+  cfg_setStr(CFG_WIFI_BSSID, "");
+  cfg_setU32(CFG_WIFI_CH, 0);
+  cfg_setU32(CFG_WIFI_IP, 0);
+}
+
+// Lanza la asociación a _nets[_netCur] y vuelve al instante; el resultado
+// lo recoge wifiPoll(). Con enlace en caché prueba primero la ruta directa;
+// si el escaneo reciente vio la red, va a su BSSID/canal sin re-escanear.
+static void wifiConnectCurrent(unsigned long now, bool allowDirect = true) {
+  const WifiNet& n = _nets[_netCur];
+  _wifiGen++;
+
+  HalWifiLink link;
+  const HalWifiScanEntry* seen;
+  if (allowDirect && wifiLinkLoad(n, link)) {
+    LOGI("📶 Conectando a WiFi: %s (directa, canal %ld%s)", n.ssid,
+         (long)link.channel, link.ip ? ", IP en caché" : "");
+    hal_wifiBeginDirect(n.ssid, n.pass, link);
+    _wifiPath = NET_WIFI_DIRECT;
+  } else if (scanFresh(now) && (seen = scanFind(n.ssid)) != nullptr) {
+    LOGI("📶 Conectando a WiFi: %s (RSSI %d, canal %u)", n.ssid, (int)seen->rssi, (unsigned)seen->channel);
+    memset(&link, 0, sizeof(link));
+    memcpy(link.bssid, seen->bssid, 6);
+    link.channel = seen->channel;
+    hal_wifiBeginDirect(n.ssid, n.pass, link);
+    _wifiPath = NET_WIFI_SCANNED;
+  } else {
+    LOGI("📶 Conectando a WiFi: %s", n.ssid);
+    hal_wifiBegin(n.ssid, n.pass);
+    _wifiPath = NET_WIFI_FULL;
+  }
+
+  // CONNECTING -> CONNECTING (reintento por escaneo) también reinicia el reloj
+  wifiSetState(WIFI_ST_CONNECTING, now);
+  _wifiStateSinceMs = now;
+}
+
+// Siguiente red de la ronda; false si ya no quedan
+static bool wifiConnectNext(unsigned long now) {
+  if (_orderPos >= _orderLen) return false;
+  _netCur = (int8_t)_order[_orderPos++];
+  wifiConnectCurrent(now);
   return true;
 }
 
+static bool scanStart(unsigned long now) {
+  if (_scanRunning) return true;
+  if (!hal_wifiScanStart()) {
+    LOGW("⚠️ WiFi: no se pudo iniciar el escaneo");
+    return false;
+  }
+  _scanRunning = true;
+  _scanStartMs = now;
+  return true;
+}
+
+// Nueva ronda: con varias redes, un escaneo (o el último si es reciente)
+// decide el orden; con una sola se conecta directo
+static bool wifiStartConnect(unsigned long now, int first = -1) {
+  _netCur = -1;
+  if (_netCount == 0) {
+    LOGW("⚠️ WiFi: sin redes guardadas (esperando provisioning BLE)");
+    wifiSetState(WIFI_ST_IDLE, now);
+    return false;
+  }
+
+  if (_netCount > 1 && first < 0 && !scanFresh(now) && scanStart(now)) {
+    wifiSetState(WIFI_ST_SCANNING, now);
+    return true;
+  }
+
+  wifiRank(now, first);
+  return wifiConnectNext(now);
+}
+
+// Recoge el escaneo en curso (de la ronda o pedido por la app)
+static void scanPoll(unsigned long now) {
+  if (!_scanRunning) return;
+
+  int n = hal_wifiScanPoll(_scan, NET_SCAN_MAX);
+  if (n == -1 && now - _scanStartMs < WIFI_SCAN_TIMEOUT_MS) return;
+
+  _scanRunning = false;
+  if (n >= 0) {
+    _scanCount = (uint8_t)n;
+    _scanAtMs = now;
+    _scanValid = true;
+    LOGI("📡 WiFi: escaneo listo en %lu ms (%d redes)", (unsigned long)(now - _scanStartMs), n);
+  } else {
+    LOGW("⚠️ WiFi: escaneo falló/timeout");
+  }
+
+  if (_scanNotify) {
+    _scanNotify = false;
+    netProgress(NET_PROGRESS_SCAN_DONE);
+  }
+
+  if (_wifiState == WIFI_ST_SCANNING) {
+    wifiRank(now);
+    wifiConnectNext(now);
+  }
+}
+
+// Falla la ruta directa: en la misma pasada, escaneo completo (no es un
+// fallo para el supervisor ni para la app)
+static bool wifiDirectFailed(unsigned long now) {
+  if (_wifiPath != NET_WIFI_DIRECT) return false;
+  _wifiStats.directFail++;
+  LOGW("⚠️ WiFi directa falló, escaneo completo");
+  wifiConnectCurrent(now, false);
+  return true;
+}
+
+// Falló la red actual: se recuerda y se pasa a la siguiente; solo cuando
+// falla la ronda entera cuenta para el supervisor y la app
+static void wifiNetFailed(unsigned long now) {
+  WifiNet& n = _nets[_netCur];
+  if (n.fails < 255) n.fails++;
+  n.lastFailMs = now;
+  _wifiStats.fullFail++;
+
+  if (wifiConnectNext(now)) return;
+
+  wifiSetState(WIFI_ST_FAILED, now);
+  sup_fail(SUP_WIFI, now);
+  netProgress(NET_PROGRESS_WIFI_FAIL);
+}
+
+static void onWifiGotIp();
+
+static void wifiPoll(unsigned long now) {
+  HalWifiStatus st = hal_wifiStatus();
+
+  scanPoll(now);
+
+  switch (_wifiState) {
+    case WIFI_ST_IDLE:
+      if (_netCount > 0) wifiStartConnect(now);
+      break;
+
+    case WIFI_ST_SCANNING:
+      break;
+
+    case WIFI_ST_CONNECTING: {
+      uint32_t timeout = _wifiPath == NET_WIFI_DIRECT ? WIFI_DIRECT_TIMEOUT_MS : WIFI_CONNECT_TIMEOUT_MS;
+      if (st == HAL_WIFI_CONNECTED && _wifiIpGen == _wifiGen) {
+        bool direct = (_wifiPath == NET_WIFI_DIRECT);
+        _wifiStats.lastMs = now - _wifiStateSinceMs;
+        _wifiStats.lastPath = _wifiPath;
+        if (direct) _wifiStats.directOk++;
+        else if (_wifiPath == NET_WIFI_SCANNED) _wifiStats.scannedOk++;
+        else _wifiStats.fullOk++;
+
+        WifiNet& n = _nets[_netCur];
+        n.fails = 0;
+        wifiSetState(WIFI_ST_GOT_IP, now);
+        LOGI("✅ WiFi conectado a %s en %lu ms (%s), IP: %s", n.ssid, (unsigned long)_wifiStats.lastMs,
+             direct ? "directa" : _wifiPath == NET_WIFI_SCANNED ? "dirigida" : "escaneo",
+             hal_wifiLocalIP().c_str());
+        if (!direct) wifiLinkSave(n);
+        onWifiGotIp();
+      } else if (st == HAL_WIFI_CONNECT_FAILED || st == HAL_WIFI_NO_SSID) {
+        if (wifiDirectFailed(now)) break;
+        LOGE("❌ WiFi %s falló status=%d", _nets[_netCur].ssid, (int)st);
+        wifiNetFailed(now);
+      } else if (now - _wifiStateSinceMs > timeout) {
+        if (wifiDirectFailed(now)) break;
+        LOGE("❌ WiFi %s timeout.", _nets[_netCur].ssid);
+        wifiNetFailed(now);
+      }
+      break;
+    }
+
+    case WIFI_ST_GOT_IP:
+      if (st != HAL_WIFI_CONNECTED) {
+        LOGW("⚠️ WiFi perdido.");
+        wifiSetState(WIFI_ST_FAILED, now);
+        // el AP se cayó para todos: primer reintento con jitter
+        sup_arm(SUP_WIFI, now);
+      }
+      break;
+
+    case WIFI_ST_FAILED:
+      if (sup_due(SUP_WIFI, now)) {
+        LOGI("🔁 Reintentando WiFi...");
+        wifiStartConnect(now);
+      }
+      break;
+  }
+
+  // escaneo de la app aplazado: no se interrumpe una asociación en curso
+  if (_scanPending && _wifiState != WIFI_ST_CONNECTING) {
+    _scanPending = false;
+    if (!scanStart(now)) {
+      _scanNotify = false;
+      netProgress(NET_PROGRESS_SCAN_DONE);
+    }
+  }
+
+  // los cambios de estado y el fin del escaneo llegan por onWifiEvent();
+  // aquí solo los timeouts
+  if (_wifiState == WIFI_ST_CONNECTING) {
+    uint32_t timeout = _wifiPath == NET_WIFI_DIRECT ? WIFI_DIRECT_TIMEOUT_MS : WIFI_CONNECT_TIMEOUT_MS;
+    wake_within(wake_remaining(_wifiStateSinceMs, timeout + 1, now));
+  } else if (_wifiState == WIFI_ST_FAILED) {
+    wake_within(sup_remaining(SUP_WIFI, now));
+  }
+  if (_scanRunning) wake_within(wake_remaining(_scanStartMs, WIFI_SCAN_TIMEOUT_MS + 1, now));
+}
+
+// Tarea de eventos WiFi: marca la IP del intento y despierta al loop
+static void onWifiEvent(HalWifiEvent ev) {
+  if (ev == HAL_WIFI_EV_GOT_IP) _wifiIpGen = _wifiGen;
+  else if (ev == HAL_WIFI_EV_DISCONNECTED) _wifiIpGen = 0;
+  wake_signal(WAKE_BIT_WIFI);
+}
+
+void net_getWifiStats(NetWifiStats& out) {
+  out = _wifiStats;
+}
+
 bool net_isWifiConnected() {
-  return WiFi.status() == WL_CONNECTED;
+  return hal_wifiStatus() == HAL_WIFI_CONNECTED;
+}
+
+void net_requestWifiScan() {
+  _scanNotify = true;
+  if (_scanRunning) return;
+  _scanPending = true;   // lo arranca wifiPoll() cuando no haya asociación en curso
+  wake_signal(WAKE_BIT_WIFI);
+}
+
+size_t net_getWifiScan(NetWifiScanEntry* out, size_t max, uint32_t& ageMs) {
+  ageMs = UINT32_MAX;
+  if (!_scanValid) return 0;
+  ageMs = millis() - _scanAtMs;
+
+  // una entrada por SSID (el mejor AP), ordenadas por RSSI
+  size_t n = 0;
+  for (uint8_t i = 0; i < _scanCount; i++) {
+    const HalWifiScanEntry& s = _scan[i];
+    if (scanFind(s.ssid) != &s) continue;
+
+    size_t k = n < max ? n++ : max;
+    while (k > 0 && out[k - 1].rssi < s.rssi) {
+      if (k < max) out[k] = out[k - 1];
+      k--;
+    }
+    if (k >= max) continue;
+
+    NetWifiScanEntry& e = out[k];
+    memcpy(e.ssid, s.ssid, sizeof(e.ssid));
+    e.rssi = s.rssi;
+    e.open = s.open;
+    e.known = netFind(s.ssid) >= 0;
+  }
+  return n;
 }
 
 // =======================
-// NTP (opcional)
+// NTP (asíncrono, no bloquea la cadena)
+// SNTP sincroniza en segundo plano; solo la validación de certificados TLS
+// espera a _timeValid. Tras reconectar no se re-sincroniza si la última
+// sincronización es reciente (deriva del RTC tolerable).
 // =======================
-static void setupTimeIfNeeded() {
+static const uint32_t NTP_RESYNC_MS  = 6UL * 3600UL * 1000UL;
+static const uint32_t NTP_WARN_MS    = 12000;
+
+static volatile bool _ntpSyncedFlag = false;  // lo pone el callback de SNTP
+static bool _timeValid = false;
+static bool _ntpPending = false;
+static unsigned long _ntpStartMs = 0;
+static unsigned long _lastNtpSyncMs = 0;
+static TimeValidFn _timeValidFn = nullptr;
+
+// Corre en la tarea de lwIP: solo marca, timePoll() hace el resto
+static void onSntpSync() {
+  _ntpSyncedFlag = true;
+  wake_signal(WAKE_BIT_TIME);
+}
+
+static void timeStartSyncIfNeeded() {
   if (!_cfg.use_ntp) return;
 
-  Serial.println("⏱ Configurando NTP...");
-  configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-
-  struct tm timeinfo;
-  Serial.print("Sincronizando hora");
-  unsigned long start = millis();
-  while (!getLocalTime(&timeinfo)) {
-    Serial.print(".");
-    delay(300);
-    if (millis() - start > 12000) {
-      Serial.println("\n⚠️ No se pudo sincronizar NTP (seguimos).");
-      return;
+  unsigned long now = millis();
+  if (_timeValid && now - _lastNtpSyncMs < NTP_RESYNC_MS) {
+    LOGI("⏱ Hora aún válida, no se re-sincroniza NTP.");
+    return;
+  }
+  if (_ntpPending) return;
+
+  LOGI("⏱ NTP en segundo plano...");
+  hal_timeSyncStart(onSntpSync);
+  _ntpPending = true;
+  _ntpStartMs = now;
+}
+
+static void timePoll(unsigned long now) {
+  if (_ntpSyncedFlag) {
+    _ntpSyncedFlag = false;
+    _ntpPending = false;
+    _lastNtpSyncMs = now;
+
+    if (!_timeValid) {
+      _timeValid = true;
+      LOGI("✅ Hora sincronizada");
+      // lo que esperaba la hora (TLS con validación) sigue en esta pasada
+      if (_timeValidFn) _timeValidFn();
     }
+    return;
+  }
+
+  if (_ntpPending && _ntpStartMs != 0 && now - _ntpStartMs > NTP_WARN_MS) {
+    // SNTP sigue reintentando solo; solo avisamos una vez
+    _ntpStartMs = 0;
+    LOGW("⚠️ NTP aún sin sincronizar (seguimos en segundo plano).");
+  }
+  if (_ntpPending && _ntpStartMs != 0) {
+    wake_within(wake_remaining(_ntpStartMs, NTP_WARN_MS + 1, now));
+  }
+}
+
+// true si la conexión TLS validará certificados y por tanto necesita hora
+static bool tlsNeedsTime() {
+  return _cfg.use_ntp && !_cfg.tls_insecure && !_timeValid;
+}
+
+// =======================
+// TLS: handshakes explícitos y medidos
+// El handshake se hace antes de entregar el socket a HTTPClient/PubSubClient
+// (ambos usan el cliente ya conectado), así se mide aislado del request.
+// Completos y reanudados (la HAL ofrece la sesión guardada) por separado;
+// un socket que sigue abierto no se cuenta: no hubo handshake.
+// Contadores en RTC para que sobrevivan a deep sleep.
+// =======================
+RTC_DATA_ATTR static NetTlsStats _tlsBootStats;
+RTC_DATA_ATTR static NetTlsStats _tlsMqttStats;
+
+static bool tlsConnectTimed(HalNetSlot slot, const char* host, uint16_t port,
+                            NetTlsStats& st) {
+  if (hal_netClient(slot).connected()) return true;
+
+  unsigned long t0 = millis();
+  bool ok = hal_netConnect(slot, host, port);
+  uint32_t dt = (uint32_t)(millis() - t0);
+
+  if (!ok) {
+    st.failed++;
+    LOGE("❌ TLS handshake falló con %s", host);
+    return false;
+  }
+
+  bool resumed = hal_netResumed(slot);
+  if (resumed) {
+    st.resumed++;
+    st.resumedMs += dt;
+  } else {
+    st.full++;
+    st.totalMs += dt;
+  }
+  st.lastMs = dt;
+  if (dt > st.maxMs) st.maxMs = dt;
+
+  LOGI("🔐 TLS %s %s %lu ms", resumed ? "reanudada" : "handshake", host, (unsigned long)dt);
+  return true;
+}
+
+// "https://host[:port]/..." -> host, port (443 por defecto)
+static bool parseHttpsHost(const String& url, String& hostOut, uint16_t& portOut) {
+  if (!url.startsWith("https://")) return false;
+  String rest = url.substring(8);
+
+  int slash = rest.indexOf('/');
+  if (slash >= 0) rest = rest.substring(0, slash);
+
+  int colon = rest.indexOf(':');
+  if (colon >= 0) {
+    hostOut = rest.substring(0, colon);
+    portOut = (uint16_t)rest.substring(colon + 1).toInt();
+  } else {
+    hostOut = rest;
+    portOut = 443;
   }
-  Serial.println("\n✅ Hora sincronizada");
+  return hostOut.length() > 0 && portOut != 0;
 }
 
 // =======================
 // Bootstrap
 // =======================
-static bool bootstrapDevice(String &device_uuid_out) {
-  device_uuid_out = "";
+// Cadena JSON escapada (null si no hay valor)
+static void jsonAppendStr(String& out, const char* s) {
+  if (!s) {
+    out += "null";
+    return;
+  }
+  out += '"';
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)*s;
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += (char)c;
+    } else if (c < 0x20) {
+      char esc[7];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      out += esc;
+    } else {
+      out += (char)c;
+    }
+  }
+  out += '"';
+}
 
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("❌ bootstrapDevice: WiFi no conectado");
+// {"ok":true,"device_id":"..","payload":"json"|"cbor"}
+struct BootResp {
+  bool ok;
+  JsonSpan deviceId;
+  JsonSpan payload;   // vacío = json
+};
+
+static bool onBootRespField(const JsonField& f, void* ctx) {
+  BootResp& r = *(BootResp*)ctx;
+  if (jscan_eq(f.key, "ok")) r.ok = (f.type == JSCAN_TRUE);
+  else if (jscan_eq(f.key, "device_id") && f.type == JSCAN_STRING) r.deviceId = f.val;
+  else if (jscan_eq(f.key, "payload") && f.type == JSCAN_STRING) r.payload = f.val;
+  return true;
+}
+
+// El handshake TLS y el POST bloquean (hasta ~7 s cada uno): corren en
+// una tarea aparte para que el loop siga con BLE, WiFi y el WDT. El loop
+// arma la petición (URL y cuerpo con la IP/RSSI del momento), la tarea
+// solo hace la E/S y net_loop() recoge el resultado.
+enum BootJobState : uint8_t {
+  BOOT_JOB_IDLE,
+  BOOT_JOB_RUNNING,
+  BOOT_JOB_DONE,
+};
+
+struct BootJob {
+  String url;
+  String body;
+  bool ok;
+  bool cbor;
+  char deviceId[65];
+};
+
+static BootJob _boot;
+static volatile BootJobState _bootState = BOOT_JOB_IDLE;
+
+#define BOOT_TASK_STACK 8192   // HTTPClient + handshake mbedTLS
+
+// En el loop: valida la config y arma URL y cuerpo
+static bool bootstrapPrepare() {
+  if (hal_wifiStatus() != HAL_WIFI_CONNECTED) {
+    LOGE("❌ bootstrapDevice: WiFi no conectado");
     return false;
   }
   if (!_cfg.api_base || !_cfg.bootstrap_path) {
-    Serial.println("❌ bootstrapDevice: api_base/bootstrap_path null");
+    LOGE("❌ bootstrapDevice: api_base/bootstrap_path null");
     return false;
   }
 
   String url = String(_cfg.api_base) + _cfg.bootstrap_path;
-  Serial.print("📨 BOOT url=");
-  Serial.println(url);
-
-  HTTPClient http;
-  http.setTimeout(7000);
-  http.setReuse(false);
-
-  bool begun = false;
-  if (url.startsWith("http://")) {
-    httpClient.setTimeout(7000);
-    begun = http.begin(httpClient, url);
-    if (!begun) {
-      Serial.println("❌ http.begin() falló (HTTP)");
-      return false;
-    }
-  } else if (url.startsWith("https://")) {
-    httpsClient.setTimeout(7000);
-    if (_cfg.tls_insecure) httpsClient.setInsecure();
-    begun = http.begin(httpsClient, url);
-    if (!begun) {
-      Serial.println("❌ https.begin() falló (HTTPS)");
-      return false;
-    }
-  } else {
-    Serial.println("❌ bootstrapDevice: URL inválida (sin http:// o https://)");
+  if (!url.startsWith("http://") && !url.startsWith("https://")) {
+    LOGE("❌ bootstrapDevice: URL inválida (sin http:// o https://)");
     return false;
   }
+  LOGI("📨 BOOT url=%s", url.c_str());
 
-  http.addHeader("Content-Type", "application/json");
-  if (_cfg.apikey && strlen(_cfg.apikey) > 0)        http.addHeader("x-api-key", _cfg.apikey);
-  if (_cfg.secretkey && strlen(_cfg.secretkey) > 0)  http.addHeader("x-api-secret", _cfg.secretkey);
+  // mismo cuerpo que daba ArduinoJson (null donde falta un valor)
+  String body;
+  body.reserve(384);
+  body += "{\"tenant_id\":";    jsonAppendStr(body, _cfg.tenant_id);
+  body += ",\"project_id\":";   jsonAppendStr(body, _cfg.project_id);
+  body += ",\"alias\":";        jsonAppendStr(body, _cfg.alias);
+  body += ",\"mac_address\":";  jsonAppendStr(body, getMacAddress().c_str());
+  body += ",\"chip_model\":";   jsonAppendStr(body, hal_chipModel());
+  body += ",\"fw_version\":\"1.0.0\"";
+  body += ",\"ip\":";           jsonAppendStr(body, hal_wifiLocalIP().c_str());
+  body += ",\"rssi\":";         body += String(hal_wifiRSSI());
+  body += ",\"profile_id\":";   jsonAppendStr(body, _cfg.profile_id);
+  body += ",\"payloads\":\"json,cbor\"}";   // la API elige con "payload" en la respuesta
+
+  _boot.url = url;
+  _boot.body = body;
+  _boot.ok = false;
+  _boot.cbor = false;
+  _boot.deviceId[0] = '\0';
+  return true;
+}
 
-  StaticJsonDocument<512> doc;
-  doc["tenant_id"]   = _cfg.tenant_id;
-  doc["project_id"]  = _cfg.project_id;
-  doc["alias"]       = _cfg.alias;
-  doc["mac_address"] = getMacAddress();
-  doc["chip_model"]  = getChipModel();
-  doc["fw_version"]  = "1.0.0";
-  doc["ip"]          = WiFi.localIP().toString();
-  doc["rssi"]        = WiFi.RSSI();
-  doc["profile_id"]  = _cfg.profile_id;
+// En la tarea: TLS + POST + parseo; solo toca _boot y el slot HTTP
+static void bootstrapRun(BootJob& job) {
+  const String& url = job.url;
 
-  String body;
-  serializeJson(doc, body);
+  if (url.startsWith("https://")) {
+    hal_netSetup(HAL_NET_HTTP, HalNetOpts{ true, _cfg.tls_insecure, 7000 });
 
-  int code = http.POST(body);
-  String resp = http.getString();
+    String host;
+    uint16_t port = 0;
+    if (!parseHttpsHost(url, host, port) ||
+        !tlsConnectTimed(HAL_NET_HTTP, host.c_str(), port, _tlsBootStats)) {
+      return;
+    }
+  } else {
+    hal_netSetup(HAL_NET_HTTP, HalNetOpts{ false, false, 7000 });
+  }
+
+  HalHttpHeader headers[3];
+  size_t nHeaders = 0;
+  headers[nHeaders++] = HalHttpHeader{ "Content-Type", "application/json" };
+  if (_cfg.apikey && strlen(_cfg.apikey) > 0)       headers[nHeaders++] = HalHttpHeader{ "x-api-key", _cfg.apikey };
+  if (_cfg.secretkey && strlen(_cfg.secretkey) > 0) headers[nHeaders++] = HalHttpHeader{ "x-api-secret", _cfg.secretkey };
+
+  String resp;
+  int code = hal_httpPost(url, headers, nHeaders, job.body, resp, 7000);
 
-  Serial.print("HTTP ");
-  Serial.println(code);
-  Serial.print("RESP: ");
-  Serial.println(resp);
+  LOGI("HTTP %d", code);
+  LOGD("RESP: %s", resp.c_str());
 
-  http.end();
+  // libera el contexto TLS (decenas de KB) en cuanto termina el bootstrap
+  hal_netStop(HAL_NET_HTTP);
 
   if (code < 200 || code >= 300) {
-    Serial.println("❌ bootstrapDevice: HTTP no-2xx");
-    return false;
+    LOGE("❌ bootstrapDevice: HTTP no-2xx");
+    return;
   }
 
-  StaticJsonDocument<768> rdoc;
-  DeserializationError err = deserializeJson(rdoc, resp);
-  if (err) {
-    Serial.print("❌ bootstrapDevice: JSON resp parse error: ");
-    Serial.println(err.c_str());
-    return false;
+  BootResp r;
+  memset(&r, 0, sizeof(r));
+  if (!jscan_object(resp.c_str(), resp.length(), onBootRespField, &r)) {
+    LOGE("❌ bootstrapDevice: JSON resp parse error");
+    return;
+  }
+
+  if (!r.ok || r.deviceId.len == 0 || !jscan_unescape(r.deviceId, job.deviceId, sizeof(job.deviceId))) {
+    LOGE("❌ bootstrapDevice: resp no trae ok/device_id válido");
+    return;
   }
 
-  bool ok = rdoc["ok"] | false;
-  const char* did = rdoc["device_id"] | "";
-  if (!ok || !did || strlen(did) == 0) {
-    Serial.println("❌ bootstrapDevice: resp no trae ok/device_id válido");
+  job.cbor = jscan_eq(r.payload, "cbor");
+  job.ok = true;
+}
+
+static void bootTask(void* arg) {
+  (void)arg;
+  bootstrapRun(_boot);
+  _bootState = BOOT_JOB_DONE;
+  wake_signal(WAKE_BIT_BOOT);
+  vTaskDelete(nullptr);
+}
+
+// La tarea vive lo que dura un intento: su pila no queda reservada
+static bool bootstrapStart() {
+  if (!bootstrapPrepare()) return false;
+
+  _bootState = BOOT_JOB_RUNNING;
+  if (xTaskCreate(bootTask, "bootstrap", BOOT_TASK_STACK, nullptr, 1, nullptr) != pdPASS) {
+    LOGE("❌ bootstrapDevice: sin memoria para la tarea");
+    _bootState = BOOT_JOB_IDLE;
     return false;
   }
+  return true;
+}
 
-  device_uuid_out = String(did);
-  Serial.print("✅ bootstrap OK device_id(UUID)=");
-  Serial.println(device_uuid_out);
+// =======================
+// Parser de comandos MQTT (sin heap)
+// Lee type/tenant_id/vpin|pin/value/cmd_id directo del buffer de PubSubClient.
+// =======================
+static JsonSpan _tenantSpan = { "", 0 };  // precalculado en net_begin()
+
+struct MqttCmd {
+  JsonSpan type;
+  JsonSpan tenant;
+  JsonSpan vpin;
+  JsonSpan pin;
+  JsonField value;
+  JsonSpan cmdId;   // string o número, crudo
+  bool cmdIdNum;    // cmd_id llegó como número: el ack lo devuelve igual
+};
+
+static bool onMqttCmdField(const JsonField& f, void* ctx) {
+  MqttCmd& c = *(MqttCmd*)ctx;
+  if (f.type == JSCAN_STRING) {
+    if (jscan_eq(f.key, "type"))           c.type = f.val;
+    else if (jscan_eq(f.key, "tenant_id")) c.tenant = f.val;
+    else if (jscan_eq(f.key, "vpin"))      c.vpin = f.val;
+    else if (jscan_eq(f.key, "pin"))       c.pin = f.val;
+  }
+  if (jscan_eq(f.key, "value")) c.value = f;
+  else if (jscan_eq(f.key, "cmd_id") && (f.type == JSCAN_STRING || f.type == JSCAN_NUMBER)) {
+    c.cmdId = f.val;
+    c.cmdIdNum = (f.type == JSCAN_NUMBER);
+  }
   return true;
 }
 
 // =======================
-// JSON helpers (MQTT)
+// Formato binario (CBOR) en topics .../cbor
+// Mapa con claves enteras; tenant/device/type los da el topic.
+//   cmd:   {1: vpin (n de "V<n>"), 2: value, 3?: cmd_id (texto o uint)}
+//   state: {1: vpin, 2: value}                       ~5 bytes vs ~150
+//   ack:   {3: cmd_id (como llegó), 4: ok, 5: dup, 6: us}
 // =======================
-static bool extractVpinAndValue(JsonDocument &doc, String &vpinOut, int &valueOut) {
-  const char* vpin = doc["vpin"] | doc["pin"];
-  if (!vpin || String(vpin).length() == 0) return false;
+enum CborKey : uint8_t {
+  CBK_VPIN = 1,
+  CBK_VALUE = 2,
+  CBK_CMD_ID = 3,
+  CBK_OK = 4,
+  CBK_DUP = 5,
+  CBK_US = 6,
+};
+
+struct CborCmd {
+  int32_t vpin;
+  bool hasValue;
+  int32_t value;
+  JsonSpan cmdId;
+  bool cmdIdIsNum;     // cmd_id uint: el ack lo devuelve como uint
+  uint32_t cmdIdU;
+  char cmdIdNum[11];   // cmd_id entero, como texto (dedup y logs)
+};
+
+static bool onCborCmdField(const CborField& f, void* ctx) {
+  CborCmd& c = *(CborCmd*)ctx;
+  bool isInt = (f.type == CBOR_UINT || f.type == CBOR_NEGINT || f.type == CBOR_BOOL);
+
+  if (f.key == CBK_VPIN && f.type == CBOR_UINT) {
+    c.vpin = f.i;
+  } else if (f.key == CBK_VALUE && isInt) {
+    c.value = f.i;
+    c.hasValue = true;
+  } else if (f.key == CBK_CMD_ID && f.type == CBOR_TEXT) {
+    c.cmdId = JsonSpan{ (const char*)f.p, f.len };
+  } else if (f.key == CBK_CMD_ID && f.type == CBOR_UINT) {
+    int n = snprintf(c.cmdIdNum, sizeof(c.cmdIdNum), "%lu", (unsigned long)f.i);
+    c.cmdId = JsonSpan{ c.cmdIdNum, (uint16_t)n };
+    c.cmdIdIsNum = true;
+    c.cmdIdU = (uint32_t)f.i;
+  }
+  return true;
+}
 
-  JsonVariant v = doc["value"];
-  if (v.isNull()) return false;
+static bool topicIsCbor(const char* topic) {
+  size_t n = strlen(topic);
+  size_t k = sizeof(TOPIC_CBOR_SUFFIX) - 1;
+  return n >= k && memcmp(topic + n - k, TOPIC_CBOR_SUFFIX, k) == 0;
+}
 
-  int valueInt = 0;
-  if (v.is<bool>()) valueInt = v.as<bool>() ? 1 : 0;
-  else if (v.is<long>() || v.is<int>()) valueInt = v.as<int>();
-  else if (v.is<float>() || v.is<double>()) valueInt = (int) lroundf(v.as<float>());
-  else if (v.is<const char*>()) valueInt = String(v.as<const char*>()).toInt();
-  else valueInt = v.as<int>();
+// cmd_id tal como llegó: texto o número (la nube compara por tipo)
+struct CmdId {
+  JsonSpan text;     // crudo (JSON) o decimal (CBOR uint)
+  bool isNum;
+  uint32_t num;      // solo CBOR
+};
 
-  vpinOut = String(vpin);
-  valueOut = valueInt;
-  return true;
+// =======================
+// Dedup de cmds por cmd_id
+// Con QoS 1 el broker (o un reintento de la nube) puede entregar el mismo
+// cmd más de una vez: los últimos CMD_DEDUP_LEN ids se recuerdan con su
+// resultado, y un repetido solo se vuelve a confirmar.
+// La clave es formato + tipo + bytes del id: "42" y 42, o el mismo id en
+// JSON y en CBOR, son cmds distintos. El hash FNV-1a solo descarta rápido;
+// un repetido se confirma comparando los bytes.
+// =======================
+#define CMD_DEDUP_LEN 32
+#define CMD_ID_MAX    64
+
+enum CmdIdKind : uint8_t {
+  CMD_ID_NONE = 0,     // entrada libre
+  CMD_ID_JSON_TEXT,
+  CMD_ID_JSON_NUM,
+  CMD_ID_CBOR_TEXT,
+  CMD_ID_CBOR_NUM,
+};
+
+struct CmdSeen {
+  uint32_t hash;
+  CmdIdKind kind;
+  uint8_t len;
+  bool applied;
+  char id[CMD_ID_MAX];
+};
+
+static CmdSeen _cmdSeen[CMD_DEDUP_LEN];
+static uint8_t _cmdSeenNext = 0;
+static uint32_t _cmdDups = 0;
+
+static CmdIdKind cmdIdKind(const CmdId& id, bool cbor) {
+  if (cbor) return id.isNum ? CMD_ID_CBOR_NUM : CMD_ID_CBOR_TEXT;
+  return id.isNum ? CMD_ID_JSON_NUM : CMD_ID_JSON_TEXT;
+}
+
+static uint32_t cmdIdHash(const JsonSpan& id) {
+  uint32_t h = 2166136261u;
+  for (uint16_t i = 0; i < id.len; i++) {
+    h ^= (uint8_t)id.p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static const CmdSeen* cmdSeenFind(CmdIdKind kind, const JsonSpan& id, uint32_t h) {
+  for (uint8_t i = 0; i < CMD_DEDUP_LEN; i++) {
+    const CmdSeen& e = _cmdSeen[i];
+    if (e.kind == kind && e.hash == h && e.len == id.len && memcmp(e.id, id.p, id.len) == 0) return &e;
+  }
+  return nullptr;
+}
+
+static void cmdSeenAdd(CmdIdKind kind, const JsonSpan& id, uint32_t h, bool applied) {
+  CmdSeen& e = _cmdSeen[_cmdSeenNext];
+  e.hash = h;
+  e.kind = kind;
+  e.len = (uint8_t)id.len;
+  e.applied = applied;
+  memcpy(e.id, id.p, id.len);
+  _cmdSeenNext = (_cmdSeenNext + 1) % CMD_DEDUP_LEN;
+}
+
+// {"type":"ack","cmd_id":..,"ok":..,"dup":..,"us":..} en TOPIC_ACK (QoS 0),
+// o CBOR en TOPIC_ACK_CBOR si el cmd llegó en CBOR.
+// us = ingreso -> aplicado (0 en repetidos: no se aplicó de nuevo)
+static void publishAck(const CmdId& id, bool ok, bool dup, uint32_t us, bool cbor) {
+  const JsonSpan& cmdId = id.text;
+  if (_topics[TOPIC_ACK][0] == '\0') return;
+
+  if (cbor) {
+    uint8_t bin[96];
+    CborWriter w;
+    cbor_begin(w, bin, sizeof(bin));
+    cbor_map(w, 4);
+    cbor_uint(w, CBK_CMD_ID);
+    if (id.isNum) cbor_uint(w, id.num);
+    else          cbor_text(w, cmdId.p, cmdId.len);
+    cbor_uint(w, CBK_OK);     cbor_bool(w, ok);
+    cbor_uint(w, CBK_DUP);    cbor_bool(w, dup);
+    cbor_uint(w, CBK_US);     cbor_uint(w, us);
+    if (!w.ok) return;
+
+    if (!mqtt->publish(_topics[TOPIC_ACK_CBOR], bin, w.len, false)) LOGW("⚠️ Falló publicar ack");
+    return;
+  }
+
+  char out[160];
+  const char* q = id.isNum ? "" : "\"";
+  int n = snprintf(out, sizeof(out), "{\"type\":\"ack\",\"cmd_id\":%s%.*s%s,\"ok\":%d,\"dup\":%d,\"us\":%lu}",
+                   q, (int)cmdId.len, cmdId.p, q, ok ? 1 : 0, dup ? 1 : 0, (unsigned long)us);
+  if (n < 0 || (size_t)n >= sizeof(out)) return;
+
+  if (!mqtt->publish(_topics[TOPIC_ACK], (uint8_t*)out, n, false)) {
+    LOGW("⚠️ Falló publicar ack");
+  }
 }
 
 // =======================
 // MQTT callback
 // =======================
-static void onMqttMessage(char* topic, byte* payload, unsigned int length) {
-  Serial.print("📥 MQTT recibido en topic: ");
-  Serial.println(topic);
+// Común a JSON y CBOR: dedup por cmd_id, aplicar y confirmar
+static void dispatchCmd(const char* vpin, int valueInt, const CmdId& id,
+                        bool cbor, uint32_t ingressUs) {
+  const JsonSpan& cmdId = id.text;
+  // cmd_id ya visto: se confirma otra vez sin re-aplicar
+  // (los ids con comillas se ignoran: no se pueden reenviar sin escapar)
+  bool hasId = cmdId.len > 0 && cmdId.len <= CMD_ID_MAX && !memchr(cmdId.p, '"', cmdId.len);
+  CmdIdKind idKind = cmdIdKind(id, cbor);
+  uint32_t idHash = hasId ? cmdIdHash(cmdId) : 0;
+  if (hasId) {
+    const CmdSeen* seen = cmdSeenFind(idKind, cmdId, idHash);
+    if (seen) {
+      _cmdDups++;
+      LOGI("♻️ CMD repetido cmd_id=%.*s (ignorado, repetidos: %lu)",
+           (int)cmdId.len, cmdId.p, (unsigned long)_cmdDups);
+      publishAck(id, seen->applied, true, 0, cbor);
+      return;
+    }
+  }
 
-  StaticJsonDocument<768> doc;
-  DeserializationError err = deserializeJson(doc, payload, length);
-  if (err) {
-    Serial.print("❌ JSON parse error: ");
-    Serial.println(err.c_str());
+  lat_mark(LAT_DISPATCH);
+  bool applied = _onCmd ? _onCmd(vpin, valueInt) : false;
+  uint32_t us = (uint32_t)micros() - ingressUs;
+
+  LOGI("✅ CMD vpin=%s value=%d", vpin, valueInt);
+
+  if (hasId) {
+    cmdSeenAdd(idKind, cmdId, idHash, applied);
+    publishAck(id, applied, false, us, cbor);
+  }
+}
+
+static void handleMqttCmd(char* topic, byte* payload, unsigned int length, uint32_t ingressUs) {
+  char vpin[16];
+
+  if (topicIsCbor(topic)) {
+    CborCmd c;
+    memset(&c, 0, sizeof(c));
+    c.vpin = -1;
+    if (!cbor_scanMap(payload, length, onCborCmdField, &c)) {
+      LOGE("❌ CBOR parse error en %s", topic);
+      return;
+    }
+    if (c.vpin < 0 || !c.hasValue) return;
+
+    snprintf(vpin, sizeof(vpin), "V%ld", (long)c.vpin);
+    dispatchCmd(vpin, (int)c.value, CmdId{ c.cmdId, c.cmdIdIsNum, c.cmdIdU }, true, ingressUs);
     return;
   }
 
-  const char* type = doc["type"] | "";
-  if (strlen(type) > 0 && String(type) != "cmd") return;
+  MqttCmd c;
+  memset(&c, 0, sizeof(c));
 
-  const char* t = doc["tenant_id"] | "";
-  if (strlen(t) > 0 && String(t) != String(_cfg.tenant_id)) return;
+  if (!jscan_object((const char*)payload, length, onMqttCmdField, &c)) {
+    LOGE("❌ JSON parse error en %s", topic);
+    return;
+  }
+
+  if (c.type.len > 0 && !jscan_eq(c.type, "cmd")) return;
+  if (c.tenant.len > 0 && !jscan_eqSpan(c.tenant, _tenantSpan)) return;
+
+  // "vpin" manda sobre "pin"
+  const JsonSpan& vp = c.vpin.len > 0 ? c.vpin : c.pin;
+  if (vp.len == 0 || !jscan_copy(vp, vpin, sizeof(vpin))) return;
 
-  String vpin;
   int valueInt = 0;
-  if (!extractVpinAndValue(doc, vpin, valueInt)) return;
+  if (!jscan_toInt(c.value, valueInt)) return;
+
+  dispatchCmd(vpin, valueInt, CmdId{ c.cmdId, c.cmdIdNum, 0 }, false, ingressUs);
+}
+
+static void onMqttMessage(char* topic, byte* payload, unsigned int length) {
+  uint32_t ingressUs = (uint32_t)micros();
+  lat_begin(ingressUs);
+  handleMqttCmd(topic, payload, length, ingressUs);
+  lat_end();
+}
+
+// =======================
+// Publicación de estado + cola offline
+// Ring buffer fijo (sin heap): un estado por vpin (gana el último valor),
+// se vacía en orden tras reconectar, a ritmo limitado.
+// =======================
+#define PUBQ_LEN              16
+#define PUBQ_VPIN_MAX         8
+#define PUBQ_DRAIN_INTERVAL_MS 100
+
+struct PubQItem {
+  char vpin[PUBQ_VPIN_MAX];
+  int value;
+};
+
+static PubQItem _pubq[PUBQ_LEN];
+static uint8_t _pubqHead = 0;
+static uint8_t _pubqCount = 0;
+static uint32_t _pubqDropped = 0;
+static unsigned long _pubqLastDrainMs = 0;
+
+// Prefijo constante del estado, renderizado una vez por device_id:
+//   {"type":"state","tenant_id":"..","device_id":"..","vpin":"
+// renderState() solo copia el prefijo y escribe la cola: V0","value":1}
+// (mismos bytes que daba ArduinoJson)
+static char _statePrefix[160];
+static uint16_t _statePrefixLen = 0;
+
+// Sin escapes: las cadenas que van tal cual dentro de comillas
+static bool jsonPlain(const char* s) {
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\' || (unsigned char)*s < 0x20) return false;
+  }
+  return true;
+}
+
+static void buildStatePrefix() {
+  _statePrefixLen = 0;
+  const char* tenant = _cfg.tenant_id ? _cfg.tenant_id : "";
+  if (!jsonPlain(tenant) || !jsonPlain(_deviceId.c_str())) {
+    LOGE("❌ state: tenant/device_id con caracteres no válidos");
+    return;
+  }
+
+  int n = snprintf(_statePrefix, sizeof(_statePrefix),
+                   "{\"type\":\"state\",\"tenant_id\":\"%s\",\"device_id\":\"%s\",\"vpin\":\"",
+                   tenant, _deviceId.c_str());
+  if (n > 0 && (size_t)n < sizeof(_statePrefix)) _statePrefixLen = (uint16_t)n;
+}
+
+// 0 si no hay prefijo, el vpin necesita escapes o no cabe
+static size_t renderState(char* out, size_t cap, const char* vpin, int value) {
+  static const char MID[] = "\",\"value\":";
+  size_t vlen = strlen(vpin);
+  // prefijo + vpin + MID + "-2147483648" + "}" + '\0'
+  if (_statePrefixLen == 0 || _statePrefixLen + vlen + (sizeof(MID) - 1) + 13 > cap) return 0;
+  if (!jsonPlain(vpin)) return 0;
+
+  char* p = out;
+  memcpy(p, _statePrefix, _statePrefixLen); p += _statePrefixLen;
+  memcpy(p, vpin, vlen);                    p += vlen;
+  memcpy(p, MID, sizeof(MID) - 1);          p += sizeof(MID) - 1;
+
+  // entero -> texto, de atrás hacia adelante
+  char digits[11];
+  uint8_t nd = 0;
+  uint32_t u = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  do {
+    digits[nd++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u);
+  if (value < 0) *p++ = '-';
+  while (nd) *p++ = digits[--nd];
+
+  *p++ = '}';
+  *p = '\0';
+  return (size_t)(p - out);
+}
+
+// {1: vpin, 2: value}; 0 si el vpin no tiene la forma "V<n>"
+static size_t renderStateCbor(uint8_t* out, size_t cap, const char* vpin, int value) {
+  int idx = vpin_parseIndex(vpin);
+  if (idx < 0) return 0;
+
+  CborWriter w;
+  cbor_begin(w, out, cap);
+  cbor_map(w, 2);
+  cbor_uint(w, CBK_VPIN);  cbor_uint(w, (uint32_t)idx);
+  cbor_uint(w, CBK_VALUE); cbor_int(w, value);
+  return w.ok ? w.len : 0;
+}
+
+// Camino caliente: sin heap ni formateo (el log de éxito es LOGD)
+static bool publishStateNow(const char* vpin, int value) {
+  bool retained = false;
+
+  if (_payloadCbor) {
+    uint8_t bin[16];
+    size_t n = renderStateCbor(bin, sizeof(bin), vpin, value);
+    if (n > 0) {
+      bool ok = mqtt->publish(_topics[TOPIC_PUB_CBOR], bin, n, retained);
+      if (ok) LOGD("✅ State publicado (cbor, %u B): %s=%d", (unsigned)n, vpin, value);
+      else LOGE("❌ Falló publicar state (cbor): %s=%d", vpin, value);
+      return ok;
+    }
+    // vpin sin índice: sale en JSON
+  }
+
+  char out[256];
+  size_t n = renderState(out, sizeof(out), vpin, value);
+  if (n == 0) {
+    // no se podrá renderizar nunca: se descarta en vez de atascar la cola
+    LOGE("❌ State no renderizable, descartado: %s=%d", vpin, value);
+    return true;
+  }
+
+  bool ok = mqtt->publish(_topics[TOPIC_PUB], (uint8_t*)out, n, retained);
+
+  if (ok) LOGD("✅ State publicado: %.*s", (int)n, out);
+  else LOGE("❌ Falló publicar state: %.*s", (int)n, out);
+  return ok;
+}
+
+static void pubqPush(const char* vpin, int value) {
+  if (!vpin || strlen(vpin) >= PUBQ_VPIN_MAX) return;
+
+  // coalesce: mismo vpin ya encolado -> solo se actualiza el valor
+  for (uint8_t i = 0; i < _pubqCount; i++) {
+    PubQItem& it = _pubq[(_pubqHead + i) % PUBQ_LEN];
+    if (strcmp(it.vpin, vpin) == 0) {
+      it.value = value;
+      return;
+    }
+  }
+
+  if (_pubqCount == PUBQ_LEN) {
+    // lleno: se pierde el más viejo
+    _pubqHead = (_pubqHead + 1) % PUBQ_LEN;
+    _pubqCount--;
+    _pubqDropped++;
+    LOGW("⚠️ Cola de estados llena, descartados: %lu", (unsigned long)_pubqDropped);
+  }
+
+  PubQItem& it = _pubq[(_pubqHead + _pubqCount) % PUBQ_LEN];
+  strncpy(it.vpin, vpin, PUBQ_VPIN_MAX);
+  it.vpin[PUBQ_VPIN_MAX - 1] = '\0';
+  it.value = value;
+  _pubqCount++;
+
+  LOGI("📦 State encolado: %s=%d (en cola %u)", vpin, value, (unsigned)_pubqCount);
+}
+
+// Un mensaje por intervalo; solo con MQTT conectado
+static void pubqDrain(unsigned long now) {
+  if (_pubqCount == 0 || !mqtt->connected()) return;
+  if (now - _pubqLastDrainMs < PUBQ_DRAIN_INTERVAL_MS) return;
+  _pubqLastDrainMs = now;
+
+  PubQItem& it = _pubq[_pubqHead];
+  if (!publishStateNow(it.vpin, it.value)) return;
+
+  _pubqHead = (_pubqHead + 1) % PUBQ_LEN;
+  _pubqCount--;
+}
+
+// =======================
+// Vigía del socket MQTT
+// Una tarea espera (select) a que el socket sea legible y despierta al
+// loop; no vuelve a mirar hasta que net_loop() lo rearma tras mqtt->loop().
+// =======================
+#define MQTT_KEEPALIVE_WAKE_MS 5000UL   // PINGREQ de PubSubClient (keepalive 15s)
+#define MQTT_POLL_FALLBACK_MS  20UL     // si el cliente no expone el socket
+#define MQTT_WATCH_WAIT_MS     1000UL
+
+static TaskHandle_t _mqttWatchTask = nullptr;
+static volatile bool _mqttWatchable = false;
+
+static void mqttWatchTask(void* arg) {
+  (void)arg;
+  for (;;) {
+    int r = hal_netWaitReadable(HAL_NET_MQTT, MQTT_WATCH_WAIT_MS);
+    _mqttWatchable = (r >= 0);
+
+    if (r > 0) {
+      wake_signal(WAKE_BIT_MQTT);
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);   // hasta que el loop lea
+    } else if (r < 0) {
+      vTaskDelay(pdMS_TO_TICKS(MQTT_WATCH_WAIT_MS));
+    }
+  }
+}
 
-  Serial.print("✅ CMD vpin=");
-  Serial.print(vpin);
-  Serial.print(" value=");
-  Serial.println(valueInt);
+static void mqttWatchRearm() {
+  if (_mqttWatchTask) xTaskNotifyGive(_mqttWatchTask);
+}
+
+// =======================
+// Métricas periódicas (latencia por etapa) en TOPIC_METRICS
+// =======================
+#define METRICS_INTERVAL_MS 60000UL
 
-  if (_onCmd) _onCmd(vpin, valueInt);
+static unsigned long lastMetricsMs = 0;
+
+static void metricsPublish(unsigned long now) {
+  if (now - lastMetricsMs < METRICS_INTERVAL_MS) return;
+  lastMetricsMs = now;
+
+  char out[896];
+  int n = snprintf(out, sizeof(out), "{\"type\":\"metrics\",\"device_id\":\"%s\",\"up\":%lu,\"lat\":",
+                   _deviceId.c_str(), (unsigned long)(now / 1000));
+  if (n < 0 || (size_t)n >= sizeof(out)) return;
+
+  size_t m = lat_renderJson(out + n, sizeof(out) - n - 1);
+  if (m == 0) {
+    LOGW("⚠️ métricas no caben en el buffer");
+    return;
+  }
+  n += m;
+  out[n++] = '}';
+
+  if (!mqtt->publish(_topics[TOPIC_METRICS], (uint8_t*)out, n, false)) {
+    LOGW("⚠️ Falló publicar métricas");
+  }
 }
 
 // =======================
 // MQTT connect
 // =======================
 static bool ensureMqttConnected() {
-  if (WiFi.status() != WL_CONNECTED) return false;
+  if (hal_wifiStatus() != HAL_WIFI_CONNECTED) return false;
   if (_deviceId.length() == 0) return false;
   if (mqtt->connected()) return true;
 
-  Serial.print("🔌 Conectando a MQTT... ");
-  Serial.print(_cfg.mqtt_host);
-  Serial.print(":");
-  Serial.print(_cfg.mqtt_port);
-  Serial.print(" ");
+  LOGI("🔌 Conectando a MQTT... %s:%u", _cfg.mqtt_host, (unsigned)_cfg.mqtt_port);
 
-  String clientId = _deviceId + "-" + String((uint32_t)ESP.getEfuseMac(), HEX);
+  String clientId = _deviceId + "-" + String((uint32_t)hal_efuseMac(), HEX);
 
-  bool ok = mqtt->connect(clientId.c_str(), _cfg.mqtt_user, _cfg.mqtt_pass);
+  // PubSubClient reutiliza el socket si ya está conectado
+  if (_mqttUseTls &&
+      !tlsConnectTimed(HAL_NET_MQTT, _cfg.mqtt_host, _cfg.mqtt_port, _tlsMqttStats)) {
+    netProgress(NET_PROGRESS_MQTT_FAIL);
+    return false;
+  }
+
+  // QoS 1: sesión persistente (cleanSession=false) para que el broker
+  // guarde los cmds pendientes durante un corte
+  bool persistent = _cfg.mqtt_sub_qos > 0;
+  bool ok = mqtt->connect(clientId.c_str(), _cfg.mqtt_user, _cfg.mqtt_pass,
+                          nullptr, 0, false, nullptr, !persistent);
   if (!ok) {
-    Serial.print("❌ fallo MQTT state=");
-    Serial.println(mqtt->state());
+    int st = mqtt->state();
+    LOGE("❌ fallo MQTT state=%d", st);
+    netProgress(NET_PROGRESS_MQTT_FAIL);
+
+    // El broker rechaza el device en caché -> invalidar y re-bootstrap
+    if (_deviceIdFromCache &&
+        (st == MQTT_CONNECT_BAD_CREDENTIALS || st == MQTT_CONNECT_UNAUTHORIZED)) {
+      LOGI("🧹 device_id en caché rechazado, se re-bootstrapea.");
+      clearCachedDeviceId();
+      _deviceId = "";
+      _deviceIdFromCache = false;
+      clearTopics();
+      sup_arm(SUP_BOOTSTRAP, millis());
+    }
     return false;
   }
 
-  Serial.println("✔ conectado.");
+  LOGI("✔ conectado.");
+  netProgress(NET_PROGRESS_MQTT_OK);
 
-  bool subOk = mqtt->subscribe(topicSub.c_str());
-  Serial.print(subOk ? "📡 Suscrito a: " : "❌ Falló subscribe: ");
-  Serial.println(topicSub);
+  // la nube elige el formato de cada cmd por el topic
+  uint8_t qos = _cfg.mqtt_sub_qos > 0 ? 1 : 0;
+  bool subOk = mqtt->subscribe(_topics[TOPIC_SUB], qos) &&
+               mqtt->subscribe(_topics[TOPIC_SUB_CBOR], qos);
+  if (subOk) LOGI("📡 Suscrito a: %s (+%s, QoS %d)", _topics[TOPIC_SUB], TOPIC_CBOR_SUFFIX, qos);
+  else LOGE("❌ Falló subscribe: %s", _topics[TOPIC_SUB]);
 
   if (_publishAllFn) _publishAllFn();
   return true;
@@ -352,83 +1493,134 @@ static bool ensureMqttConnected() {
 // =======================
 // MQTT config/topics
 // =======================
+static bool buildTopic(NetTopic t, const char* root, const char* leaf, const char* suffix = "") {
+  int n = snprintf(_topics[t], TOPIC_MAX, "%s/%s/%s/%s%s", root,
+                   _cfg.tenant_id ? _cfg.tenant_id : "", _deviceId.c_str(), leaf, suffix);
+  if (n < 0 || n >= TOPIC_MAX) {
+    _topics[t][0] = '\0';
+    return false;
+  }
+  return true;
+}
+
 static void configureMqttAndTopics() {
   if (_deviceId.length() == 0) return;
 
-  topicPub = String("nebadondevice/") + _cfg.tenant_id + "/" + _deviceId + "/dt";
-  topicSub = String("nebadoncmd/")    + _cfg.tenant_id + "/" + _deviceId + "/cmd";
-
-  bool useTls = (_cfg.mqtt_port == 8883);
-  if (useTls) {
-    if (_cfg.tls_insecure) tlsClient.setInsecure();
-    tlsClient.setTimeout(5000);
-    mqtt = &mqttTls;
-    Serial.println("🔐 MQTT usando TLS (8883)");
-  } else {
-    mqtt = &mqttTcp;
-    Serial.println("🌐 MQTT sin TLS (1883)");
-  }
-
+  bool ok = buildTopic(TOPIC_PUB,      "nebadondevice", "dt") &&
+            buildTopic(TOPIC_PUB_CBOR, "nebadondevice", "dt", TOPIC_CBOR_SUFFIX) &&
+            buildTopic(TOPIC_SUB,      "nebadoncmd",    "cmd") &&
+            buildTopic(TOPIC_SUB_CBOR, "nebadoncmd",    "cmd", TOPIC_CBOR_SUFFIX) &&
+            buildTopic(TOPIC_METRICS,  "nebadondevice", "metrics") &&
+            buildTopic(TOPIC_ACK,      "nebadondevice", "ack") &&
+            buildTopic(TOPIC_ACK_CBOR, "nebadondevice", "ack", TOPIC_CBOR_SUFFIX);
+  if (!ok) LOGE("❌ MQTT: topic demasiado largo (device_id=%s)", _deviceId.c_str());
+  buildStatePrefix();
+
+  _mqttUseTls = (_cfg.mqtt_port == 8883);
+  hal_netSetup(HAL_NET_MQTT, HalNetOpts{ _mqttUseTls, _cfg.tls_insecure, 5000 });
+  LOGI(_mqttUseTls ? "🔐 MQTT usando TLS (8883)" : "🌐 MQTT sin TLS (1883)");
+
+  mqtt->setClient(hal_netClient(HAL_NET_MQTT));
   mqtt->setServer(_cfg.mqtt_host, _cfg.mqtt_port);
   mqtt->setCallback(onMqttMessage);
   mqtt->setBufferSize(1024);
 
-  Serial.print("✅ MQTT topics: PUB=");
-  Serial.print(topicPub);
-  Serial.print(" SUB=");
-  Serial.println(topicSub);
+  LOGI("✅ MQTT topics: PUB=%s SUB=%s", _topics[TOPIC_PUB], _topics[TOPIC_SUB]);
 }
 
 // =======================
-// Public API
+// WiFi -> resto de la cadena
 // =======================
-bool net_begin(const NetConfig& cfg, MqttCmdHandler onCmd) {
-  _cfg = cfg;
-  _onCmd = onCmd;
-  _deviceId = "";
-  topicPub = "";
-  topicSub = "";
+static void onWifiGotIp() {
+  netProgress(NET_PROGRESS_WIFI_OK);
+  timeStartSyncIfNeeded();
 
-  // 1) NVS WiFi first
-  String savedSsid, savedPass;
-  bool hasSaved = nvs_loadWifi(savedSsid, savedPass);
+  unsigned long now = millis();
+  sup_ok(SUP_WIFI);
+  sup_arm(SUP_BOOTSTRAP, now);
+  sup_arm(SUP_MQTT, now);
 
-  if (hasSaved) {
-    _wifiSsid = savedSsid;
-    _wifiPass = savedPass;
-    Serial.println("💾 WiFi cargado desde NVS.");
-  } else {
-    _wifiSsid = (_cfg.wifi_ssid ? String(_cfg.wifi_ssid) : "");
-    _wifiPass = (_cfg.wifi_pass ? String(_cfg.wifi_pass) : "");
-    Serial.println("ℹ️ WiFi usando credenciales del firmware (no hay NVS).");
-  }
+  // Con device_id en caché no hay bootstrap: MQTT arranca directo
+  if (_deviceId.length() > 0) netProgress(NET_PROGRESS_BOOTSTRAP_OK);
+}
 
-  // 2) Try WiFi. If fails -> keep alive for BLE
-  bool wifiOk = setupWiFiWithCreds(_wifiSsid, _wifiPass, 12000);
-  if (!wifiOk) {
-    Serial.println("⚠️ WiFi no conectado. Esperando provisioning BLE o reconexión en net_loop().");
-    return true;
-  }
+// Warm boot: device_id desde NVS sin pasar por HTTPS
+static bool loadCachedDeviceId() {
+  String cached;
+  if (!cachedDeviceIdFor(getDeviceCacheKey(), cached)) return false;
 
-  setupTimeIfNeeded();
+  _deviceId = cached;
+  _deviceIdFromCache = true;
+  _payloadCbor = (cfg_getU32(CFG_PAYLOAD_FMT) == 1);
+  LOGI("💾 device_id desde NVS: %s", _deviceId.c_str());
+  configureMqttAndTopics();
+  return true;
+}
 
-  if (!_cfg.api_base || !_cfg.bootstrap_path) {
-    Serial.println("❌ api_base/bootstrap_path no definidos. MQTT no iniciará.");
-    return true;
-  }
+static void onBootstrapOk(const String& deviceUUID) {
+  _deviceId = deviceUUID;
+  _deviceIdFromCache = false;
+  cacheDeviceId(getDeviceCacheKey(), _deviceId);
+  netProgress(NET_PROGRESS_BOOTSTRAP_OK);
+  configureMqttAndTopics();
+}
 
-  String deviceUUID;
-  if (!bootstrapDevice(deviceUUID)) {
-    Serial.println("❌ Bootstrap falló. MQTT no iniciará (reintentos en loop).");
-    return true;
+static void bootstrapFailed() {
+  unsigned long t = millis();
+  sup_fail(SUP_BOOTSTRAP, t);
+  netProgress(NET_PROGRESS_BOOTSTRAP_FAIL);
+  wake_within(sup_remaining(SUP_BOOTSTRAP, t));
+}
+
+// Resultado de la tarea, ya en el loop; false si falló
+static bool bootstrapFinish() {
+  _boot.url = String();
+  _boot.body = String();
+
+  if (!_boot.ok) {
+    bootstrapFailed();
+    return false;
   }
 
-  _deviceId = deviceUUID;
-  configureMqttAndTopics();
+  _payloadCbor = _boot.cbor;
+  cfg_setU32(CFG_PAYLOAD_FMT, _payloadCbor ? 1 : 0);
+  LOGI("✅ bootstrap OK device_id(UUID)=%s payload=%s", _boot.deviceId, _payloadCbor ? "cbor" : "json");
+  sup_ok(SUP_BOOTSTRAP);
+  onBootstrapOk(String(_boot.deviceId));
+  return true;
+}
+
+// =======================
+// Public API
+// =======================
+static void applyConfig(const NetConfig& cfg, MqttCmdHandler onCmd) {
+  _cfg = cfg;
+  _onCmd = onCmd;
+
+  _tenantSpan.p   = _cfg.tenant_id ? _cfg.tenant_id : "";
+  _tenantSpan.len = (uint16_t)strlen(_tenantSpan.p);
+}
+
+bool net_begin(const NetConfig& cfg, MqttCmdHandler onCmd) {
+  applyConfig(cfg, onCmd);
+  _deviceId = "";
+  _deviceIdFromCache = false;
+  clearTopics();
 
-  if (!ensureMqttConnected()) {
-    Serial.println("⚠️ MQTT no conectó en intento inicial (reintentos en loop).");
+  // 0) device_id en caché: evita el bootstrap HTTPS en warm boots
+  loadCachedDeviceId();
+
+  // 1) Redes WiFi: NVS primero, si no las del firmware
+  netsLoad();
+
+  // 2) WiFi no bloqueante: bootstrap y MQTT los encadena net_loop() al tener IP
+  hal_wifiInit();
+  hal_wifiOnEvent(onWifiEvent);
+  if (!_mqttWatchTask) {
+    xTaskCreate(mqttWatchTask, "mqttwatch", 2048, nullptr, 1, &_mqttWatchTask);
   }
+  _wifiState = WIFI_ST_IDLE;
+  wifiStartConnect(millis());
 
   return true;
 }
@@ -436,158 +1628,265 @@ bool net_begin(const NetConfig& cfg, MqttCmdHandler onCmd) {
 void net_loop() {
   unsigned long now = millis();
 
-  // 1) WiFi reconnect
-  if (WiFi.status() != WL_CONNECTED) {
-    if (_wifiSsid.length() == 0) return;
-
-    if (now - lastWifiReconnectAttemptMs > 3000) {
-      lastWifiReconnectAttemptMs = now;
-      Serial.println("🔁 Reintentando WiFi...");
-      setupWiFiWithCreds(_wifiSsid, _wifiPass, 12000);
-
-      if (WiFi.status() == WL_CONNECTED) {
-        setupTimeIfNeeded();
-        lastBootstrapAttemptMs = 0;
-        lastMqttReconnectAttemptMs = 0;
-      }
-    }
-    return;
+  // 1) WiFi: avanza la máquina de estados, nunca espera
+  {
+    ProfScope p(PROF_WIFI);
+    wifiPoll(now);
+    timePoll(now);
   }
+  if (_wifiState != WIFI_ST_GOT_IP) return;
 
-  // 2) Bootstrap retry
+  // 2) Bootstrap: en su tarea; aquí solo se lanza y se recoge
   if (_deviceId.length() == 0) {
-    if (!_cfg.api_base || !_cfg.bootstrap_path) return;
-
-    if (now - lastBootstrapAttemptMs > 5000) {
-      lastBootstrapAttemptMs = now;
-      Serial.println("🔁 Reintentando bootstrap...");
-      String deviceUUID;
-      if (bootstrapDevice(deviceUUID)) {
-        _deviceId = deviceUUID;
-        configureMqttAndTopics();
-      } else {
+    ProfScope p(PROF_BOOTSTRAP);
+    if (_bootState == BOOT_JOB_RUNNING) return;   // la tarea despierta con WAKE_BIT_BOOT
+
+    if (_bootState == BOOT_JOB_DONE) {
+      _bootState = BOOT_JOB_IDLE;
+      if (!bootstrapFinish()) return;
+    } else {
+      if (!_cfg.api_base || !_cfg.bootstrap_path) return;
+      if (tlsNeedsTime() && strncmp(_cfg.api_base, "https://", 8) == 0) return;
+
+      if (!sup_due(SUP_BOOTSTRAP, now)) {
+        wake_within(sup_remaining(SUP_BOOTSTRAP, now));
         return;
       }
-    } else {
+
+      LOGI("🔁 Reintentando bootstrap...");
+      if (!bootstrapStart()) bootstrapFailed();
       return;
     }
   }
 
   // 3) MQTT reconnect (con logs)
   if (!mqtt->connected()) {
-    if (now - lastMqttReconnectAttemptMs > 2000) {
-      lastMqttReconnectAttemptMs = now;
-      Serial.println("🔁 Reintentando MQTT...");
-      bool ok = ensureMqttConnected();
-      if (ok) Serial.println("✅ MQTT conectado (net_loop)");
+    ProfScope p(PROF_MQTT_CONN);
+    if (_mqttWasConnected) {
+      // caída del broker o del enlace: primer reintento con jitter
+      _mqttWasConnected = false;
+      sup_arm(SUP_MQTT, now);
+    }
+    if (_mqttUseTls && tlsNeedsTime()) return;   // lo despierta el SNTP
+
+    if (!sup_due(SUP_MQTT, now)) {
+      wake_within(sup_remaining(SUP_MQTT, now));
+      return;
     }
+
+    LOGI("🔁 Reintentando MQTT...");
+    if (!ensureMqttConnected()) {
+      unsigned long t = millis();
+      sup_fail(SUP_MQTT, t);
+      wake_within(sup_remaining(SUP_MQTT, t));
+      return;
+    }
+
+    LOGI("✅ MQTT conectado (net_loop)");
+    sup_ok(SUP_MQTT);
+    _mqttWasConnected = true;
+    mqttWatchRearm();
+    wake_within(0);
     return;
   }
 
+  ProfScope p(PROF_MQTT_LOOP);
   mqtt->loop();
+  pubqDrain(now);
+  metricsPublish(now);
+
+  // próximo despertar: datos ya descifrados en el buffer TLS no hacen
+  // legible el socket, así que se miran aquí
+  mqttWatchRearm();
+  if (hal_netClient(HAL_NET_MQTT).available() > 0) wake_within(0);
+  if (_pubqCount > 0) wake_within(wake_remaining(_pubqLastDrainMs, PUBQ_DRAIN_INTERVAL_MS, now));
+  wake_within(wake_remaining(lastMetricsMs, METRICS_INTERVAL_MS, now));
+  wake_within(_mqttWatchable ? MQTT_KEEPALIVE_WAKE_MS : MQTT_POLL_FALLBACK_MS);
 }
 
 bool net_isConnected() {
-  return (WiFi.status() == WL_CONNECTED) && _deviceId.length() && mqtt->connected();
+  return (hal_wifiStatus() == HAL_WIFI_CONNECTED) && _deviceId.length() && mqtt->connected();
 }
 
-bool net_publishState(const String& vpin, int value) {
-  if (!mqtt->connected()) return false;
-
-  StaticJsonDocument<256> doc;
-  doc["type"]      = "state";
-  doc["tenant_id"] = _cfg.tenant_id;
-  doc["device_id"] = _deviceId;
-  doc["vpin"]      = vpin;
-  doc["value"]     = value;
+bool net_isMqttWatched() {
+  return _mqttWatchable;
+}
 
-  char out[256];
-  size_t n = serializeJson(doc, out, sizeof(out));
+bool net_publishState(const char* vpin, int value) {
+  // Sin conexión, o con cola pendiente (para no adelantar a lo encolado)
+  if (!mqtt->connected() || _pubqCount > 0) {
+    pubqPush(vpin, value);
+    return false;
+  }
 
-  bool retained = false;
-  bool ok = mqtt->publish(topicPub.c_str(), (uint8_t*)out, n, retained);
+  if (publishStateNow(vpin, value)) return true;
 
-  Serial.print(ok ? "✅ State publicado: " : "❌ Falló publicar state: ");
-  Serial.println(out);
-  return ok;
+  pubqPush(vpin, value);
+  return false;
 }
 
 void net_setPublishAllFn(PublishAllFn fn) {
   _publishAllFn = fn;
 }
 
-// =======================
-// ✅ WiFi creds desde BLE -> WiFi -> Bootstrap -> MQTT (con logs claros)
-// =======================
-void net_setWifiCredentials(const String& ssid, const String& pass, bool persist) {
-  if (ssid.length() == 0) return;
+void net_setProgressFn(NetProgressFn fn) {
+  _progressFn = fn;
+}
 
-  Serial.println("========================================");
-  Serial.println("📥 net_setWifiCredentials(): BLE -> WiFi -> Bootstrap -> MQTT");
-  Serial.print("SSID=");
-  Serial.println(ssid);
-  Serial.print("PASS_LEN=");
-  Serial.println(pass.length());
-  Serial.println("========================================");
+void net_getTlsStats(NetTlsStats& bootstrap, NetTlsStats& mqttStats) {
+  bootstrap = _tlsBootStats;
+  mqttStats = _tlsMqttStats;
+}
 
-  _wifiSsid = ssid;
-  _wifiPass = pass;
+bool net_isTimeValid() {
+  return _timeValid;
+}
 
-  if (persist) {
-    nvs_saveWifi(_wifiSsid, _wifiPass);
-    Serial.println("💾 WiFi guardado en NVS.");
-  }
+void net_setTimeValidFn(TimeValidFn fn) {
+  _timeValidFn = fn;
+}
 
-  // Reset de la cadena
+// =======================
+// ✅ WiFi creds desde BLE -> WiFi -> Bootstrap -> MQTT (con logs claros)
+// =======================
+static void wifiReprovision(int first) {
+  // Reset de la cadena (el device_id no depende del AP: se conserva)
   if (mqtt && mqtt->connected()) {
-    Serial.println("🧹 MQTT: desconectando para reprovision...");
+    LOGI("🧹 MQTT: desconectando para reprovision...");
     mqtt->disconnect();
   }
 
-  _deviceId = "";
-  topicPub = "";
-  topicSub = "";
-
-  // Forzar WiFi limpio
-  Serial.println("🧹 WiFi: disconnect(true,true) ...");
-  WiFi.disconnect(true, true);
-  delay(200);
-
-  // Conectar WiFi
-  Serial.println("📶 Intentando conectar WiFi...");
-  bool wifiOk = setupWiFiWithCreds(_wifiSsid, _wifiPass, 12000);
-  if (!wifiOk) {
-    Serial.println("❌ net_setWifiCredentials(): WiFi FAIL");
-    return;
+  // Credenciales nuevas: el backoff de las viejas no aplica
+  sup_ok(SUP_WIFI);
+
+  // Conectar WiFi: bootstrap y MQTT siguen en net_loop() al tener IP
+  LOGI("📶 Intentando conectar WiFi...");
+  if (!wifiStartConnect(millis(), first)) {
+    LOGE("❌ net_setWifiCredentials(): WiFi FAIL");
   }
-  Serial.println("✅ net_setWifiCredentials(): WiFi OK");
+}
 
-  setupTimeIfNeeded();
+void net_setWifiCredentials(const char* ssid, const char* pass, bool persist) {
+  if (!ssid || ssid[0] == '\0') return;
+  if (!pass) pass = "";
 
-  // Bootstrap
-  if (!(_cfg.api_base && _cfg.bootstrap_path)) {
-    Serial.println("❌ net_setWifiCredentials(): api_base/bootstrap_path no definidos.");
-    return;
-  }
+  LOGI("📥 net_setWifiCredentials(): BLE -> WiFi -> Bootstrap -> MQTT SSID=%s PASS_LEN=%d",
+       ssid, (int)strlen(pass));
 
-  Serial.println("📨 Ejecutando bootstrap...");
-  String deviceUUID;
-  if (!bootstrapDevice(deviceUUID)) {
-    Serial.println("❌ net_setWifiCredentials(): bootstrap FAIL");
+  // la red pasa al frente de la lista y se prueba primero
+  if (!netUpsertFront(ssid, pass, persist)) {
+    LOGE("❌ WiFi: credenciales demasiado largas");
     return;
   }
+  // mismas credenciales que las guardadas -> no toca la flash
+  if (persist) netsSave();
 
-  _deviceId = deviceUUID;
-  Serial.print("✅ Bootstrap OK device_id=");
-  Serial.println(_deviceId);
+  wifiReprovision(0);
+}
 
-  configureMqttAndTopics();
+void net_setWifiNetworks(const NetWifiCred* nets, size_t count, bool persist) {
+  if (!nets || count == 0) return;
+  if (count > NET_WIFI_MAX) count = NET_WIFI_MAX;
 
-  // MQTT
-  Serial.println("🔌 Intentando conectar MQTT...");
-  if (!ensureMqttConnected()) {
-    Serial.println("⚠️ net_setWifiCredentials(): MQTT FAIL (se reintenta en net_loop)");
-  } else {
-    Serial.println("✅ net_setWifiCredentials(): MQTT OK");
+  LOGI("📥 net_setWifiNetworks(): %u red(es) desde BLE", (unsigned)count);
+
+  _netCount = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!nets[i].ssid || nets[i].ssid[0] == '\0' || netFind(nets[i].ssid) >= 0) continue;
+    if (netSet(_nets[_netCount], nets[i].ssid, nets[i].pass, persist)) _netCount++;
+    else LOGE("❌ WiFi: credenciales demasiado largas (%s)", nets[i].ssid);
+  }
+
+  if (persist) {
+    netsSave();
+    // enlace en caché de una red que ya no está
+    if (netFind(cfg_getStr(CFG_WIFI_LINK_SSID)) < 0) wifiLinkClear();
   }
-}
\ No newline at end of file
+
+  wifiReprovision(-1);
+}
+
+#if defined(NEBADON_BENCH)
+// =======================
+// Ganchos del benchmark (sin WiFi ni MQTT)
+// =======================
+void net_benchBegin(const NetConfig& cfg, MqttCmdHandler onCmd) {
+  applyConfig(cfg, onCmd);
+  buildStatePrefix();
+}
+
+void net_benchMqttMessage(const char* payload, size_t len, bool cbor) {
+  static char topic[] = "bench";
+  static char topicCbor[] = "bench" TOPIC_CBOR_SUFFIX;
+  onMqttMessage(cbor ? topicCbor : topic, (byte*)payload, (unsigned int)len);
+}
+
+size_t net_benchRenderState(const char* vpin, int value, bool cbor) {
+  uint8_t out[256];
+  if (cbor) return renderStateCbor(out, sizeof(out), vpin, value);
+  return renderState((char*)out, sizeof(out), vpin, value);
+}
+
+#if defined(NET_BENCH_ARDUINOJSON)
+// El parser de antes de json_scan, sin los Serial.print: documento de
+// 768 B en stack y Strings temporales para comparar y extraer
+static bool benchExtractVpinAndValue(JsonDocument& doc, String& vpinOut, int& valueOut) {
+  const char* vpin = doc["vpin"] | doc["pin"];
+  if (!vpin || String(vpin).length() == 0) return false;
+
+  JsonVariant v = doc["value"];
+  if (v.isNull()) return false;
+
+  int valueInt = 0;
+  if (v.is<bool>()) valueInt = v.as<bool>() ? 1 : 0;
+  else if (v.is<long>() || v.is<int>()) valueInt = v.as<int>();
+  else if (v.is<float>() || v.is<double>()) valueInt = (int)lroundf(v.as<float>());
+  else if (v.is<const char*>()) valueInt = String(v.as<const char*>()).toInt();
+  else valueInt = v.as<int>();
+
+  vpinOut = String(vpin);
+  valueOut = valueInt;
+  return true;
+}
+
+void net_benchMqttMessageArduinoJson(const char* payload, size_t len) {
+  StaticJsonDocument<768> doc;
+  DeserializationError err = deserializeJson(doc, (const byte*)payload, len);
+  if (err) return;
+
+  const char* type = doc["type"] | "";
+  if (strlen(type) > 0 && String(type) != "cmd") return;
+
+  const char* t = doc["tenant_id"] | "";
+  if (strlen(t) > 0 && String(t) != String(_cfg.tenant_id)) return;
+
+  String vpin;
+  int valueInt = 0;
+  if (!benchExtractVpinAndValue(doc, vpin, valueInt)) return;
+
+  if (_onCmd) _onCmd(vpin.c_str(), valueInt);
+}
+
+// El estado como se serializaba antes del prefijo pre-renderizado
+size_t net_benchRenderStateArduinoJson(const char* vpin, int value) {
+  char out[256];
+  StaticJsonDocument<256> doc;
+  doc["type"]      = "state";
+  doc["tenant_id"] = _cfg.tenant_id;
+  doc["device_id"] = _deviceId;
+  doc["vpin"]      = vpin;
+  doc["value"]     = value;
+  return serializeJson(doc, out, sizeof(out));
+}
+#endif
+
+void net_benchEnd() {
+  memset(_cmdSeen, 0, sizeof(_cmdSeen));
+  _cmdSeenNext = 0;
+  _cmdDups = 0;
+
+  _pubqHead = 0;
+  _pubqCount = 0;
+  _pubqDropped = 0;
+}
+#endif
@@ -1,8 +1,9 @@
 #pragma once
 #include <Arduino.h>
 
-// Callback: cuando llega un cmd por MQTT (vpin + value)
-typedef void (*MqttCmdHandler)(const String& vpin, int value);
+// Callback: cuando llega un cmd por MQTT (vpin + value).
+// false si no se aplicó (vpin desconocido): el ack lo reporta.
+typedef bool (*MqttCmdHandler)(const char* vpin, int value);
 
 // Config para el módulo de red
 struct NetConfig {
@@ -28,20 +29,86 @@ struct NetConfig {
   uint16_t mqtt_port;          // 8883
   const char* mqtt_user;
   const char* mqtt_pass;
+  // 1: suscripción QoS 1 con sesión persistente (el broker guarda los cmds
+  // mientras no hay enlace); los repetidos se filtran por cmd_id
+  uint8_t mqtt_sub_qos = 1;
   
   // ENV
   const char* env; // PROD or DEV
 
   // NTP
   bool use_ntp = true;
+
+  // Reconexión rápida: reusar también la IP de la última concesión DHCP
+  // (además de BSSID/canal). Desactivar si el DHCP del sitio rota IPs.
+  bool wifi_reuse_lease = true;
 };
 
 bool net_begin(const NetConfig& cfg, MqttCmdHandler onCmd);
 void net_loop();
 bool net_isConnected();
+// true si la tarea vigía espera sobre el socket MQTT (select); false si
+// el transporte no expone su descriptor y net_loop sondea cada 20 ms
+bool net_isMqttWatched();
+
+// Publicar estado: vpin/value al topic de estado del device.
+// vpin es una vista a un nombre constante (p. ej. VPINS[i].name). Sin heap:
+// topic y prefijo del payload están pre-renderizados, solo se escribe la cola.
+// true si salió ya; si no hay MQTT se encola (último valor por vpin)
+// y se reenvía en orden al reconectar.
+bool net_publishState(const char* vpin, int value);
+
+// Progreso de la cadena WiFi -> Bootstrap -> MQTT (se emite desde net_loop)
+enum NetProgress : uint8_t {
+  NET_PROGRESS_WIFI_OK = 0,
+  NET_PROGRESS_WIFI_FAIL,
+  NET_PROGRESS_BOOTSTRAP_OK,
+  NET_PROGRESS_BOOTSTRAP_FAIL,
+  NET_PROGRESS_MQTT_OK,
+  NET_PROGRESS_MQTT_FAIL,
+  NET_PROGRESS_SCAN_DONE,     // terminó un escaneo pedido con net_requestWifiScan()
+};
+typedef void (*NetProgressFn)(NetProgress p);
+void net_setProgressFn(NetProgressFn fn);
+
+// Hora NTP válida (se sincroniza en segundo plano al tener WiFi)
+typedef void (*TimeValidFn)();
+bool net_isTimeValid();
+void net_setTimeValidFn(TimeValidFn fn);
+
+// Handshakes TLS (bootstrap HTTPS y MQTT 8883). Persisten en deep sleep.
+// Una conexión nueva reanuda la sesión anterior del mismo servidor si
+// este la acepta (hal_netResumed); si no, handshake completo.
+struct NetTlsStats {
+  uint32_t full;      // handshakes completos
+  uint32_t resumed;   // sesiones reanudadas
+  uint32_t failed;
+  uint32_t lastMs;
+  uint32_t maxMs;
+  uint32_t totalMs;   // de los completos
+  uint32_t resumedMs; // de los reanudados
+};
+void net_getTlsStats(NetTlsStats& bootstrap, NetTlsStats& mqtt);
+
+// Ruta de una asociación WiFi
+enum NetWifiPath : uint8_t {
+  NET_WIFI_FULL = 0,    // escaneo del driver + DHCP
+  NET_WIFI_DIRECT,      // BSSID/canal en caché (+ concesión)
+  NET_WIFI_SCANNED,     // BSSID/canal de nuestro escaneo reciente + DHCP
+};
 
-// Publicar estado: vpin/value al topicPub calculado
-bool net_publishState(const String& vpin, int value);
+// Conexiones WiFi: directa (BSSID/canal/concesión en caché), dirigida por
+// un escaneo reciente o escaneo completo
+struct NetWifiStats {
+  uint32_t directOk;
+  uint32_t directFail;   // cayó a escaneo completo
+  uint32_t scannedOk;
+  uint32_t fullOk;
+  uint32_t fullFail;     // falló la red por escaneo (dirigido o completo)
+  uint32_t lastMs;       // begin -> IP de la última conexión
+  NetWifiPath lastPath;
+};
+void net_getWifiStats(NetWifiStats& out);
 
 // Publica todos estados que el main le pase (útil al reconectar)
 typedef void (*PublishAllFn)();
@@ -51,4 +118,47 @@ void net_setPublishAllFn(PublishAllFn fn);
 // ✅ NUEVO:
 bool net_isWifiConnected();
 bool net_isConnected();
-void net_setWifiCredentials(const String& ssid, const String& pass, bool persist);
\ No newline at end of file
+// Guarda/sube la red al frente de la lista y la prueba primero
+void net_setWifiCredentials(const char* ssid, const char* pass, bool persist);
+
+// Reemplaza la lista de redes (en orden de preferencia). Con varias, un
+// escaneo las ordena por RSSI y se prueban en orden; las que fallaron hace
+// poco van al final.
+#define NET_WIFI_LIST_MAX 5
+
+struct NetWifiCred {
+  const char* ssid;
+  const char* pass;
+};
+void net_setWifiNetworks(const NetWifiCred* nets, size_t count, bool persist);
+
+// Último escaneo WiFi (sin re-escanear): una entrada por SSID, por RSSI.
+// ageMs = UINT32_MAX si no hay.
+struct NetWifiScanEntry {
+  char ssid[33];
+  int8_t rssi;
+  bool open;
+  bool known;    // está en la lista de redes
+};
+size_t net_getWifiScan(NetWifiScanEntry* out, size_t max, uint32_t& ageMs);
+// Escaneo async; al terminar se emite NET_PROGRESS_SCAN_DONE
+void net_requestWifiScan();
+#if defined(NEBADON_BENCH)
+// Solo para bench.cpp: carga la config sin arrancar WiFi y expone los
+// caminos internos de comando MQTT y serialización de estado.
+void net_benchBegin(const NetConfig& cfg, MqttCmdHandler onCmd);
+void net_benchMqttMessage(const char* payload, size_t len, bool cbor);
+size_t net_benchRenderState(const char* vpin, int value, bool cbor);
+// Tras el bench: olvida los cmd_id vistos y los estados encolados
+void net_benchEnd();
+
+// Referencia "antes": el parser y el renderer con ArduinoJson que
+// reemplazaron json_scan y el prefijo de estado, para medir los dos en el
+// mismo bench. En placa la librería está; en
+// host solo si CMake la encuentra (NEBADON_ARDUINOJSON_DIR).
+#if defined(ARDUINO) || defined(NEBADON_HAS_ARDUINOJSON)
+  #define NET_BENCH_ARDUINOJSON 1
+void net_benchMqttMessageArduinoJson(const char* payload, size_t len);
+size_t net_benchRenderStateArduinoJson(const char* vpin, int value);
+#endif
+#endif
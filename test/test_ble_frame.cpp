@@ -0,0 +1,175 @@
+// test_ble_frame.cpp
+// Framing BLE (ble_frame.h) con mensajes de varios KB: ida y vuelta
+// directa, y por el firmware con la app simulada (sim_ble*) a MTU 23,
+// donde 4096 bytes son más de 256 fragmentos. Un peer sin framing recibe
+// el error "MTU" en vez del mensaje truncado; el que escribe "FRAMING"
+// recibe fragmentos aunque nunca haya mandado uno. INFO le llega a una app
+// sin framing a MTU 185 en partes que caben.
+
+#include "test_util.h"
+#include "ble_control.h"
+#include "ble_frame.h"
+#include <string>
+#include <vector>
+
+#define RELAY_GPIO 26
+#define MSG_MAX    4096
+
+static std::string pattern(size_t len) {
+  std::string s(len, ' ');
+  for (size_t i = 0; i < len; i++) s[i] = (char)('a' + (i * 7) % 26);
+  return s;
+}
+
+static bool collect(const uint8_t* chunk, size_t len, void* ctx) {
+  ((std::vector<std::string>*)ctx)->emplace_back((const char*)chunk, len);
+  return true;
+}
+
+static bool toApp(const uint8_t* chunk, size_t len, void* ctx) {
+  (void)ctx;
+  sim_bleWrite(chunk, len);
+  return true;
+}
+
+// Reensambla los notifies desde 'from' como lo haría la app
+static bool appReassemble(size_t from, std::string& out) {
+  static uint8_t buf[MSG_MAX];
+  BleFrameRx rx;
+  bleframe_rxInit(rx, buf, sizeof(buf));
+  for (size_t i = from; i < sim_bleNotifyCount(); i++) {
+    const std::string& n = sim_bleNotify(i);
+    if (bleframe_rxPush(rx, (const uint8_t*)n.data(), n.size()) == BLE_FRAME_DONE) {
+      out.assign((const char*)buf, rx.len);
+      return true;
+    }
+  }
+  return false;
+}
+
+int main() {
+  test_begin();
+
+  // 1) ida y vuelta directa, con y sin MTU negociado
+  static const size_t MTUS[] = { 23, 185, 517 };
+  static uint8_t rxBuf[MSG_MAX];
+  for (size_t m : MTUS) {
+    std::string msg = pattern(MSG_MAX);
+    std::vector<std::string> frags;
+    CHECK(bleframe_send((const uint8_t*)msg.data(), msg.size(), 7, m - 3, collect, &frags));
+    if (m == 23) CHECK(frags.size() == (MSG_MAX + 13) / 14);   // 14 bytes por fragmento
+
+    BleFrameRx rx;
+    bleframe_rxInit(rx, rxBuf, sizeof(rxBuf));
+    BleFrameResult last = BLE_FRAME_ERROR;
+    for (const std::string& f : frags) {
+      CHECK(f.size() <= m - 3);
+      last = bleframe_rxPush(rx, (const uint8_t*)f.data(), f.size());
+    }
+    CHECK(last == BLE_FRAME_DONE);
+    CHECK(rx.len == msg.size() && memcmp(rxBuf, msg.data(), msg.size()) == 0);
+  }
+
+  // fragmento fuera de orden: se descarta el mensaje
+  {
+    std::string msg = pattern(1000);
+    std::vector<std::string> frags;
+    CHECK(bleframe_send((const uint8_t*)msg.data(), msg.size(), 1, 20, collect, &frags));
+    BleFrameRx rx;
+    bleframe_rxInit(rx, rxBuf, sizeof(rxBuf));
+    CHECK(bleframe_rxPush(rx, (const uint8_t*)frags[0].data(), frags[0].size()) == BLE_FRAME_PARTIAL);
+    CHECK(bleframe_rxPush(rx, (const uint8_t*)frags[2].data(), frags[2].size()) == BLE_FRAME_ERROR);
+  }
+
+  setup();
+
+  // 2) la app escribe un cmd de 4 KB fragmentado a MTU 23
+  sim_bleConnect(true);
+  std::string cmd = "{\"type\":\"relay\",\"vpin\":\"V0\",\"value\":1,\"pad\":\"";
+  cmd += pattern(MSG_MAX - cmd.size() - 2);
+  cmd += "\"}";
+  CHECK(cmd.size() == MSG_MAX);
+  CHECK(bleframe_send((const uint8_t*)cmd.data(), cmd.size(), 3, 20, toApp, nullptr));
+  run_for(50);
+  CHECK(sim_gpioLevel(RELAY_GPIO) == 1);
+
+  // 3) el peer habla framing: un notify de 4 KB llega entero en fragmentos
+  std::string big = pattern(MSG_MAX);
+  size_t from = sim_bleNotifyCount();
+  ble_notify(big.c_str());
+  std::string got;
+  CHECK(appReassemble(from, got) && got == big);
+  CHECK(sim_bleNotifyCount() - from > 256);
+
+  // 4) peer sin framing: nada truncado, un error que la app puede leer
+  sim_bleConnect(false);
+  sim_bleConnect(true);
+  sim_bleClearNotifies();
+  ble_notify(big.c_str());
+  CHECK(sim_bleNotifyCount() == 1 && sim_bleNotify(0) == "{\"err\":\"MTU\"}");   // a MTU 23 no cabe más
+
+  sim_bleSetMtu(100);
+  sim_bleClearNotifies();
+  ble_notify(big.c_str());
+  CHECK(sim_bleNotifyCount() == 1 &&
+        sim_bleNotify(0) == "{\"ok\":false,\"err\":\"MTU\",\"len\":4096,\"mtu\":100}");
+
+  // lo que cabe sigue yendo entero y sin cabecera
+  sim_bleClearNotifies();
+  ble_notify("{\"ok\":true}");
+  CHECK(sim_bleNotifyCount() == 1 && sim_bleNotify(0) == "{\"ok\":true}");
+
+  // 5) opt-in explícito: la app solo manda comandos cortos y avisa con
+  // "FRAMING"; desde ahí lo largo le llega fragmentado
+  sim_bleConnect(false);
+  sim_bleConnect(true);
+  sim_bleClearNotifies();
+  sim_bleWrite("FRAMING");
+  run_for(50);
+  CHECK(appReassemble(0, got) && got == "{\"ok\":true,\"type\":\"framing\",\"max\":4096}");
+  from = sim_bleNotifyCount();
+  ble_notify(big.c_str());
+  CHECK(appReassemble(from, got) && got == big);
+
+  // el opt-in es de la conexión
+  sim_bleConnect(false);
+  sim_bleConnect(true);
+  sim_bleClearNotifies();
+  ble_notify(big.c_str());
+  CHECK(sim_bleNotifyCount() == 1 && sim_bleNotify(0) == "{\"err\":\"MTU\"}");
+
+  // 6) INFO a una app sin framing con MTU 185: en partes, cada una un JSON
+  // completo que cabe; con MTU grande, entero
+  static const char* const INFO_KEYS[] = {
+    "\"heap\":", "\"rssi\":", "\"nvs_w\":", "\"wdt_starved\":", "\"stall\":", "\"loop_max\":",
+    "\"wdt_sec\":", "\"tls_full\":", "\"tls_resumed_ms\":", "\"p50\":[", "\"p99\":[",
+    "\"wifi\":", "\"wifi_direct\":[", "\"mqtt_watch\":",
+  };
+  sim_bleSetMtu(185);
+  sim_bleClearNotifies();
+  sim_bleWrite("INFO");
+  run_for(50);
+  std::string all;
+  size_t parts = 0;
+  for (size_t i = 0; i < sim_bleNotifyCount(); i++) {
+    const std::string& n = sim_bleNotify(i);
+    if (n.find("\"type\":\"info\"") == std::string::npos) continue;
+    char head[48];
+    snprintf(head, sizeof(head), "{\"ok\":true,\"type\":\"info\",\"part\":%u,\"parts\":5,", (unsigned)(parts + 1));
+    CHECK(n.size() <= 182 && n.compare(0, strlen(head), head) == 0 && n.back() == '}');
+    all += n;
+    parts++;
+  }
+  CHECK(parts == 5);
+  for (const char* k : INFO_KEYS) CHECK(all.find(k) != std::string::npos);
+
+  sim_bleSetMtu(517);
+  sim_bleClearNotifies();
+  sim_bleWrite("INFO");
+  run_for(50);
+  CHECK(sim_bleNotifyCount() == 1 && sim_bleNotify(0).size() > 182);
+  CHECK(sim_bleNotify(0).find("\"part\":") == std::string::npos);
+  for (const char* k : INFO_KEYS) CHECK(sim_bleNotify(0).find(k) != std::string::npos);
+
+  return TEST_END();
+}
@@ -0,0 +1,62 @@
+// test_config_store.cpp
+// Commits diferidos de config_store: una ráfaga de cambios es una sola
+// escritura, y una clave que cambia sin parar (un relé conmutado cada
+// segundo) se guarda igual como mucho CFG_MAX_DEFER_MS después de su
+// primer cambio sin guardar.
+
+#include "test_util.h"
+#include "config_store.h"
+
+// Pasadas del loop cada ms durante ms de reloj
+static void loopFor(unsigned long ms) {
+  for (unsigned long i = 0; i < ms; i++) {
+    cfg_loop();
+    sim_advanceMs(1);
+  }
+}
+
+int main() {
+  test_begin();
+  cfg_begin();
+
+  // 1) ráfaga: 5 cambios en 1 s, una escritura tras el retardo de la clave
+  uint32_t w0 = cfg_flashWrites();
+  for (uint32_t i = 1; i <= 5; i++) {
+    cfg_setU32(CFG_VPIN_STATE, i);
+    loopFor(200);
+  }
+  CHECK(cfg_flashWrites() == w0);
+  loopFor(5000);
+  CHECK(cfg_flashWrites() == w0 + 1);
+
+  // volver a lo que ya está en flash no escribe
+  cfg_setU32(CFG_VPIN_STATE, 6);
+  cfg_setU32(CFG_VPIN_STATE, 5);
+  loopFor(10000);
+  CHECK(cfg_flashWrites() == w0 + 1);
+
+  // 2) dos relés conmutando cada segundo durante 60 s: el retardo de 5 s
+  // nunca se cumple, pero el tope desde el primer cambio sí
+  w0 = cfg_flashWrites();
+  unsigned long t0 = millis();
+  unsigned long firstWriteMs = 0;
+  for (uint32_t i = 0; i < 60; i++) {
+    cfg_setU32(CFG_VPIN_STATE, i % 2 ? 0x1u : 0x2u);
+    for (int ms = 0; ms < 1000; ms++) {
+      cfg_loop();
+      if (!firstWriteMs && cfg_flashWrites() != w0) firstWriteMs = millis() - t0;
+      sim_advanceMs(1);
+    }
+  }
+  CHECK(cfg_flashWrites() >= w0 + 1);
+  CHECK(firstWriteMs > 0 && firstWriteMs <= CFG_MAX_DEFER_MS + 1000);
+  // y sigue siendo poco: una escritura cada CFG_MAX_DEFER_MS, no una por toggle
+  CHECK(cfg_flashWrites() - w0 <= 60000 / CFG_MAX_DEFER_MS + 1);
+
+  // parado: lo último queda en flash tras el retardo normal
+  uint32_t w1 = cfg_flashWrites();
+  loopFor(5000);
+  CHECK(cfg_flashWrites() == w1 + 1);
+
+  return TEST_END();
+}
@@ -0,0 +1,68 @@
+// test_latency.cpp
+// Percentiles de latency.h: un percentil que cae en el bucket abierto
+// (más de LAT_OPEN_US) no sale como 4294967295 sino como la cota
+// inferior, marcada "_gt" en las métricas y tope en INFO.
+
+#include "test_util.h"
+#include "latency.h"
+#include <string>
+
+static bool contains(const std::string& s, const char* part) {
+  return s.find(part) != std::string::npos;
+}
+
+// Un comando cuyo dispatch tardó us desde el ingress
+static void sample(LatStage stage, uint32_t us) {
+  lat_begin((uint32_t)micros() - us);
+  lat_mark(stage);
+  lat_end();
+}
+
+int main() {
+  test_begin();
+
+  bool over = true;
+  CHECK(lat_percentileUs(LAT_DISPATCH, 99, &over) == 0 && !over);
+
+  // 99 rápidos y 1 de 3 s: p50 medido, p99 en el bucket abierto
+  for (int i = 0; i < 99; i++) sample(LAT_DISPATCH, 80);
+  sample(LAT_DISPATCH, 3000000);
+  CHECK(lat_percentileUs(LAT_DISPATCH, 50, &over) == 100 && !over);
+  CHECK(lat_percentileUs(LAT_DISPATCH, 100, &over) == LAT_OPEN_US && over);
+
+  // 1 de 600 ms cae en el último bucket cerrado: misma cota, sin marca
+  sample(LAT_GPIO, 600000);
+  CHECK(lat_percentileUs(LAT_GPIO, 99, &over) == LAT_OPEN_US && !over);
+
+  char buf[1024];
+  size_t n = lat_renderJson(buf, sizeof(buf));
+  CHECK(n > 0);
+  std::string json(buf, n);
+  CHECK(contains(json, "\"dispatch\":{\"n\":100,\"p50\":100,\"p99\":100,"));
+  CHECK(contains(json, "\"gpio\":{\"n\":1,\"p50\":1000000,\"p99\":1000000,"));
+  CHECK(!contains(json, "4294967295"));
+
+  lat_reset();
+  sample(LAT_DISPATCH, 3000000);
+  n = lat_renderJson(buf, sizeof(buf));
+  json.assign(buf, n);
+  CHECK(contains(json, "\"dispatch\":{\"n\":1,\"p50_gt\":1000000,\"p99_gt\":1000000,"));
+
+  // INFO por BLE: el tope, nunca UINT32_MAX
+  setup();
+  lat_reset();
+  sample(LAT_DISPATCH, 3000000);
+  sim_bleConnect(true);
+  sim_bleSetMtu(517);
+  sim_bleClearNotifies();   // el READY de la conexión
+  sim_bleWrite("INFO");
+  run_for(50);
+  CHECK(sim_bleNotifyCount() > 0);
+  if (sim_bleNotifyCount() > 0) {
+    const std::string& info = sim_bleNotify(0);
+    CHECK(contains(info, "\"p99\":[1000000,"));
+    CHECK(!contains(info, "4294967295"));
+  }
+
+  return TEST_END();
+}
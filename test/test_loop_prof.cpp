@@ -0,0 +1,98 @@
+// test_loop_prof.cpp
+// Watchdog de loop_prof contra el WDT falso: una vuelta rápida suelta
+// no cura un hang, y la misma sección colgada una y otra vez deja de
+// alimentarlo hasta que resetea. Tras un hang largo, el loop ocioso se
+// recupera dentro del timeout.
+
+#include "test_util.h"
+#include "loop_prof.h"
+#include "loop_wake.h"
+
+// Una vuelta del loop con una sección que tarda ms
+static void loopWith(ProfSection s, uint32_t ms) {
+  prof_loopStart();
+  prof_enter(s);
+  sim_advanceMs(ms);
+  prof_exit(s);
+  prof_loopEnd();
+}
+
+static void quickLoop() {
+  loopWith(PROF_BLE, 1);
+}
+
+// Vuelta ociosa de verdad: duerme en wake_wait() lo que pida el loop
+static void idleLoop() {
+  prof_loopStart();
+  prof_loopEnd();
+  wake_wait();
+}
+
+static bool starved() {
+  ProfReport r;
+  prof_getReport(r);
+  return r.wdtStarved;
+}
+
+int main() {
+  test_begin();
+
+  // 1) sano: cada vuelta alimenta
+  prof_begin();
+  uint32_t f0 = sim_wdtFeeds();
+  for (int i = 0; i < 5; i++) quickLoop();
+  CHECK(sim_wdtFeeds() == f0 + 5);
+  CHECK(!starved());
+
+  // 2) hang: sin feed hasta PROF_RECOVER_LOOPS vueltas sin stall
+  f0 = sim_wdtFeeds();
+  loopWith(PROF_MQTT_CONN, PROF_HANG_MS);
+  CHECK(starved());
+  loopWith(PROF_MQTT_CONN, PROF_STALL_MS);   // un stall no cuenta como sana
+  for (int i = 0; i < PROF_RECOVER_LOOPS - 1; i++) quickLoop();
+  CHECK(sim_wdtFeeds() == f0);
+  quickLoop();
+  CHECK(sim_wdtFeeds() == f0 + 1);
+  CHECK(!starved());
+
+  // 3) hang + una vuelta rápida, en bucle: el watchdog vence
+  prof_begin();
+  for (int i = 0; i < 3 && !sim_wdtExpired(); i++) {
+    loopWith(i % 2 ? PROF_BOOTSTRAP : PROF_WIFI, PROF_HANG_MS);
+    quickLoop();
+  }
+  CHECK(sim_wdtExpired());
+
+  // 4) la misma sección colgada PROF_HANG_REPEAT veces: atascado aunque
+  // entre medio haya vueltas sanas de sobra
+  prof_begin();
+  for (int h = 0; h < PROF_HANG_REPEAT; h++) {
+    loopWith(PROF_MQTT_CONN, PROF_HANG_MS);
+    for (int i = 0; i < PROF_RECOVER_LOOPS + 2; i++) quickLoop();
+  }
+  CHECK(starved());
+  f0 = sim_wdtFeeds();
+  for (int i = 0; i < 40 && !sim_wdtExpired(); i++) loopWith(PROF_BLE, 1000);
+  CHECK(sim_wdtFeeds() == f0);
+  CHECK(sim_wdtExpired());
+
+  // 5) hang largo (25 s) con el loop ocioso después: las vueltas de
+  // recuperación no esperan WAKE_MAX_IDLE_MS y el watchdog se alimenta
+  // antes de vencer
+  prof_begin();
+  wake_begin();
+  loopWith(PROF_BOOTSTRAP, 25000);
+  CHECK(starved());
+  f0 = sim_wdtFeeds();
+  for (int i = 0; i < 20 && sim_wdtFeeds() == f0 && !sim_wdtExpired(); i++) idleLoop();
+  CHECK(sim_wdtFeeds() > f0);
+  CHECK(!sim_wdtExpired());
+  CHECK(!starved());
+
+  // sano otra vez: el loop ocioso vuelve a dormir el tope entero
+  unsigned long t0 = millis();
+  idleLoop();
+  CHECK(millis() - t0 >= WAKE_MAX_IDLE_MS);
+
+  return TEST_END();
+}
@@ -0,0 +1,222 @@
+// test_net_loopback.cpp
+// Cadena completa en host: WiFi falso -> bootstrap contra el servidor
+// HTTP falso -> MQTT contra el broker falso -> cmd -> GPIO, estado y ack;
+// después, caída del broker y reconexión, y un comando BLE. El servidor
+// de bootstrap tarda en contestar: el loop no lo espera.
+
+#include "test_util.h"
+#include "http_server_fake.h"
+#include "mqtt_broker_fake.h"
+#include "net_wifi_mqtt.h"
+#include "vpin_registry.h"
+#include <string>
+
+#define RELAY_GPIO 26
+#define TENANT     "77ec876c-b9f7-4170-a70a-647d85f58216"
+#define DEVICE_ID  "5b1f0c8e-0000-4000-8000-00000000c0de"
+
+#define BOOT_LATENCY_MS   3000
+#define LOOP_BLOCK_MAX_US 5000
+
+static const std::string CMD_TOPIC   = "nebadoncmd/" TENANT "/" DEVICE_ID "/cmd";
+static const std::string STATE_TOPIC = "nebadondevice/" TENANT "/" DEVICE_ID "/dt";
+static const std::string ACK_TOPIC   = "nebadondevice/" TENANT "/" DEVICE_ID "/ack";
+
+static bool contains(const std::string& s, const char* part) {
+  return s.find(part) != std::string::npos;
+}
+
+int main() {
+  test_begin();
+
+  sim_wifiAddAp("Casa", "clave-casa", -55, 6);
+  sim_kvPutString("nebadon", "ssid", "Casa");
+  sim_kvPutString("nebadon", "pass", "clave-casa");
+
+  HttpServerFake api;
+  api.latencyMs = BOOT_LATENCY_MS;
+  api.handler = [](const HttpServerFake::Request& req, std::string& body) {
+    (void)req;
+    // la app pregunta mientras el servidor piensa la respuesta
+    sim_bleWrite("STATUS");
+    body = "{\"ok\":true,\"device_id\":\"" DEVICE_ID "\",\"payload\":\"json\"}";
+    return 201;
+  };
+  loopback_listen("api.nebadon.cloud", 443, &api);
+
+  MqttBrokerFake broker;
+  broker.requiredUser = "neb_mqtt";
+  loopback_listen("mqtt.nebadon.cloud", 8883, &broker);
+
+  setup();
+  sim_bleConnect(true);
+  sim_bleSetMtu(517);
+
+  // 1) WiFi + bootstrap + MQTT. Mientras el bootstrap espera al servidor
+  // (en su tarea) el loop sigue atendiendo BLE y ninguna pasada bloquea.
+  uint64_t worstUs = 0;
+  unsigned long askedMs = 0;
+  bool statusDuringBoot = false;
+  unsigned long t0 = millis();
+  while (!net_isConnected() && millis() - t0 < 30000) {
+    uint64_t b0 = sim_blockedUs();
+    loop();
+    uint64_t dt = sim_blockedUs() - b0;
+    if (dt > worstUs) worstUs = dt;
+    if (!askedMs && !api.requests.empty()) askedMs = millis();
+    for (size_t i = 0; i < sim_bleNotifyCount(); i++) {
+      if (contains(sim_bleNotify(i), "\"wifi\":1,\"mqtt\":0")) statusDuringBoot = true;
+    }
+  }
+  sim_bleConnect(false);
+  CHECK(net_isConnected());
+  CHECK(statusDuringBoot);
+  CHECK(askedMs && millis() - askedMs >= BOOT_LATENCY_MS - 100);
+  CHECK(worstUs <= LOOP_BLOCK_MAX_US);
+  CHECK(api.requests.size() == 1);
+  if (!api.requests.empty()) {
+    const HttpServerFake::Request& r = api.requests[0];
+    CHECK(r.method == "POST");
+    CHECK(r.path == "/devices/bootstrap");
+    CHECK(r.header("x-api-key") == "3f6a4cd5a8f3d8930f988ba12b9b8dfa");
+    CHECK(contains(r.body, "\"tenant_id\":\"" TENANT "\""));
+    CHECK(contains(r.body, "\"mac_address\":\"40:4C:CA:12:34:56\""));
+    CHECK(contains(r.body, "\"payloads\":\"json,cbor\""));
+  }
+  CHECK(broker.connects == 1);
+  CHECK(broker.isSubscribed(CMD_TOPIC));
+  CHECK(broker.isSubscribed(CMD_TOPIC + "/cbor"));
+  CHECK(sim_tlsHandshakes() == 2);   // bootstrap + MQTT
+
+  // publishAll() al conectar: el relé arranca apagado
+  const MqttBrokerFake::Message* st = broker.lastOn(STATE_TOPIC);
+  CHECK(st && contains(st->payload, "\"vpin\":\"V0\",\"value\":0}"));
+
+  // 2) cmd QoS 1 -> GPIO, estado y ack
+  size_t states = broker.countOn(STATE_TOPIC);
+  CHECK(broker.publish(CMD_TOPIC, "{\"type\":\"cmd\",\"tenant_id\":\"" TENANT "\",\"vpin\":\"V0\",\"value\":1,\"cmd_id\":\"c-1\"}", 1) == 1);
+  CHECK(run_until([&] { return broker.countOn(ACK_TOPIC) == 1; }, 2000));
+  CHECK(sim_gpioLevel(RELAY_GPIO) == 1);
+  CHECK(broker.countOn(STATE_TOPIC) == states + 1);
+  st = broker.lastOn(STATE_TOPIC);
+  CHECK(st && contains(st->payload, "\"value\":1}"));
+  const MqttBrokerFake::Message* ack = broker.lastOn(ACK_TOPIC);
+  CHECK(ack && contains(ack->payload, "\"cmd_id\":\"c-1\",\"ok\":1,\"dup\":0"));
+  CHECK(broker.pubacks == 1);
+
+  // cmd_id numérico: el ack lo devuelve como número, en JSON y en CBOR
+  CHECK(broker.publish(CMD_TOPIC, "{\"type\":\"cmd\",\"vpin\":\"V0\",\"value\":1,\"cmd_id\":42}", 1) == 1);
+  CHECK(run_until([&] { return broker.countOn(ACK_TOPIC) == 2; }, 2000));
+  ack = broker.lastOn(ACK_TOPIC);
+  CHECK(ack && contains(ack->payload, "\"cmd_id\":42,\"ok\":1,\"dup\":0"));
+
+  static const uint8_t cborCmd[] = { 0xA3, 0x01, 0x00, 0x02, 0x01, 0x03, 0x18, 0x2B };   // {1:0, 2:1, 3:43}
+  CHECK(broker.publish(CMD_TOPIC + "/cbor", cborCmd, sizeof(cborCmd), 1) == 1);
+  CHECK(run_until([&] { return broker.countOn(ACK_TOPIC + "/cbor") == 1; }, 2000));
+  ack = broker.lastOn(ACK_TOPIC + "/cbor");
+  CHECK(ack && ack->payload.compare(0, 4, "\xA4\x03\x18\x2B") == 0);   // {3: 43, ...}
+  CHECK(broker.pubacks == 3);
+
+  // solo "V<n>" exacto es un vpin: el cmd con "v0" no toca el relé
+  CHECK(vpin_parseIndex("V0") == 0 && vpin_parseIndex("V12") == 12);
+  CHECK(vpin_parseIndex("v0") < 0 && vpin_parseIndex("V00") < 0 && vpin_parseIndex("V007") < 0);
+  CHECK(broker.publish(CMD_TOPIC, "{\"type\":\"cmd\",\"vpin\":\"v0\",\"value\":0,\"cmd_id\":\"c-2\"}", 1) == 1);
+  CHECK(run_until([&] { return broker.countOn(ACK_TOPIC) == 3; }, 2000));
+  ack = broker.lastOn(ACK_TOPIC);
+  CHECK(ack && contains(ack->payload, "\"cmd_id\":\"c-2\",\"ok\":0"));
+  CHECK(sim_gpioLevel(RELAY_GPIO) == 1);
+
+  // dedup por formato + tipo + bytes: el repetido se confirma sin aplicar
+  CHECK(broker.publish(CMD_TOPIC, "{\"type\":\"cmd\",\"vpin\":\"V0\",\"value\":0,\"cmd_id\":\"c-1\"}", 1) == 1);
+  CHECK(run_until([&] { return broker.countOn(ACK_TOPIC) == 4; }, 2000));
+  ack = broker.lastOn(ACK_TOPIC);
+  CHECK(ack && contains(ack->payload, "\"cmd_id\":\"c-1\",\"ok\":1,\"dup\":1"));
+  CHECK(sim_gpioLevel(RELAY_GPIO) == 1);
+
+  // "42" no es 42, y 42 otra vez sí es repetido
+  CHECK(broker.publish(CMD_TOPIC, "{\"type\":\"cmd\",\"vpin\":\"V0\",\"value\":1,\"cmd_id\":\"42\"}", 1) == 1);
+  CHECK(run_until([&] { return broker.countOn(ACK_TOPIC) == 5; }, 2000));
+  CHECK(contains(broker.lastOn(ACK_TOPIC)->payload, "\"cmd_id\":\"42\",\"ok\":1,\"dup\":0"));
+  CHECK(broker.publish(CMD_TOPIC, "{\"type\":\"cmd\",\"vpin\":\"V0\",\"value\":1,\"cmd_id\":42}", 1) == 1);
+  CHECK(run_until([&] { return broker.countOn(ACK_TOPIC) == 6; }, 2000));
+  CHECK(contains(broker.lastOn(ACK_TOPIC)->payload, "\"cmd_id\":42,\"ok\":1,\"dup\":1"));
+
+  // el mismo 42 en CBOR es otro cmd
+  static const uint8_t cborCmd42[] = { 0xA3, 0x01, 0x00, 0x02, 0x01, 0x03, 0x18, 0x2A };   // {1:0, 2:1, 3:42}
+  CHECK(broker.publish(CMD_TOPIC + "/cbor", cborCmd42, sizeof(cborCmd42), 1) == 1);
+  CHECK(run_until([&] { return broker.countOn(ACK_TOPIC + "/cbor") == 2; }, 2000));
+  ack = broker.lastOn(ACK_TOPIC + "/cbor");
+  CHECK(ack && ack->payload.compare(0, 8, "\xA4\x03\x18\x2A\x04\xF5\x05\xF4") == 0);   // ok, sin dup
+
+  // mismo FNV-1a de 32 bits, ids distintos: no es repetido
+  CHECK(broker.publish(CMD_TOPIC, "{\"type\":\"cmd\",\"vpin\":\"V0\",\"value\":1,\"cmd_id\":\"costarring\"}", 1) == 1);
+  CHECK(broker.publish(CMD_TOPIC, "{\"type\":\"cmd\",\"vpin\":\"V0\",\"value\":1,\"cmd_id\":\"liquid\"}", 1) == 1);
+  CHECK(run_until([&] { return broker.countOn(ACK_TOPIC) == 8; }, 2000));
+  CHECK(contains(broker.lastOn(ACK_TOPIC)->payload, "\"cmd_id\":\"liquid\",\"ok\":1,\"dup\":0"));
+
+  // el relé se persiste tras su retardo de commit
+  uint32_t writes = sim_kvWrites();
+  run_for(6000);
+  CHECK(sim_kvWrites() > writes);
+
+  // 3) el broker se cae y vuelve: reconexión sin re-bootstrap
+  broker.up = false;
+  broker.dropAll();
+  CHECK(run_until([] { return !net_isConnected(); }, 1000));
+  run_for(3000);
+  broker.up = true;
+  CHECK(run_until([] { return net_isConnected(); }, 180000));
+  CHECK(broker.connects == 2);
+  CHECK(api.requests.size() == 1);
+  CHECK(sim_tlsHandshakes() == 2);   // la reconexión reanuda la sesión MQTT
+  CHECK(sim_tlsResumed() == 1);
+
+  // el broker reinicia sin sus sesiones: la siguiente vuelve a ser completa
+  sim_tlsDropSessions();
+  broker.dropAll();
+  CHECK(run_until([] { return !net_isConnected(); }, 1000));
+  CHECK(run_until([] { return net_isConnected(); }, 180000));
+  CHECK(broker.connects == 3);
+  CHECK(sim_tlsHandshakes() == 3);
+  CHECK(sim_tlsResumed() == 1);
+
+  // 4) BLE: STATUS ve MQTT conectado y el relé encendido
+  sim_bleConnect(true);
+  sim_bleSetMtu(517);
+  sim_bleWrite("STATUS");
+  run_for(50);
+  bool statusOk = false;
+  for (size_t i = 0; i < sim_bleNotifyCount(); i++) {
+    if (contains(sim_bleNotify(i), "\"type\":\"status\",\"wifi\":1,\"mqtt\":1,\"relay\":1")) statusOk = true;
+  }
+  CHECK(statusOk);
+
+  // INFO cuenta los mismos handshakes
+  sim_bleClearNotifies();
+  sim_bleWrite("INFO");
+  run_for(50);
+  CHECK(sim_bleNotifyCount() > 0 && contains(sim_bleNotify(0), "\"tls_full\":3,"));
+  CHECK(sim_bleNotifyCount() > 0 && contains(sim_bleNotify(0), "\"tls_resumed\":1,"));
+  // el loopback no tiene descriptor: net_loop sondea
+  CHECK(sim_bleNotifyCount() > 0 && contains(sim_bleNotify(0), "\"mqtt_watch\":0}"));
+
+  // relay por BLE: "value" tiene que ser un entero JSON
+  static const char* const BAD_VALUES[] = {
+    "{\"type\":\"relay\",\"value\":\"0\"}",
+    "{\"type\":\"relay\",\"value\":false}",
+    "{\"value\":0.0}",
+  };
+  for (const char* cmd : BAD_VALUES) {
+    sim_bleClearNotifies();
+    sim_bleWrite(cmd);
+    run_for(50);
+    CHECK(sim_bleNotifyCount() > 0 && contains(sim_bleNotify(0), "\"err\":\"RELAY_VALUE_INVALID\""));
+  }
+  CHECK(sim_gpioLevel(RELAY_GPIO) == 1);
+  sim_bleClearNotifies();
+  sim_bleWrite("{\"type\":\"relay\",\"value\":0}");
+  run_for(50);
+  CHECK(sim_gpioLevel(RELAY_GPIO) == 0);
+
+  return TEST_END();
+}
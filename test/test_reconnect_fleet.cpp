@@ -0,0 +1,121 @@
+// test_reconnect_fleet.cpp
+// N equipos contra el mismo broker: el broker se cae, vuelve, y las
+// reconexiones deben repartirse en el tiempo (backoff con jitter de
+// net_supervisor) en vez de llegar todas en la misma ventana.
+//
+// El estado del firmware es estático, así que cada equipo es un proceso
+// (fork antes de setup()) con su propia semilla; todos comparten el mismo
+// guion de reloj simulado y el padre junta los instantes de reconexión.
+
+#include "test_util.h"
+#include "http_server_fake.h"
+#include "mqtt_broker_fake.h"
+#include "net_wifi_mqtt.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#define FLEET_N        48
+#define FLEET_DOWN_MS  90000UL    // broker caído
+#define FLEET_MAX_MS   300000UL   // tope para reconectar tras volver
+
+struct FleetTrace {
+  int32_t  reconnectMs;   // desde que vuelve el broker; -1 = no reconectó
+  uint32_t attemptsDown;  // intentos TCP con el broker caído
+};
+
+static FleetTrace runDevice(uint32_t seed) {
+  FleetTrace t = { -1, 0 };
+  test_begin();
+  sim_seed(seed);
+
+  sim_wifiAddAp("Casa", "clave-casa", -55, 6);
+  sim_kvPutString("nebadon", "ssid", "Casa");
+  sim_kvPutString("nebadon", "pass", "clave-casa");
+
+  HttpServerFake api;
+  api.handler = [](const HttpServerFake::Request& req, std::string& body) {
+    (void)req;
+    body = "{\"ok\":true,\"device_id\":\"5b1f0c8e-0000-4000-8000-00000000c0de\",\"payload\":\"json\"}";
+    return 201;
+  };
+  loopback_listen("api.nebadon.cloud", 443, &api);
+
+  MqttBrokerFake broker;
+  loopback_listen("mqtt.nebadon.cloud", 8883, &broker);
+
+  setup();
+  if (!run_until([] { return net_isConnected(); }, 30000)) return t;
+
+  // todos los equipos pierden el broker en el mismo instante simulado y
+  // vuelve a aceptar en otro instante fijo (no en el borde de un loop())
+  while (millis() < 60000) loop();
+  const unsigned long upMs = 60000 + FLEET_DOWN_MS;
+  broker.downUntilMs = upMs;
+  broker.dropAll();
+  size_t before = broker.attemptsMs.size();
+
+  if (run_until([] { return net_isConnected(); }, FLEET_DOWN_MS + FLEET_MAX_MS)) {
+    for (size_t i = before; i < broker.attemptsMs.size(); i++) {
+      unsigned long a = broker.attemptsMs[i];
+      if (a < upMs) { t.attemptsDown++; continue; }
+      // el primer intento con el broker arriba es el que conecta
+      t.reconnectMs = (int32_t)(a - upMs);
+      break;
+    }
+  }
+  return t;
+}
+
+int main() {
+  std::vector<FleetTrace> fleet;
+
+  for (int i = 0; i < FLEET_N; i++) {
+    int fd[2];
+    if (pipe(fd) != 0) return 1;
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fd[0]);
+      FleetTrace t = runDevice(0x9e3779b9u * (uint32_t)(i + 1));
+      ssize_t w = write(fd[1], &t, sizeof(t));
+      _exit(w == (ssize_t)sizeof(t) ? 0 : 1);
+    }
+    close(fd[1]);
+    FleetTrace t = { -1, 0 };
+    ssize_t r = read(fd[0], &t, sizeof(t));
+    close(fd[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    CHECK(r == (ssize_t)sizeof(t) && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    fleet.push_back(t);
+  }
+
+  // todos vuelven, y con el broker caído nadie martillea: un reintento
+  // fijo de 1 s serían FLEET_DOWN_MS / 1000 intentos por equipo
+  int32_t first = INT32_MAX, last = -1;
+  for (const FleetTrace& t : fleet) {
+    CHECK(t.reconnectMs >= 0);
+    CHECK(t.attemptsDown > 0 && t.attemptsDown < FLEET_DOWN_MS / 1000 / 3);
+    if (getenv("NEB_VERBOSE")) printf("  down=%u reconnect=%ldms\n", t.attemptsDown, (long)t.reconnectMs);
+    if (t.reconnectMs < 0) continue;
+    if (t.reconnectMs < first) first = t.reconnectMs;
+    if (t.reconnectMs > last)  last  = t.reconnectMs;
+  }
+
+  // reparto: histograma por segundo tras la vuelta del broker. Con un
+  // reintento fijo (sin jitter) la flota entera cae en el mismo segundo.
+  std::vector<int> perSec(FLEET_MAX_MS / 1000 + 1, 0);
+  int peak = 0;
+  for (const FleetTrace& t : fleet) {
+    if (t.reconnectMs < 0) continue;
+    int& b = perSec[t.reconnectMs / 1000];
+    if (++b > peak) peak = b;
+  }
+  printf("fleet: n=%d first=%ldms last=%ldms peak=%d/s\n",
+         FLEET_N, (long)first, (long)last, peak);
+
+  CHECK(peak <= FLEET_N / 6);
+  CHECK(last - first >= 20000);
+
+  return TEST_END();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <Arduino.h>
+#include "sim.h"
+
+// Aserciones mínimas de los tests nativos: cada test es un ejecutable y
+// ctest mira el código de salida.
+
+static int _testFails = 0;
+
+#define CHECK(cond) do {                                                  \
+    if (!(cond)) {                                                        \
+      fprintf(stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond);   \
+      _testFails++;                                                       \
+    }                                                                     \
+  } while (0)
+
+#define TEST_END() (_testFails ? (fprintf(stderr, "FAIL (%d)\n", _testFails), 1) \
+                               : (printf("OK\n"), 0))
+
+// Reloj simulado y Serial en silencio (NEB_VERBOSE=1 muestra los logs)
+static inline void test_begin() {
+  sim_setClock(SIM_CLOCK_MANUAL);
+  sim_serialMute(getenv("NEB_VERBOSE") == nullptr);
+}
+
+// El sketch (driver.ino)
+void setup();
+void loop();
+
+// loop() hasta que cond() se cumpla o pasen maxMs de reloj
+template <typename F>
+static inline bool run_until(F cond, uint32_t maxMs) {
+  unsigned long t0 = millis();
+  while (!cond()) {
+    if (millis() - t0 > maxMs) return false;
+    loop();
+  }
+  return true;
+}
+
+static inline void run_for(uint32_t ms) {
+  run_until([] { return false; }, ms);
+}
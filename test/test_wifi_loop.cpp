@@ -0,0 +1,105 @@
+// test_wifi_loop.cpp
+// La máquina de estados WiFi no bloquea el loop: con el AP inalcanzable
+// ninguna pasada de loop() espera más de unos ms y BLE sigue
+// respondiendo. Re-provisionar con el driver aún reportando el AP viejo
+// no da GOT_IP hasta que el intento nuevo tiene IP. El provisioning BLE
+// termina en MQTT_OK, WIFI_FAIL o TIMEOUT. Volver a una red por el
+// BSSID/canal del último escaneo cuenta como asociación dirigida.
+
+#include "test_util.h"
+#include "config_store.h"
+#include "net_wifi_mqtt.h"
+#include <string>
+
+#define LOOP_BLOCK_MAX_US 5000
+
+static bool contains(const std::string& s, const char* part) {
+  return s.find(part) != std::string::npos;
+}
+
+static bool bleSaw(const char* part) {
+  for (size_t i = 0; i < sim_bleNotifyCount(); i++) {
+    if (contains(sim_bleNotify(i), part)) return true;
+  }
+  return false;
+}
+
+int main() {
+  test_begin();
+
+  sim_wifiAddAp("Casa", "clave-casa", -55, 6);
+  sim_wifiAddAp("Taller", "clave-taller", -70, 11);
+  sim_wifiSetApUp("Casa", false);
+  sim_kvPutString("nebadon", "ssid", "Casa");
+  sim_kvPutString("nebadon", "pass", "clave-casa");
+
+  setup();
+  sim_bleConnect(true);
+  sim_bleSetMtu(517);   // la app negocia MTU, como un móvil
+
+  // 1) AP caído 120 s: reintentos con backoff, cada pasada vuelve enseguida
+  uint64_t worstUs = 0;
+  unsigned long t0 = millis();
+  while (millis() - t0 < 120000) {
+    uint64_t b0 = sim_blockedUs();
+    loop();
+    uint64_t dt = sim_blockedUs() - b0;
+    if (dt > worstUs) worstUs = dt;
+  }
+  CHECK(worstUs <= LOOP_BLOCK_MAX_US);
+  CHECK(sim_wifiBegins() > 3);
+  CHECK(!net_isWifiConnected());
+
+  // BLE atiende en la misma pasada aunque WiFi siga fallando
+  sim_bleClearNotifies();
+  sim_bleWrite("STATUS");
+  CHECK(run_until([] { return bleSaw("\"type\":\"status\",\"wifi\":0"); }, 20));
+
+  // 2) el AP vuelve: conecta y guarda su enlace
+  sim_wifiSetApUp("Casa", true);
+  CHECK(run_until([] { return net_isWifiConnected(); }, 120000));
+  run_for(100);
+  CHECK(strcmp(cfg_getStr(CFG_WIFI_LINK_SSID), "Casa") == 0);
+  CHECK(cfg_getU32(CFG_WIFI_CH) == 6);
+  NetWifiStats ws;
+  net_getWifiStats(ws);
+  CHECK(ws.lastPath == NET_WIFI_FULL && ws.fullOk == 1);
+
+  // 3) re-provisioning: el driver reporta el AP viejo 2 s más
+  sim_wifiSetStaleMs(2000);
+  sim_bleWrite("WIFI:Taller|clave-taller");
+  CHECK(run_until([] { return sim_wifiLinkSsid()[0] == '\0'; }, 5000));
+  CHECK(strcmp(cfg_getStr(CFG_WIFI_LINK_SSID), "Casa") == 0);  // sin GOT_IP con el viejo
+
+  CHECK(run_until([] { return strcmp(sim_wifiLinkSsid(), "Taller") == 0; }, 15000));
+  run_for(100);
+  CHECK(strcmp(cfg_getStr(CFG_WIFI_LINK_SSID), "Taller") == 0);
+  CHECK(cfg_getU32(CFG_WIFI_CH) == 11);
+  CHECK(net_isWifiConnected());
+
+  // 4) sin servidor de bootstrap no llega MQTT_OK: la app recibe TIMEOUT
+  CHECK(bleSaw("\"status\":\"WIFI_OK\""));
+  CHECK(run_until([] { return bleSaw("\"status\":\"TIMEOUT\""); }, 125000));
+
+  // 5) la ronda entera falla: WIFI_FAIL cierra el provisioning y lo que
+  // pase después ya no se reenvía
+  sim_wifiSetApUp("Casa", false);
+  sim_wifiSetApUp("Taller", false);
+  sim_bleClearNotifies();
+  sim_bleWrite("WIFI:Taller|clave-taller");
+  CHECK(run_until([] { return bleSaw("\"status\":\"WIFI_FAIL\""); }, 60000));
+  sim_wifiSetApUp("Taller", true);
+  CHECK(run_until([] { return net_isWifiConnected(); }, 300000));
+  run_for(1000);
+  CHECK(!bleSaw("\"status\":\"WIFI_OK\""));
+
+  // la ronda escaneó y vuelve a Taller por el BSSID/canal que vio: es una
+  // asociación dirigida, no un escaneo completo
+  net_getWifiStats(ws);
+  CHECK(ws.lastPath == NET_WIFI_SCANNED && ws.scannedOk == 1 && ws.fullOk == 2);
+  sim_bleClearNotifies();
+  sim_bleWrite("INFO");
+  CHECK(run_until([] { return bleSaw("\"wifi\":\"scanned:"); }, 20));
+
+  return TEST_END();
+}
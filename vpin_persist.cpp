@@ -0,0 +1,48 @@
+// vpin_persist.cpp
+// Estado de vpins en RTC + NVS (ver vpin_persist.h)
+
+#include "vpin_persist.h"
+#include "config_store.h"
+#include "neb_log.h"
+#include "hal.h"
+
+#define VPIN_RTC_MAGIC 0x5650494Eu   // "VPIN"
+
+// Sin inicializar en ningún reset: se valida con magic + complemento
+struct VpinRtc {
+  uint32_t magic;
+  uint32_t bits;
+  uint32_t check;   // ~bits
+};
+
+RTC_NOINIT_ATTR static VpinRtc _rtc;
+
+static bool rtcValid() {
+  return _rtc.magic == VPIN_RTC_MAGIC && _rtc.check == ~_rtc.bits;
+}
+
+static void rtcStore(uint32_t bits) {
+  _rtc.bits = bits;
+  _rtc.check = ~bits;
+  _rtc.magic = VPIN_RTC_MAGIC;
+}
+
+uint32_t vpin_persistRestore() {
+  uint32_t bits;
+  if (!hal_resetWasPowerOn() && rtcValid()) {
+    bits = _rtc.bits;
+    LOGI("♻️ vpins desde RTC: 0x%08lx", (unsigned long)bits);
+    // NVS al día por si el próximo arranque es en frío
+    cfg_setU32(CFG_VPIN_STATE, bits);
+  } else {
+    bits = cfg_getU32(CFG_VPIN_STATE);
+    LOGI("♻️ vpins desde NVS: 0x%08lx", (unsigned long)bits);
+    rtcStore(bits);
+  }
+  return bits;
+}
+
+void vpin_persistSave(uint32_t bits) {
+  rtcStore(bits);
+  cfg_setU32(CFG_VPIN_STATE, bits);
+}
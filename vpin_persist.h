@@ -0,0 +1,12 @@
+#pragma once
+#include <Arduino.h>
+
+// Estado de los vpins entre reinicios (bit i = vpin i encendido).
+// Cada cambio va al instante a RTC (sobrevive a resets en caliente:
+// watchdog, panic, restart) y, con retardo, a NVS vía config_store
+// (sobrevive a cortes de luz). Al arrancar manda RTC si es válida.
+
+// Estado a restaurar; llamar antes de arrancar la red
+uint32_t vpin_persistRestore();
+
+void vpin_persistSave(uint32_t bits);
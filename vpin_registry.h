@@ -0,0 +1,56 @@
+#pragma once
+#include <Arduino.h>
+
+// Registro de virtual pins declarado en compilación.
+// La tabla la define el sketch; el índice de cada entrada es el número
+// del vpin ("V3" -> VPINS[3]), así que resolver un nombre es O(1) y
+// no crea Strings.
+
+enum VpinType : uint8_t {
+  VPIN_DIGITAL_OUT = 0,   // GPIO on/off (relay)
+};
+
+struct VpinDef;
+
+// Aplica value al hardware; devuelve el valor efectivo (normalizado)
+typedef int (*VpinHandler)(const VpinDef& def, int value);
+
+struct VpinDef {
+  const char* name;     // "V0", "V1", ...
+  uint8_t gpio;
+  VpinType type;
+  VpinHandler handler;
+};
+
+// "V<n>" -> n; -1 si no tiene exactamente esa forma. Igual que el nombre
+// de la tabla: "v0", "V00" o "V007" no son vpins.
+inline int vpin_parseIndex(const char* s, size_t len) {
+  if (!s || len < 2 || len > 4) return -1;
+  if (s[0] != 'V') return -1;
+  if (s[1] == '0' && len > 2) return -1;   // sin ceros a la izquierda
+
+  int n = 0;
+  for (size_t i = 1; i < len; i++) {
+    if (s[i] < '0' || s[i] > '9') return -1;
+    n = n * 10 + (s[i] - '0');
+  }
+  return n;
+}
+
+inline int vpin_parseIndex(const char* s) {
+  return s ? vpin_parseIndex(s, strlen(s)) : -1;
+}
+
+// Para static_assert: la entrada idx debe llamarse "V<idx>"
+constexpr bool vpin_nameIs(const char* name, unsigned idx) {
+  return name[0] == 'V' &&
+         (idx < 10
+            ? (name[1] == char('0' + idx) && name[2] == '\0')
+            : (name[1] == char('0' + idx / 10) &&
+               name[2] == char('0' + idx % 10) && name[3] == '\0'));
+}
+
+template <size_t N>
+constexpr bool vpin_tableIsDense(const VpinDef (&table)[N], size_t i = 0) {
+  return i >= N || (vpin_nameIs(table[i].name, (unsigned)i) && vpin_tableIsDense(table, i + 1));
+}